@@ -0,0 +1,38 @@
+#ifndef DM_SEED_H__
+#define DM_SEED_H__
+
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+/* Shared by the initiator and the reflector, both sides must derive the
+ * same seed or the ranging fails. Any change here is a protocol change.
+ *
+ * The reflector advertises a random base seed and an epoch counter. The
+ * seed for one ranging mixes both with the initiator's identity address,
+ * so initiators ranging the same reflector at once hop on different
+ * patterns, and a pair that happens to overlap badly is re-rolled when
+ * the epoch moves on.
+ */
+
+static inline uint32_t dm_seed_mix(uint32_t h) {
+    /* murmur3 finalizer */
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline uint32_t dm_seed_derive(uint32_t base_seed, const bt_addr_le_t *initiator, uint16_t epoch) {
+    const uint8_t *a = initiator->a.val;
+    uint32_t lo = a[0] | (a[1] << 8) | (a[2] << 16) | ((uint32_t)a[3] << 24);
+    uint32_t hi = a[4] | (a[5] << 8) | ((uint32_t)initiator->type << 16);
+    uint32_t h = base_seed;
+
+    h = dm_seed_mix(h ^ lo);
+    h = dm_seed_mix(h ^ hi ^ ((uint32_t)epoch * 0x9E3779B9U));
+    return h;
+}
+
+#endif
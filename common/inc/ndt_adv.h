@@ -0,0 +1,134 @@
+#ifndef NDT_ADV_H__
+#define NDT_ADV_H__
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+/* Manufacturer specific data advertised by reflectors, shared by both apps.
+ * All fields are little endian:
+ *
+ *   0  company code (2)   Nordic Semiconductor, 0x0059
+ *   2  magic (1)
+ *   3  version (1)
+ *   4  ranging modes (1)  NDT_ADV_MODE_* bitmask
+ *   5  rng seed (4)       base seed, see dm_seed.h
+ *   9  seed epoch (2)
+ *  11  compact ID (4)     optional, for single advertisement discovery
+ *
+ * The first four bytes are checked with a single compare, so data from
+ * other vendors, other Nordic products and other versions is rejected
+ * before any field is read. Fields may be appended within a version,
+ * parsers ignore trailing bytes.
+ */
+
+#define NDT_ADV_COMPANY_CODE 0x0059
+#define NDT_ADV_MAGIC 0xD1
+#define NDT_ADV_VERSION 1
+
+#define NDT_ADV_HEADER \
+    ((uint32_t)NDT_ADV_COMPANY_CODE | ((uint32_t)NDT_ADV_MAGIC << 16) | ((uint32_t)NDT_ADV_VERSION << 24))
+
+#define NDT_ADV_OFF_MODES 4
+#define NDT_ADV_OFF_RNG_SEED 5
+#define NDT_ADV_OFF_SEED_EPOCH 9
+#define NDT_ADV_OFF_ID 11
+#define NDT_ADV_LEN 11
+#define NDT_ADV_LEN_ID 15
+
+#define NDT_ADV_MODE_MCPD BIT(0)
+#define NDT_ADV_MODE_RTT BIT(1)
+
+/* A scan request does not say which method the initiator chose, so the
+ * initiator signals it by when the ranging starts. A reflector advertising
+ * both modes opens one window per mode for each scan request, MCPD right
+ * away and RTT this much later, and the initiator ranges in the window of
+ * the method it picked. Any change here is a protocol change.
+ */
+#define NDT_ADV_RTT_DELAY_US 20000
+
+/* Start delay of the window for mode, one of NDT_ADV_MODE_*, at a
+ * reflector advertising modes.
+ */
+static inline uint32_t ndt_adv_start_delay_us(uint8_t modes, uint8_t mode) {
+    if (mode == NDT_ADV_MODE_RTT && (modes & NDT_ADV_MODE_MCPD)) {
+        return NDT_ADV_RTT_DELAY_US;
+    }
+    return 0;
+}
+
+#define NDT_ADV_WINDOWS_MAX 2
+
+struct ndt_adv_window {
+    uint8_t mode;
+    uint32_t start_delay_us;
+};
+
+/* The windows a reflector advertising modes opens for one scan request,
+ * in the order they start. Returns their number.
+ */
+static inline int ndt_adv_windows(uint8_t modes, struct ndt_adv_window windows[NDT_ADV_WINDOWS_MAX]) {
+    int count = 0;
+
+    if (modes & NDT_ADV_MODE_MCPD) {
+        windows[count].mode = NDT_ADV_MODE_MCPD;
+        windows[count].start_delay_us = ndt_adv_start_delay_us(modes, NDT_ADV_MODE_MCPD);
+        count++;
+    }
+    if (modes & NDT_ADV_MODE_RTT) {
+        windows[count].mode = NDT_ADV_MODE_RTT;
+        windows[count].start_delay_us = ndt_adv_start_delay_us(modes, NDT_ADV_MODE_RTT);
+        count++;
+    }
+    return count;
+}
+
+struct ndt_adv_info {
+    uint8_t modes;
+    uint32_t rng_seed;
+    uint16_t seed_epoch;
+    uint32_t id;
+};
+
+/* Validated view into a received advertisement, no data is copied. Only
+ * valid as long as the buffer it was parsed from.
+ */
+struct ndt_adv {
+    const uint8_t *data;
+    uint8_t len;
+};
+
+/* Returns 0 if data is a reflector advertisement of this version that
+ * supports at least one ranging mode, -EINVAL otherwise.
+ */
+int ndt_adv_parse(const uint8_t *data, size_t len, struct ndt_adv *adv);
+
+/* Encode info into buf, including the compact ID if buf has room for it.
+ * Returns the encoded length or -ENOMEM.
+ */
+int ndt_adv_encode(uint8_t *buf, size_t size, const struct ndt_adv_info *info);
+
+static inline uint8_t ndt_adv_modes(const struct ndt_adv *adv) {
+    return adv->data[NDT_ADV_OFF_MODES];
+}
+
+static inline uint32_t ndt_adv_rng_seed(const struct ndt_adv *adv) {
+    return sys_get_le32(&adv->data[NDT_ADV_OFF_RNG_SEED]);
+}
+
+static inline uint16_t ndt_adv_seed_epoch(const struct ndt_adv *adv) {
+    return sys_get_le16(&adv->data[NDT_ADV_OFF_SEED_EPOCH]);
+}
+
+/* Returns -ENOENT if the advertisement does not carry a compact ID. */
+static inline int ndt_adv_id(const struct ndt_adv *adv, uint32_t *id) {
+    if (adv->len < NDT_ADV_LEN_ID) {
+        return -ENOENT;
+    }
+    *id = sys_get_le32(&adv->data[NDT_ADV_OFF_ID]);
+    return 0;
+}
+
+#endif
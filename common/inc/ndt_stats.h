@@ -0,0 +1,62 @@
+#ifndef NDT_STATS_H__
+#define NDT_STATS_H__
+
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#include <dm.h>
+
+/* Building blocks for the runtime statistics of both apps. Updating any of
+ * them is a single atomic increment, so they stay enabled on the hot path
+ * and are read and cleared by the "ndt" shell commands.
+ */
+
+#define NDT_HIST_BINS 16
+
+/* Power of two histogram: bin 0 counts zeros, bin i values from 2^(i-1) to
+ * 2^i - 1 and the last bin everything larger.
+ */
+struct ndt_hist {
+    atomic_t bins[NDT_HIST_BINS];
+};
+
+static inline void ndt_hist_add(struct ndt_hist *h, uint32_t value) {
+    int bin = value ? 32 - __builtin_clz(value) : 0;
+
+    atomic_inc(&h->bins[MIN(bin, NDT_HIST_BINS - 1)]);
+}
+
+uint32_t ndt_hist_count(const struct ndt_hist *h);
+
+/* Upper bound of the bin holding the p'th percentile, 0 if empty. */
+uint32_t ndt_hist_percentile(const struct ndt_hist *h, int p);
+
+void ndt_hist_reset(struct ndt_hist *h);
+
+/* Ranging results by enum dm_quality. */
+struct ndt_quality {
+    atomic_t count[DM_QUALITY_NONE + 1];
+};
+
+static inline void ndt_quality_add(struct ndt_quality *q, enum dm_quality quality) {
+    atomic_inc(&q->count[MIN(quality, DM_QUALITY_NONE)]);
+}
+
+uint32_t ndt_quality_total(const struct ndt_quality *q);
+
+void ndt_quality_reset(struct ndt_quality *q);
+
+/* Rate of count events in the time since since_ms, in hundredths per second. */
+uint32_t ndt_rate_centi(uint32_t count, uint32_t since_ms, uint32_t now_ms);
+
+#ifdef CONFIG_SHELL
+struct shell;
+
+void ndt_hist_print(const struct shell *sh, const char *name, const char *unit,
+                    const struct ndt_hist *h);
+
+void ndt_quality_print(const struct shell *sh, const struct ndt_quality *q);
+#endif
+
+#endif
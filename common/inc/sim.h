@@ -0,0 +1,128 @@
+#ifndef SIM_H__
+#define SIM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+/* Simulated radio for native_sim builds (CONFIG_DM_SIM). The scenario file
+ * chosen with CONFIG_DM_SIM_SCENARIO places reflectors and initiators over
+ * time. This image plays one of the nodes, the others exist only as the
+ * advertising reports, scan requests and ranging results the simulation
+ * hands to the application through the regular bt_scan, advertising and
+ * DM APIs. Time is the native_sim virtual clock, so a scenario runs as
+ * fast as the host allows and the same build always sees the same run.
+ */
+
+enum sim_role {
+    SIM_ROLE_INITIATOR,
+    SIM_ROLE_REFLECTOR,
+};
+
+struct sim_waypoint {
+    uint32_t t_ms;
+    int32_t x_cm;
+    int32_t y_cm;
+};
+
+struct sim_node {
+    const char *name;
+    bt_addr_le_t addr;
+    uint8_t role;
+    uint8_t modes;          /* NDT_ADV_MODE_* of a reflector */
+    uint16_t interval_ms;   /* advertising interval of a reflector */
+    uint16_t waypoint;
+    uint16_t waypoint_count;
+};
+
+int sim_node_count(void);
+
+const struct sim_node *sim_node_get(int index);
+
+const struct sim_node *sim_node_find(const bt_addr_le_t *addr);
+
+/* The node this image plays, the CONFIG_DM_SIM_SELF'th one with role. */
+const struct sim_node *sim_self(enum sim_role role);
+
+/* Distance between two nodes at t_ms, in meters. */
+float sim_distance(const struct sim_node *a, const struct sim_node *b, uint32_t t_ms);
+
+bool sim_in_range(const struct sim_node *a, const struct sim_node *b, uint32_t t_ms);
+
+uint32_t sim_duration_ms(void);
+
+/* Deterministic random numbers, seeded with CONFIG_DM_SIM_SEED. */
+uint32_t sim_rand(void);
+
+/* True with a probability of permille / 1000. */
+bool sim_chance(uint32_t permille);
+
+/* Standard normal sample. */
+float sim_gauss(void);
+
+struct sim_dm_stats {
+    uint32_t requests;  /* dm_request_add() calls */
+    uint32_t rejected;  /* refused, request queue full */
+    uint32_t results;   /* results delivered with a distance */
+    uint32_t failures;  /* results delivered without one */
+    uint32_t reports;   /* distances handed to sim_report_distance() */
+    float rms_error;    /* of those distances against the scenario, meters */
+};
+
+void sim_dm_get_stats(struct sim_dm_stats *stats);
+
+/* Score a distance the application reports for the peer at addr against
+ * the scenario's true distance, for the summary at the end of the run.
+ */
+void sim_report_distance(const bt_addr_le_t *addr, float distance);
+
+/* Uptime of the first distance reported for node, -ENOENT if there was none. */
+int32_t sim_first_distance_ms(const struct sim_node *node);
+
+/* Implemented by each application's simulation, logs its own counters in
+ * the summary printed when the scenario ends.
+ */
+void sim_app_summary(void);
+
+/* Wall clock of the host running the simulation, in microseconds. Runs on
+ * the native_simulator runner side, outside the virtual clock.
+ */
+uint64_t sim_host_time_us(void);
+
+#ifdef CONFIG_DM_SIM_REPLAY
+struct dm_request;
+struct dm_result;
+struct recording_scan;
+
+/* Replay of a recorded session on the initiator (CONFIG_DM_SIM_REPLAY).
+ * The recording takes the place of the scenario: its advertising reports
+ * reach the scanner at the recorded times and each ranging request is
+ * answered with the recorded result closest to when it ends. Only the
+ * first session of a recording is replayed.
+ */
+
+/* Start the replay clock, recorded times count from here. */
+void sim_replay_start(void);
+
+/* The initiator's address in the recording. */
+const bt_addr_le_t *sim_replay_own_addr(void);
+
+uint32_t sim_replay_duration_ms(void);
+
+/* The next advertising report after *pos, which starts at 0, and the
+ * uptime it is due at. Returns -ENODATA after the last one.
+ */
+int sim_replay_next_scan(size_t *pos, uint32_t *uptime_ms, struct recording_scan *scan);
+
+/* Fill result for req ending now. Returns false, with a failed result, if
+ * the recording has no unused result of the peer and ranging mode within
+ * CONFIG_DM_SIM_REPLAY_MATCH_MS.
+ */
+bool sim_replay_result(const struct dm_request *req, struct dm_result *result);
+
+/* Log what was replayed and how much faster than real time. */
+void sim_replay_summary(void);
+#endif
+
+#endif
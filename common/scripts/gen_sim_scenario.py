@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Generate the node table of the simulated radio from a scenario file.
+
+A scenario lists the reflectors and initiators, and where they are over
+time. Positions are interpolated linearly between waypoints and held after
+the last one. One statement per line, '#' starts a comment:
+
+  duration <s>
+  node <name> reflector <address> [mcpd] [rtt] [interval=<ms>]
+  node <name> initiator <address>
+  at <name> <time s> <x m> <y m>
+
+Addresses are static random, most significant byte first as printed by
+bt_addr_le_to_str(). Reflectors advertise at interval (100 ms by default)
+when they are simulated by the initiator's scanner.
+"""
+
+import argparse
+import sys
+
+ROLES = ('initiator', 'reflector')
+MODES = {'mcpd': 0x01, 'rtt': 0x02}
+
+
+class ScenarioError(Exception):
+    pass
+
+
+def parse_addr(text):
+    parts = text.split(':')
+    if len(parts) != 6:
+        raise ScenarioError(f'bad address {text}')
+    val = [int(p, 16) for p in reversed(parts)]
+    if val[5] & 0xC0 != 0xC0:
+        raise ScenarioError(f'{text} is not a static random address')
+    return val
+
+
+def parse(lines):
+    duration = None
+    nodes = {}
+
+    for lineno, line in enumerate(lines, 1):
+        words = line.split('#', 1)[0].split()
+        if not words:
+            continue
+        try:
+            if words[0] == 'duration':
+                duration = float(words[1])
+            elif words[0] == 'node':
+                name, role, addr = words[1:4]
+                if role not in ROLES:
+                    raise ScenarioError(f'unknown role {role}')
+                if name in nodes:
+                    raise ScenarioError(f'{name} defined twice')
+                node = {'role': role, 'addr': parse_addr(addr), 'modes': 0,
+                        'interval': 100, 'waypoints': []}
+                for opt in words[4:]:
+                    if opt in MODES and role == 'reflector':
+                        node['modes'] |= MODES[opt]
+                    elif opt.startswith('interval=') and role == 'reflector':
+                        node['interval'] = int(opt[len('interval='):])
+                    else:
+                        raise ScenarioError(f'unknown option {opt}')
+                if role == 'reflector' and not node['modes']:
+                    raise ScenarioError(f'reflector {name} supports no ranging mode')
+                nodes[name] = node
+            elif words[0] == 'at':
+                name = words[1]
+                if name not in nodes:
+                    raise ScenarioError(f'unknown node {name}')
+                t, x, y = (float(w) for w in words[2:5])
+                waypoints = nodes[name]['waypoints']
+                if waypoints and t * 1000 <= waypoints[-1][0]:
+                    raise ScenarioError('waypoints must be in time order')
+                waypoints.append((round(t * 1000), round(x * 100), round(y * 100)))
+            else:
+                raise ScenarioError(f'unknown statement {words[0]}')
+        except (ScenarioError, ValueError, IndexError) as e:
+            raise ScenarioError(f'line {lineno}: {e}') from e
+
+    if duration is None:
+        raise ScenarioError('no duration')
+    for name, node in nodes.items():
+        if not node['waypoints']:
+            raise ScenarioError(f'{name} has no position')
+    return duration, nodes
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--input', required=True)
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    with open(args.input) as f:
+        try:
+            duration, nodes = parse(f)
+        except ScenarioError as e:
+            sys.exit(f'{args.input}: {e}')
+
+    lines = [
+        '/* Generated by gen_sim_scenario.py, do not edit. */',
+        f'#define SIM_DURATION_MS {round(duration * 1000)}',
+        '',
+        'static const struct sim_waypoint sim_waypoints[] = {',
+    ]
+    first = {}
+    for name, node in nodes.items():
+        first[name] = len(lines) - 4
+        for t, x, y in node['waypoints']:
+            lines.append(f'\t{{{t}, {x}, {y}}},')
+    lines.append('};')
+    lines.append('')
+    lines.append('static const struct sim_node sim_nodes[] = {')
+    for name, node in nodes.items():
+        addr = ', '.join(f'0x{b:02x}' for b in node['addr'])
+        role = 'SIM_ROLE_' + node['role'].upper()
+        lines.append(f'\t{{"{name}", {{BT_ADDR_LE_RANDOM, {{{{{addr}}}}}}}, {role}, '
+                     f'{node["modes"]}, {node["interval"]}, {first[name]}, '
+                     f'{len(node["waypoints"])}}},')
+    lines.append('};')
+
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,298 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Print, convert and synthesize ranging session recordings (.ndr).
+
+Recordings are written by the initiator with CONFIG_DM_RECORD and
+replayed on native_sim with CONFIG_DM_SIM_REPLAY. The format is described
+in the initiator's src/inc/recording.h.
+
+  dump    print every record, one per line
+  header  generate the C array the replay is built from
+  synth   generate a recording from a simulation scenario, with the
+          advertising data of the reflector app and ideal rangings
+"""
+
+import argparse
+import math
+import os
+import random
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_sim_scenario  # noqa: E402
+
+MAGIC = 0x5254444E
+VERSION = 1
+
+START, SCAN, REQUEST, RESULT = range(1, 5)
+NAMES = {START: 'start', SCAN: 'scan', REQUEST: 'request', RESULT: 'result'}
+
+HEADER = struct.Struct('<BBI')
+ADDR = struct.Struct('<B6s')
+START_PAYLOAD = struct.Struct('<IB7s')
+REQUEST_PAYLOAD = struct.Struct('<7sBIII')
+RESULT_PAYLOAD = struct.Struct('<7sBBBffff')
+
+SCAN_DATA_MAX = 31
+
+MODES = {0: 'rtt', 1: 'mcpd'}
+QUALITIES = {0: 'ok', 1: 'poor', 2: 'do_not_use', 3: 'crc_fail', 4: 'none'}
+ADV_TYPES = {0x00: 'adv_ind', 0x02: 'scan_ind', 0x03: 'nonconn_ind', 0x04: 'scan_rsp',
+             0x05: 'ext_adv'}
+
+# Advertising of the reflector app, see common/inc/ndt_adv.h.
+NDT_ADV_HEADER = struct.Struct('<HBBBIH')
+NDT_COMPANY_CODE = 0x0059
+NDT_MAGIC = 0xD1
+NDT_VERSION = 1
+NDT_MODE_MCPD = 0x01
+NDT_MODE_RTT = 0x02
+
+MODE_RTT = 0
+MODE_MCPD = 1
+
+ADV_TYPE_SCAN_IND = 0x02
+ADV_TYPE_SCAN_RSP = 0x04
+
+
+class RecordingError(Exception):
+    pass
+
+
+def addr_str(raw):
+    """bt_addr_le_t bytes to the bt_addr_le_to_str() form."""
+    kind, val = ADDR.unpack(raw)
+    return ':'.join(f'{b:02X}' for b in reversed(val)) + (' (random)' if kind else ' (public)')
+
+
+def addr_raw(val, kind=1):
+    return ADDR.pack(kind, bytes(val))
+
+
+def records(data):
+    """Yield (type, time_ms, payload) for every record in data."""
+    pos = 0
+    while pos < len(data):
+        if len(data) - pos < HEADER.size:
+            raise RecordingError(f'record at {pos} cut short')
+        rtype, length, time_ms = HEADER.unpack_from(data, pos)
+        pos += HEADER.size
+        if len(data) - pos < length:
+            raise RecordingError(f'record at {pos - HEADER.size} cut short')
+        yield rtype, time_ms, data[pos:pos + length]
+        pos += length
+
+
+def check(data):
+    """Raise RecordingError unless data is a recording this version reads."""
+    for i, (rtype, _, payload) in enumerate(records(data)):
+        if i == 0 and rtype != START:
+            raise RecordingError('does not start with a start record')
+        if rtype == START:
+            if len(payload) < START_PAYLOAD.size:
+                raise RecordingError('start record cut short')
+            magic, version, _ = START_PAYLOAD.unpack_from(payload)
+            if magic != MAGIC or version != VERSION:
+                raise RecordingError(f'not a version {VERSION} recording')
+    if not data:
+        raise RecordingError('empty')
+
+
+def describe(rtype, payload):
+    if rtype == START:
+        _, version, own = START_PAYLOAD.unpack_from(payload)
+        return f'version {version} own {addr_str(own)}'
+    if rtype == SCAN:
+        addr, (adv_type, rssi) = payload[:7], struct.unpack_from('<Bb', payload, 7)
+        return (f'{addr_str(addr)} {ADV_TYPES.get(adv_type, adv_type)} rssi {rssi} '
+                f'data {payload[9:].hex()}')
+    if rtype == REQUEST:
+        addr, mode, seed, delay, window = REQUEST_PAYLOAD.unpack_from(payload)
+        return (f'{addr_str(addr)} {MODES.get(mode, mode)} seed {seed:08x} delay {delay} us '
+                f'window {window} us')
+    if rtype == RESULT:
+        addr, status, quality, mode, *est = RESULT_PAYLOAD.unpack_from(payload)
+        values = est if mode == MODE_MCPD else est[:1]
+        return (f'{addr_str(addr)} {MODES.get(mode, mode)} status {status} '
+                f'{QUALITIES.get(quality, quality)} ' + ' '.join(f'{v:.3f}' for v in values))
+    return payload.hex()
+
+
+def dump(data, out):
+    counts = {}
+    first = last = None
+    for rtype, time_ms, payload in records(data):
+        if first is None:
+            first = time_ms
+        last = time_ms
+        counts[rtype] = counts.get(rtype, 0) + 1
+        name = NAMES.get(rtype, f'type {rtype}')
+        out.write(f'{time_ms - first:>9} {name:<8} {describe(rtype, payload)}\n')
+    summary = ', '.join(f'{n} {NAMES.get(t, t)}' for t, n in sorted(counts.items()))
+    out.write(f'{len(data)} bytes, {(last - first) / 1000:.1f} s: {summary}\n')
+
+
+def header(data, name):
+    results = sum(1 for rtype, _, _ in records(data) if rtype == RESULT)
+    lines = [
+        f'/* Generated by ndr.py from {name}, do not edit. */',
+        f'#define SIM_REPLAY_RESULTS {results}',
+        '',
+        'static const uint8_t sim_replay[] = {',
+    ]
+    for i in range(0, len(data), 16):
+        lines.append('\t' + ' '.join(f'0x{b:02x},' for b in data[i:i + 16]))
+    lines.append('};')
+    return '\n'.join(lines) + '\n'
+
+
+def ad(adtype, value):
+    return bytes([len(value) + 1, adtype]) + value
+
+
+def ndt_adv(modes, seed, ident=None):
+    data = NDT_ADV_HEADER.pack(NDT_COMPANY_CODE, NDT_MAGIC, NDT_VERSION, modes, seed, 0)
+    if ident is not None:
+        data += struct.pack('<I', ident)
+    return data
+
+
+def synth(scenario, own, duration, interval_ms, seed):
+    """A recording of the scenario as seen by the own'th initiator: every
+    advertising event of every reflector in range with its scan response,
+    a ranging of each reflector every interval_ms and its result, with the
+    sim's default bias and noise.
+    """
+    rng = random.Random(seed)
+    length, nodes = scenario
+    duration = min(duration or length, length)
+    initiators = [n for n in nodes.values() if n['role'] == 'initiator']
+    if own >= len(initiators):
+        raise RecordingError(f'scenario has no initiator {own}')
+    me = initiators[own]
+
+    def position(node, t_ms):
+        wp = node['waypoints']
+        i = 0
+        while i < len(wp) - 1 and wp[i + 1][0] <= t_ms:
+            i += 1
+        if i == len(wp) - 1 or t_ms <= wp[i][0]:
+            return wp[i][1] / 100, wp[i][2] / 100
+        f = (t_ms - wp[i][0]) / (wp[i + 1][0] - wp[i][0])
+        return ((wp[i][1] + f * (wp[i + 1][1] - wp[i][1])) / 100,
+                (wp[i][2] + f * (wp[i + 1][2] - wp[i][2])) / 100)
+
+    def distance(node, t_ms):
+        (ax, ay), (bx, by) = position(me, t_ms), position(node, t_ms)
+        return math.hypot(ax - bx, ay - by)
+
+    events = [(0, 0, START, START_PAYLOAD.pack(MAGIC, VERSION, addr_raw(me['addr'])))]
+    order = 1
+
+    def add(t_ms, rtype, payload):
+        nonlocal order
+        events.append((t_ms, order, rtype, payload))
+        order += 1
+
+    for node in nodes.values():
+        if node['role'] != 'reflector':
+            continue
+        addr = addr_raw(node['addr'])
+        uuid = rng.randbytes(16)
+        ident = struct.unpack_from('<I', uuid)[0]
+        adv_seed = rng.getrandbits(32)
+        adv = (ad(0x01, bytes([0x06])) + ad(0xFF, ndt_adv(node['modes'], adv_seed, ident)) +
+               ad(0x09, b'Thingy'))
+        rsp = ad(0xFF, ndt_adv(node['modes'], adv_seed)) + ad(0x07, uuid)
+        next_request = 0
+        t = rng.randrange(node['interval'])
+
+        while t < duration * 1000:
+            d = distance(node, t)
+            if d * 100 <= 2000:
+                rssi = round(-45 - 20 * math.log10(max(d, 0.1)) + rng.gauss(0, 2))
+                add(t, SCAN, addr + struct.pack('<Bb', ADV_TYPE_SCAN_IND, rssi) + adv)
+                add(t + 1, SCAN, addr + struct.pack('<Bb', ADV_TYPE_SCAN_RSP, rssi) + rsp)
+
+                if t >= next_request:
+                    next_request = t + interval_ms
+                    mode = MODE_MCPD if node['modes'] & NDT_MODE_MCPD and d < 3 else MODE_RTT
+                    if not node['modes'] & NDT_MODE_RTT:
+                        mode = MODE_MCPD
+                    delay = 20000 if mode == MODE_RTT and node['modes'] & NDT_MODE_MCPD else 0
+                    add(t + 1, REQUEST, REQUEST_PAYLOAD.pack(addr, mode, adv_seed, delay, 0))
+                    done = t + 1 + delay // 1000 + (40 if mode == MODE_MCPD else 10)
+                    d = distance(node, done)
+                    if rng.random() < 0.05:
+                        est, status, quality = [0, 0, 0, 0], 0, 2
+                    elif mode == MODE_MCPD:
+                        est = [d + 1.28 + rng.gauss(0, 0.15), d + 1.28 + rng.gauss(0, 0.15),
+                               d * (1 + 0.3 * rng.gauss(0, 1)) + 1.28, 0]
+                        est[3] = est[0]
+                        status, quality = 1, 1 if rng.random() < 0.1 else 0
+                    else:
+                        est = [d - 5.5 + rng.gauss(0, 1), 0, 0, 0]
+                        status, quality = 1, 1 if rng.random() < 0.1 else 0
+                    add(done, RESULT, RESULT_PAYLOAD.pack(addr, status, quality, mode, *est))
+            t += node['interval'] + rng.randrange(11)
+
+    out = bytearray()
+    for t_ms, _, rtype, payload in sorted(events):
+        out += HEADER.pack(rtype, len(payload), t_ms) + payload
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('dump', help='print a recording')
+    p.add_argument('input')
+
+    p = sub.add_parser('header', help='generate the replay header')
+    p.add_argument('--input', required=True)
+    p.add_argument('--output', required=True)
+
+    p = sub.add_parser('synth', help='generate a recording from a scenario')
+    p.add_argument('--scenario', required=True)
+    p.add_argument('--output', required=True)
+    p.add_argument('--initiator', type=int, default=0, help='initiator recording, default 0')
+    p.add_argument('--duration', type=float, help='seconds, default the whole scenario')
+    p.add_argument('--interval', type=int, default=250,
+                   help='ranging interval per reflector in ms, default 250')
+    p.add_argument('--seed', type=int, default=1)
+
+    args = parser.parse_args()
+    path = args.scenario if args.command == 'synth' else args.input
+
+    try:
+        if args.command == 'synth':
+            with open(path) as f:
+                scenario = gen_sim_scenario.parse(f)
+            data = synth(scenario, args.initiator, args.duration, args.interval, args.seed)
+            with open(args.output, 'wb') as f:
+                f.write(data)
+            return
+
+        with open(path, 'rb') as f:
+            data = f.read()
+        check(data)
+        if args.command == 'dump':
+            dump(data, sys.stdout)
+        else:
+            with open(args.output, 'w') as f:
+                f.write(header(data, os.path.basename(path)))
+    except (RecordingError, gen_sim_scenario.ScenarioError) as e:
+        sys.exit(f'{path}: {e}')
+    except BrokenPipeError:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Monte-Carlo model of hopping pattern collisions around one reflector.
+
+Every round, all initiators in range hear the same scan response and start
+a ranging at the same time. The reflector answers one of them. Each
+initiator hops through the tone channels in the order given by its seed,
+and the answered ranging is corrupted when too many of its steps share a
+channel with another initiator.
+
+Initiators that share the reflector's seed also follow the reflector's
+tones. They report a distance from a ranging that was not theirs, which
+is counted as a false measurement.
+
+Seed schemes:
+  shared   one advertised seed for every initiator (the old behaviour)
+  derived  dm_seed_derive() with a fixed epoch
+  epoch    dm_seed_derive() with the epoch rolling every --epoch-rounds
+"""
+
+import argparse
+import random
+
+CHANNELS = 80
+MASK32 = 0xFFFFFFFF
+
+
+def seed_mix(h):
+    """Port of dm_seed_mix() in common/inc/dm_seed.h."""
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & MASK32
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & MASK32
+    h ^= h >> 16
+    return h
+
+
+def seed_derive(base_seed, addr, addr_type, epoch):
+    """Port of dm_seed_derive(), addr is the 6 byte little endian address."""
+    lo = addr[0] | (addr[1] << 8) | (addr[2] << 16) | (addr[3] << 24)
+    hi = addr[4] | (addr[5] << 8) | (addr_type << 16)
+    h = seed_mix(base_seed ^ lo)
+    return seed_mix(h ^ hi ^ ((epoch * 0x9E3779B9) & MASK32))
+
+
+_patterns = {}
+
+
+def hop_pattern(seed):
+    pattern = _patterns.get(seed)
+    if pattern is None:
+        pattern = random.Random(seed).sample(range(CHANNELS), CHANNELS)
+        _patterns[seed] = pattern
+    return pattern
+
+
+def simulate(scheme, initiators, rounds, epoch_rounds, threshold, rng):
+    """Run one deployment, returns (corrupted, valid, false) per round."""
+    base_seed = rng.getrandbits(32)
+    addrs = [bytes(rng.getrandbits(8) for _ in range(6)) for _ in range(initiators)]
+    corrupted = 0
+    false_meas = 0
+
+    for r in range(rounds):
+        epoch = (r // epoch_rounds) & 0xFFFF if scheme == 'epoch' else 0
+        if scheme == 'shared':
+            seeds = [base_seed] * initiators
+        else:
+            seeds = [seed_derive(base_seed, a, 0, epoch) for a in addrs]
+
+        served = rng.randrange(initiators)
+        own = hop_pattern(seeds[served])
+        others = [hop_pattern(s) for i, s in enumerate(seeds) if i != served]
+
+        hits = sum(1 for t in range(CHANNELS) if any(o[t] == own[t] for o in others))
+        if hits > threshold * CHANNELS:
+            corrupted += 1
+
+        false_meas += sum(1 for i, s in enumerate(seeds) if i != served and s == seeds[served])
+
+    return corrupted / rounds, 1 - corrupted / rounds, false_meas / rounds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--deployments', type=int, default=50,
+                        help='independent reflector/initiator placements per data point')
+    parser.add_argument('--rounds', type=int, default=240,
+                        help='ranging rounds per deployment')
+    parser.add_argument('--max-initiators', type=int, default=32)
+    parser.add_argument('--epoch-rounds', type=int, default=60,
+                        help='rounds per seed epoch for the epoch scheme')
+    parser.add_argument('--threshold', type=float, default=0.1,
+                        help='fraction of colliding steps that corrupts a ranging')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+
+    print('%-8s %4s %10s %12s %12s %12s' % ('scheme', 'n', 'collision', 'valid/round',
+                                            'worst valid', 'false/round'))
+    n = 1
+    while n <= args.max_initiators:
+        for scheme in ('shared', 'derived', 'epoch'):
+            results = [simulate(scheme, n, args.rounds, args.epoch_rounds, args.threshold, rng)
+                       for _ in range(args.deployments)]
+            collision = sum(r[0] for r in results) / len(results)
+            valid = sum(r[1] for r in results) / len(results)
+            worst = min(r[1] for r in results)
+            false_meas = sum(r[2] for r in results) / len(results)
+            print('%-8s %4d %10.3f %12.3f %12.3f %12.3f' % (scheme, n, collision, valid, worst,
+                                                           false_meas))
+        n *= 2
+
+
+if __name__ == '__main__':
+    main()
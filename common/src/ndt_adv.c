@@ -0,0 +1,35 @@
+#include <ndt_adv.h>
+
+#include <errno.h>
+
+#define NDT_ADV_MODES_KNOWN (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT)
+
+int ndt_adv_parse(const uint8_t *data, size_t len, struct ndt_adv *adv) {
+    if (len < NDT_ADV_LEN || sys_get_le32(data) != NDT_ADV_HEADER) {
+        return -EINVAL;
+    }
+    if ((data[NDT_ADV_OFF_MODES] & NDT_ADV_MODES_KNOWN) == 0) {
+        return -EINVAL;
+    }
+
+    adv->data = data;
+    adv->len = MIN(len, UINT8_MAX);
+    return 0;
+}
+
+int ndt_adv_encode(uint8_t *buf, size_t size, const struct ndt_adv_info *info) {
+    if (size < NDT_ADV_LEN) {
+        return -ENOMEM;
+    }
+
+    sys_put_le32(NDT_ADV_HEADER, buf);
+    buf[NDT_ADV_OFF_MODES] = info->modes;
+    sys_put_le32(info->rng_seed, &buf[NDT_ADV_OFF_RNG_SEED]);
+    sys_put_le16(info->seed_epoch, &buf[NDT_ADV_OFF_SEED_EPOCH]);
+
+    if (size < NDT_ADV_LEN_ID) {
+        return NDT_ADV_LEN;
+    }
+    sys_put_le32(info->id, &buf[NDT_ADV_OFF_ID]);
+    return NDT_ADV_LEN_ID;
+}
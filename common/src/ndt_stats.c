@@ -0,0 +1,98 @@
+#include <ndt_stats.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+uint32_t ndt_hist_count(const struct ndt_hist *h) {
+    uint32_t count = 0;
+
+    for (int i = 0; i < NDT_HIST_BINS; i++) {
+        count += atomic_get(&h->bins[i]);
+    }
+    return count;
+}
+
+uint32_t ndt_hist_percentile(const struct ndt_hist *h, int p) {
+    uint32_t count = ndt_hist_count(h);
+    uint32_t rank = DIV_ROUND_UP(count * p, 100);
+    uint32_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+    for (int i = 0; i < NDT_HIST_BINS - 1; i++) {
+        seen += atomic_get(&h->bins[i]);
+        if (seen >= MAX(rank, 1)) {
+            return BIT(i) - 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
+void ndt_hist_reset(struct ndt_hist *h) {
+    for (int i = 0; i < NDT_HIST_BINS; i++) {
+        atomic_clear(&h->bins[i]);
+    }
+}
+
+uint32_t ndt_quality_total(const struct ndt_quality *q) {
+    uint32_t total = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(q->count); i++) {
+        total += atomic_get(&q->count[i]);
+    }
+    return total;
+}
+
+void ndt_quality_reset(struct ndt_quality *q) {
+    for (int i = 0; i < ARRAY_SIZE(q->count); i++) {
+        atomic_clear(&q->count[i]);
+    }
+}
+
+uint32_t ndt_rate_centi(uint32_t count, uint32_t since_ms, uint32_t now_ms) {
+    uint32_t elapsed = now_ms - since_ms;
+
+    return elapsed ? (uint32_t)((uint64_t)count * 100000 / elapsed) : 0;
+}
+
+#ifdef CONFIG_SHELL
+/* Percentiles only resolve to the bin, the last one is open ended. */
+static const char *hist_bound(char *buf, size_t size, uint32_t value, const char *unit) {
+    if (value == UINT32_MAX) {
+        snprintk(buf, size, "> %u %s", (uint32_t)BIT(NDT_HIST_BINS - 2) - 1, unit);
+    }
+    else {
+        snprintk(buf, size, "<= %u %s", value, unit);
+    }
+    return buf;
+}
+
+void ndt_hist_print(const struct shell *sh, const char *name, const char *unit,
+                    const struct ndt_hist *h) {
+    uint32_t count = ndt_hist_count(h);
+    char p50[24], p95[24], p99[24];
+
+    if (count == 0) {
+        shell_print(sh, "%s: none", name);
+        return;
+    }
+    shell_print(sh, "%s: %u, p50 %s, p95 %s, p99 %s", name, count,
+                hist_bound(p50, sizeof(p50), ndt_hist_percentile(h, 50), unit),
+                hist_bound(p95, sizeof(p95), ndt_hist_percentile(h, 95), unit),
+                hist_bound(p99, sizeof(p99), ndt_hist_percentile(h, 99), unit));
+}
+
+void ndt_quality_print(const struct shell *sh, const struct ndt_quality *q) {
+    shell_print(sh, "quality: %u ok, %u poor, %u do not use, %u crc fail, %u none",
+                (uint32_t)atomic_get(&q->count[DM_QUALITY_OK]),
+                (uint32_t)atomic_get(&q->count[DM_QUALITY_POOR]),
+                (uint32_t)atomic_get(&q->count[DM_QUALITY_DO_NOT_USE]),
+                (uint32_t)atomic_get(&q->count[DM_QUALITY_CRC_FAIL]),
+                (uint32_t)atomic_get(&q->count[DM_QUALITY_NONE]));
+}
+#endif
@@ -0,0 +1,249 @@
+#include <sim.h>
+
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <posix_board_if.h>
+
+#ifdef CONFIG_SHELL_BACKEND_DUMMY
+#include <zephyr/shell/shell.h>
+#include <zephyr/shell/shell_dummy.h>
+#endif
+
+#include <dm.h>
+
+LOG_MODULE_REGISTER(sim, LOG_LEVEL_INF);
+
+/* Stand-in for the DM library. Requests are served one at a time in the
+ * order they were added, each taking its start delay plus the method's
+ * latency, and the result is computed from the scenario at the moment the
+ * ranging ends. Raw results carry the configured bias and noise, so the
+ * application's offsets, calibration and smoothing have something to do.
+ */
+
+#define QUEUE_LEN CONFIG_DM_SIM_QUEUE_LEN
+
+static struct dm_cb *dm_cb;
+
+static struct k_spinlock lock;
+static struct dm_request queue[QUEUE_LEN];
+static size_t queue_head;
+static size_t queue_len;
+static struct sim_dm_stats stats;
+static float sq_error;
+
+/* Nodes a distance was reported for, in the order of their first one. */
+#define FIRST_MAX 32
+
+static struct {
+    const struct sim_node *node;
+    uint32_t uptime_ms;
+} firsts[FIRST_MAX];
+static int first_count;
+
+static void ranging_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(ranging_work, ranging_work_handler);
+
+static void summary_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(summary_work, summary_work_handler);
+
+static uint32_t ranging_time_ms(const struct dm_request *req) {
+    uint32_t latency = req->ranging_mode == DM_RANGING_MODE_MCPD ? CONFIG_DM_SIM_MCPD_LATENCY_MS
+                                                                 : CONFIG_DM_SIM_RTT_LATENCY_MS;
+
+    return req->start_delay_us / 1000 + latency;
+}
+
+static bool ranging_result(const struct dm_request *req, struct dm_result *result) {
+    enum sim_role role = req->role == DM_ROLE_REFLECTOR ? SIM_ROLE_REFLECTOR : SIM_ROLE_INITIATOR;
+    const struct sim_node *self = sim_self(role);
+    const struct sim_node *peer = sim_node_find(&req->bt_addr);
+    uint32_t now = k_uptime_get_32();
+
+    memset(result, 0, sizeof(*result));
+    bt_addr_le_copy(&result->bt_addr, &req->bt_addr);
+    result->ranging_mode = req->ranging_mode;
+    result->quality = DM_QUALITY_DO_NOT_USE;
+
+#ifdef CONFIG_DM_SIM_REPLAY
+    return sim_replay_result(req, result);
+#endif
+
+    if (self == NULL || peer == NULL || !sim_in_range(self, peer, now) ||
+        sim_chance(CONFIG_DM_SIM_FAIL_PERMILLE)) {
+        return false;
+    }
+
+    float d = sim_distance(self, peer, now);
+
+    if (req->ranging_mode == DM_RANGING_MODE_MCPD) {
+        float bias = CONFIG_DM_SIM_MCPD_BIAS_CM / 100.0f;
+        float noise = CONFIG_DM_SIM_MCPD_NOISE_CM / 100.0f;
+
+        result->dist_estimates.mcpd.ifft = d + bias + noise * sim_gauss();
+        result->dist_estimates.mcpd.phase_slope = d + bias + noise * sim_gauss();
+        /* RSSI based distance is much worse and grows with distance. */
+        result->dist_estimates.mcpd.rssi_openspace = d * (1.0f + 0.3f * sim_gauss()) + bias;
+        result->dist_estimates.mcpd.best = result->dist_estimates.mcpd.ifft;
+    }
+    else {
+        result->dist_estimates.rtt.rtt = d + CONFIG_DM_SIM_RTT_BIAS_CM / 100.0f +
+                                         CONFIG_DM_SIM_RTT_NOISE_CM / 100.0f * sim_gauss();
+    }
+
+    result->status = true;
+    result->quality = sim_chance(CONFIG_DM_SIM_POOR_PERMILLE) ? DM_QUALITY_POOR : DM_QUALITY_OK;
+    return true;
+}
+
+static void ranging_work_handler(struct k_work *work) {
+    struct dm_request req;
+    struct dm_result result;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (queue_len == 0) {
+        k_spin_unlock(&lock, key);
+        return;
+    }
+    req = queue[queue_head];
+    queue_head = (queue_head + 1) % QUEUE_LEN;
+    queue_len--;
+    k_spin_unlock(&lock, key);
+
+    bool ok = ranging_result(&req, &result);
+
+    key = k_spin_lock(&lock);
+    if (ok) {
+        stats.results++;
+    }
+    else {
+        stats.failures++;
+    }
+    if (queue_len > 0) {
+        k_work_reschedule(&ranging_work, K_MSEC(ranging_time_ms(&queue[queue_head])));
+    }
+    k_spin_unlock(&lock, key);
+
+    if (dm_cb != NULL && dm_cb->data_ready != NULL) {
+        dm_cb->data_ready(&result);
+    }
+}
+
+int dm_request_add(struct dm_request *req) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    stats.requests++;
+    if (queue_len == QUEUE_LEN) {
+        stats.rejected++;
+        k_spin_unlock(&lock, key);
+        return -ENOMEM;
+    }
+    queue[(queue_head + queue_len) % QUEUE_LEN] = *req;
+    queue_len++;
+    if (queue_len == 1) {
+        k_work_reschedule(&ranging_work, K_MSEC(ranging_time_ms(req)));
+    }
+    k_spin_unlock(&lock, key);
+
+    return 0;
+}
+
+int dm_init(struct dm_init_param *init_param) {
+    dm_cb = init_param->cb;
+
+    LOG_INF("Simulating %d nodes for %u s", sim_node_count(), sim_duration_ms() / 1000);
+    k_work_reschedule(&summary_work, K_MSEC(sim_duration_ms()));
+    return 0;
+}
+
+static int first_find(const struct sim_node *node) {
+    for (int i = 0; i < first_count; i++) {
+        if (firsts[i].node == node) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+void sim_report_distance(const bt_addr_le_t *addr, float distance) {
+    const struct sim_node *peer = sim_node_find(addr);
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+
+    if (peer == NULL || self == NULL) {
+        return;
+    }
+
+    uint32_t now = k_uptime_get_32();
+    float error = distance - sim_distance(self, peer, now);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    stats.reports++;
+    sq_error += error * error;
+    if (first_count < FIRST_MAX && first_find(peer) < 0) {
+        firsts[first_count].node = peer;
+        firsts[first_count].uptime_ms = now;
+        first_count++;
+    }
+    k_spin_unlock(&lock, key);
+}
+
+int32_t sim_first_distance_ms(const struct sim_node *node) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = first_find(node);
+    int32_t ret = i < 0 ? -ENOENT : firsts[i].uptime_ms;
+
+    k_spin_unlock(&lock, key);
+    return ret;
+}
+
+void sim_dm_get_stats(struct sim_dm_stats *out) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    *out = stats;
+    out->rms_error = stats.reports ? sqrtf(sq_error / stats.reports) : 0;
+    k_spin_unlock(&lock, key);
+}
+
+#ifdef CONFIG_SHELL_BACKEND_DUMMY
+/* Run one of the app's shell commands and log its output, so the summary
+ * also checks that the "ndt" commands work.
+ */
+static void sim_shell(const char *cmd) {
+    const struct shell *sh = shell_backend_dummy_get_ptr();
+    static char out[CONFIG_SHELL_BACKEND_DUMMY_BUF_SIZE + 1];
+    size_t len;
+
+    shell_backend_dummy_clear_output(sh);
+    int err = shell_execute_cmd(sh, cmd);
+
+    strncpy(out, shell_backend_dummy_get_output(sh, &len), sizeof(out) - 1);
+    for (char *line = strtok(out, "\r\n"); line != NULL; line = strtok(NULL, "\r\n")) {
+        LOG_INF("sim: %s", line);
+    }
+    if (err) {
+        LOG_ERR("sim: \"%s\" failed (err %d)", cmd, err);
+    }
+}
+#endif
+
+static void summary_work_handler(struct k_work *work) {
+    struct sim_dm_stats s;
+
+    sim_dm_get_stats(&s);
+    LOG_INF("sim: dm %u requests, %u rejected, %u results, %u failed", s.requests, s.rejected,
+            s.results, s.failures);
+    if (s.reports > 0) {
+        LOG_INF("sim: %u distances, rms error %d cm", s.reports, (int)(s.rms_error * 100));
+    }
+    sim_app_summary();
+#ifdef CONFIG_SHELL_BACKEND_DUMMY
+    sim_shell("ndt stats");
+    sim_shell("ndt peers");
+#endif
+    LOG_INF("sim: done");
+
+    LOG_PANIC();
+    posix_exit(0);
+}
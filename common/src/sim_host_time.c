@@ -0,0 +1,12 @@
+/* Built into the native_simulator runner, so it calls the host's libc
+ * rather than the embedded one.
+ */
+#include <stdint.h>
+#include <time.h>
+
+uint64_t sim_host_time_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
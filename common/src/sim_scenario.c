@@ -0,0 +1,106 @@
+#include <sim.h>
+
+#include <math.h>
+#include <zephyr/kernel.h>
+
+#include <sim_scenario.h>
+
+BUILD_ASSERT(ARRAY_SIZE(sim_nodes) > 0, "Scenario has no nodes");
+
+static struct k_spinlock rand_lock;
+static uint32_t rand_state = CONFIG_DM_SIM_SEED ? CONFIG_DM_SIM_SEED : 1;
+
+int sim_node_count(void) {
+    return ARRAY_SIZE(sim_nodes);
+}
+
+const struct sim_node *sim_node_get(int index) {
+    return &sim_nodes[index];
+}
+
+const struct sim_node *sim_node_find(const bt_addr_le_t *addr) {
+    for (int i = 0; i < ARRAY_SIZE(sim_nodes); i++) {
+        if (bt_addr_le_eq(&sim_nodes[i].addr, addr)) {
+            return &sim_nodes[i];
+        }
+    }
+    return NULL;
+}
+
+const struct sim_node *sim_self(enum sim_role role) {
+    int n = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(sim_nodes); i++) {
+        if (sim_nodes[i].role == role && n++ == CONFIG_DM_SIM_SELF) {
+            return &sim_nodes[i];
+        }
+    }
+    return NULL;
+}
+
+static void position(const struct sim_node *node, uint32_t t_ms, float *x, float *y) {
+    const struct sim_waypoint *wp = &sim_waypoints[node->waypoint];
+    int last = node->waypoint_count - 1;
+    int i = 0;
+
+    while (i < last && wp[i + 1].t_ms <= t_ms) {
+        i++;
+    }
+    if (i == last || t_ms <= wp[i].t_ms) {
+        *x = wp[i].x_cm / 100.0f;
+        *y = wp[i].y_cm / 100.0f;
+        return;
+    }
+
+    float f = (float)(t_ms - wp[i].t_ms) / (wp[i + 1].t_ms - wp[i].t_ms);
+
+    *x = (wp[i].x_cm + f * (wp[i + 1].x_cm - wp[i].x_cm)) / 100.0f;
+    *y = (wp[i].y_cm + f * (wp[i + 1].y_cm - wp[i].y_cm)) / 100.0f;
+}
+
+float sim_distance(const struct sim_node *a, const struct sim_node *b, uint32_t t_ms) {
+    float ax, ay, bx, by;
+
+    position(a, t_ms, &ax, &ay);
+    position(b, t_ms, &bx, &by);
+    return sqrtf((ax - bx) * (ax - bx) + (ay - by) * (ay - by));
+}
+
+bool sim_in_range(const struct sim_node *a, const struct sim_node *b, uint32_t t_ms) {
+    return sim_distance(a, b, t_ms) * 100 <= CONFIG_DM_SIM_RANGE_CM;
+}
+
+uint32_t sim_duration_ms(void) {
+#ifdef CONFIG_DM_SIM_REPLAY
+    /* Leave time for the rangings the last reports start. */
+    return sim_replay_duration_ms() + 1000;
+#else
+    return SIM_DURATION_MS;
+#endif
+}
+
+uint32_t sim_rand(void) {
+    k_spinlock_key_t key = k_spin_lock(&rand_lock);
+    uint32_t x = rand_state;
+
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rand_state = x;
+    k_spin_unlock(&rand_lock, key);
+
+    return x;
+}
+
+bool sim_chance(uint32_t permille) {
+    return sim_rand() % 1000 < permille;
+}
+
+float sim_gauss(void) {
+    /* Box-Muller, both uniforms in (0, 1]. */
+    float u = (sim_rand() % 65536 + 1) / 65536.0f;
+    float v = (sim_rand() % 65536 + 1) / 65536.0f;
+
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * 3.14159265f * v);
+}
@@ -0,0 +1,42 @@
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+# Included by the unit tests of both apps after find_package(Zephyr). The
+# code under test is built from the app's sources, with the app's and the
+# common headers.
+
+set(APP_DIR ${CMAKE_CURRENT_SOURCE_DIR}/../..)
+set(COMMON_DIR ${CMAKE_CURRENT_LIST_DIR}/..)
+set(GENERATED_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+
+target_include_directories(app PRIVATE ${APP_DIR}/src/inc ${COMMON_DIR}/inc)
+
+# Benchmarks are timed with the host clock on native_sim, the virtual one
+# stands still while the test runs, and in cycles on hardware.
+function(ndt_test_host_time)
+  if(CONFIG_ARCH_POSIX)
+    target_sources(native_simulator INTERFACE ${COMMON_DIR}/src/sim_host_time.c)
+  endif()
+endfunction()
+
+# Compile in common/scenarios/<scenario>.txt, as the apps' simulation does,
+# for tests that need its nodes or true distances.
+function(ndt_test_sim_scenario scenario)
+  set(input ${COMMON_DIR}/scenarios/${scenario}.txt)
+  set(output ${GENERATED_DIR}/sim_scenario.h)
+  add_custom_command(
+    OUTPUT ${output}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${GENERATED_DIR}
+    COMMAND ${PYTHON_EXECUTABLE} ${COMMON_DIR}/scripts/gen_sim_scenario.py
+      --input ${input}
+      --output ${output}
+    DEPENDS ${COMMON_DIR}/scripts/gen_sim_scenario.py ${input}
+    COMMENT "Generating simulation scenario"
+  )
+  add_custom_target(sim_scenario DEPENDS ${output})
+  add_dependencies(app sim_scenario)
+  target_sources(app PRIVATE ${COMMON_DIR}/src/sim_scenario.c)
+  target_include_directories(app PRIVATE ${GENERATED_DIR})
+endfunction()
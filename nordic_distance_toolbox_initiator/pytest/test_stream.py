@@ -0,0 +1,63 @@
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Run the native_sim initiator with CONFIG_DM_STREAM and receive its stream
+with scripts/stream_receive.py on the second pty, as a host would.
+
+Every frame the stream thread wrote must arrive, in order and with a good
+CRC, at the rate the simulation produced them.
+"""
+
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+from twister_harness import DeviceAdapter
+
+RECEIVER = Path(__file__).parents[1] / 'scripts' / 'stream_receive.py'
+
+# Printed by the native_sim pty driver for the second UART.
+PTY = re.compile(r'uart_1 connected to pseudotty: (\S+)')
+DEVICE = re.compile(r'stream: (\d+) frames, (\d+) dropped')
+SUMMARY = re.compile(r'(\d+) frames in ([\d.]+) s, (\d+) lost, (\d+) crc errors')
+DURATION = re.compile(r'Simulating \d+ nodes for (\d+) s')
+
+# The receiver runs for slightly less than the simulation.
+MIN_RATE_RATIO = 0.9
+
+
+def search(regex, lines):
+    for line in lines:
+        m = regex.search(line)
+        if m:
+            return m
+    raise AssertionError(f'no line matches "{regex.pattern}"')
+
+
+def test_stream(dut: DeviceAdapter):
+    lines = dut.readlines_until(regex=PTY.pattern, timeout=10)
+    pty = search(PTY, lines).group(1)
+
+    rx = subprocess.Popen([sys.executable, str(RECEIVER), pty, '--stats', '--quiet'],
+                          stderr=subprocess.PIPE, text=True)
+
+    lines += dut.readlines_until(regex='sim: done', timeout=120)
+    # The pty closes when the simulation exits, which ends the receiver.
+    _, stats = rx.communicate(timeout=30)
+    print(stats)
+
+    duration = int(search(DURATION, lines).group(1))
+    sent, dropped = map(int, search(DEVICE, lines).groups())
+    frames, elapsed, lost, crc_errors = search(SUMMARY, stats.splitlines()).groups()
+    frames, lost, crc_errors = int(frames), int(lost), int(crc_errors)
+    rate = frames / float(elapsed)
+
+    assert sent > 0, 'the stream thread wrote nothing'
+    assert dropped == 0, f'{dropped} frames dropped on the device'
+    assert lost == 0 and crc_errors == 0, f'{lost} frames lost, {crc_errors} crc errors'
+    assert frames >= sent, f'{frames} of {sent} frames received'
+    assert rate >= MIN_RATE_RATIO * sent / duration, \
+        f'{rate:.1f} frames/s, the device sent {sent / duration:.1f} per second'
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Generate the indicator LED color table used by addr_to_color().
+
+Each entry is the RGBA color for one hue in degrees, at the configured
+saturation and luminance. The arithmetic mirrors the original single
+precision HSL to RGB code step by step, including its float/double
+promotions, so the table is bit for bit identical to computing the color
+at runtime.
+"""
+
+import argparse
+import struct
+
+
+def f32(x):
+    """Round a Python float (double) to IEEE single precision."""
+    return struct.unpack('<f', struct.pack('<f', x))[0]
+
+
+def hue_to_rgb(temp1, temp2, hue):
+    if hue < 0:
+        hue = f32(hue + 1)
+    if hue > 1:
+        hue = f32(hue - 1)
+    if hue < 1.0 / 6.0:
+        return f32(temp1 + f32(f32(f32(temp2 - temp1) * 6) * hue))
+    if hue < 0.5:
+        return temp2
+    if hue < 2.0 / 3.0:
+        # (2.0 / 3.0 - hue) is a double, so the rest is evaluated in double.
+        return f32(temp1 + f32(temp2 - temp1) * (2.0 / 3.0 - hue) * 6)
+    return temp1
+
+
+def hsl_to_rgba(h, s, l):
+    if s == 0:
+        r = g = b = l
+    else:
+        if l < 0.5:
+            temp2 = f32(l * f32(1 + s))
+        else:
+            temp2 = f32(f32(l + s) - f32(s * l))
+        temp1 = f32(f32(2 * l) - temp2)
+
+        r = hue_to_rgb(temp1, temp2, f32(h / 360.0 + 1.0 / 3.0))
+        g = hue_to_rgb(temp1, temp2, f32(h / 360.0))
+        b = hue_to_rgb(temp1, temp2, f32(h / 360.0 - 1.0 / 3.0))
+
+    def channel(c):
+        return int(f32(c * 255)) & 0xFF
+
+    return (channel(r) << 24) | (channel(g) << 16) | (channel(b) << 8) | 0xFF
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--saturation', type=int, required=True,
+                        help='saturation in hundredths')
+    parser.add_argument('--luminance', type=int, required=True,
+                        help='luminance in hundredths')
+    parser.add_argument('--output', required=True)
+    args = parser.parse_args()
+
+    saturation = f32(args.saturation / 100.0)
+    luminance = f32(args.luminance / 100.0)
+
+    lines = [
+        '/* Generated by gen_color_table.py, do not edit. */',
+        '#define COLOR_TABLE_SIZE 360',
+        '',
+        'static const uint32_t color_table[COLOR_TABLE_SIZE] = {',
+    ]
+    for hue in range(0, 360, 6):
+        row = ', '.join(f'0x{hsl_to_rgba(float(h), saturation, luminance):08x}'
+                        for h in range(hue, hue + 6))
+        lines.append(f'\t{row},')
+    lines.append('};')
+
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+if __name__ == '__main__':
+    main()
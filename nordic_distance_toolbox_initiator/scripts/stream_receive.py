@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Receive the initiator's binary measurement stream (CONFIG_DM_STREAM).
+
+Reads COBS framed, CRC checked frames (see src/inc/stream.h) from a serial
+port, the native_sim pty or a capture file and prints one CSV line per
+measurement. With --stats a line per second on stderr reports the frame
+rate, CRC errors and frames lost on the device. With --record the
+session recording the initiator streams with CONFIG_DM_RECORD_STREAM is
+written to a file, for common/scripts/ndr.py and CONFIG_DM_SIM_REPLAY.
+"""
+
+import argparse
+import binascii
+import os
+import struct
+import sys
+import termios
+import time
+import tty
+
+TYPE_MEASUREMENT = 1
+TYPE_RECORD = 2
+FLAG_PUBLISHED = 0x01
+
+HEADER = struct.Struct('<BH')
+MEASUREMENT = struct.Struct('<IQBBBxfffffff')
+
+METHODS = {0: 'rtt', 1: 'mcpd'}
+QUALITIES = {0: 'ok', 1: 'poor', 2: 'do_not_use', 3: 'crc_fail', 4: 'none'}
+
+COLUMNS = ['seq', 'timestamp_ms', 'peer', 'method', 'quality', 'published', 'distance',
+           'confidence', 'mcpd_ifft', 'mcpd_phase_slope', 'mcpd_rssi_openspace', 'mcpd_best',
+           'rtt']
+
+
+def cobs_decode(data):
+    """Decode one COBS frame without its delimiter, None if malformed."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Receiver:
+    def __init__(self):
+        self.frames = 0
+        self.crc_errors = 0
+        self.lost = 0
+        self.unknown = 0
+        self.seq = None
+
+    def frame(self, data):
+        """Check and split one encoded frame, returns (type, seq, payload)."""
+        frame = cobs_decode(data)
+        if frame is None or len(frame) < HEADER.size + 2 or \
+                binascii.crc_hqx(frame[:-2], 0xFFFF) != int.from_bytes(frame[-2:], 'little'):
+            self.crc_errors += 1
+            return None
+
+        ftype, seq = HEADER.unpack_from(frame)
+        if self.seq is not None:
+            self.lost += (seq - self.seq - 1) & 0xFFFF
+        self.seq = seq
+        self.frames += 1
+        return ftype, seq, frame[HEADER.size:-2]
+
+    def measurement(self, seq, payload):
+        if len(payload) < MEASUREMENT.size:
+            self.unknown += 1
+            return None
+        (timestamp, peer, method, quality, flags, distance, confidence, ifft, phase_slope,
+         rssi_openspace, best, rtt) = MEASUREMENT.unpack_from(payload)
+        return [seq, timestamp, f'{peer:012x}', METHODS.get(method, method),
+                QUALITIES.get(quality, quality), int(bool(flags & FLAG_PUBLISHED)),
+                f'{distance:.3f}', f'{confidence:.3f}', f'{ifft:.3f}', f'{phase_slope:.3f}',
+                f'{rssi_openspace:.3f}', f'{best:.3f}', f'{rtt:.3f}']
+
+
+def open_input(path, baud):
+    if path == '-':
+        return sys.stdin.buffer.fileno()
+
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        # Raw, so the line discipline does not touch the binary data. Now
+        # rather than after a flush, which would drop what is already
+        # buffered and cut the first frame.
+        tty.setraw(fd, termios.TCSANOW)
+        if baud:
+            attrs = termios.tcgetattr(fd)
+            attrs[4] = attrs[5] = getattr(termios, f'B{baud}')
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('port', help='serial port, pty or capture file, - for stdin')
+    parser.add_argument('--baud', type=int, help='set the serial port speed')
+    parser.add_argument('--stats', action='store_true', help='print rates to stderr every second')
+    parser.add_argument('--quiet', action='store_true', help='do not print measurements')
+    parser.add_argument('--record', type=argparse.FileType('ab'),
+                        help='append the streamed session recording to this file')
+    args = parser.parse_args()
+
+    fd = open_input(args.port, args.baud)
+    records = 0
+    out = sys.stdout
+    rx = Receiver()
+    pending = b''
+    rx_frames = 0
+    started = report_at = time.monotonic()
+
+    if not args.quiet:
+        print(','.join(COLUMNS), file=out)
+
+    while True:
+        try:
+            data = os.read(fd, 65536)
+        except OSError:
+            # The pty goes away with the native_sim process.
+            break
+        if not data:
+            break
+
+        *frames, pending = (pending + data).split(b'\0')
+        lines = []
+        for data in frames:
+            if not data:
+                continue
+            frame = rx.frame(data)
+            if frame is None:
+                continue
+            ftype, seq, payload = frame
+            if ftype == TYPE_RECORD:
+                # Records are whole in every frame, a lost frame only
+                # loses its own record.
+                records += 1
+                if args.record:
+                    args.record.write(payload)
+                continue
+            if ftype != TYPE_MEASUREMENT:
+                rx.unknown += 1
+                continue
+            row = rx.measurement(seq, payload)
+            if row is not None and not args.quiet:
+                lines.append(','.join(map(str, row)))
+        if lines:
+            out.write('\n'.join(lines) + '\n')
+            out.flush()
+        if args.record:
+            args.record.flush()
+
+        now = time.monotonic()
+        if args.stats and now - report_at >= 1:
+            rate = (rx.frames - rx_frames) / (now - report_at)
+            print(f'{rate:.0f} frames/s, {rx.frames} frames, {rx.lost} lost, '
+                  f'{rx.crc_errors} crc errors', file=sys.stderr)
+            rx_frames = rx.frames
+            report_at = now
+
+    elapsed = time.monotonic() - started
+    print(f'{rx.frames} frames in {elapsed:.2f} s, {rx.lost} lost, {rx.crc_errors} crc errors, '
+          f'{rx.unknown} unknown, {records} records', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2026 Kelly Helmut Lord
+#
+# SPDX-License-Identifier: MIT
+#
+"""Print per stage latency percentiles from a CONFIG_DM_TRACE console log.
+
+The initiator dumps its trace rings as "trace: hz <freq> cpu <n> dropped
+<count>" headers followed by "trace: <hex>" lines of 12 byte events (see
+src/inc/trace.h). Events are matched per peer: a ranging request with the
+scan report before it, a result with the oldest open request, a zbus
+publish with its result and a display update with the newest publish not
+yet shown. Pairs further apart than --max-ms, left over from events the
+ring dropped, are ignored.
+"""
+
+import argparse
+import collections
+import re
+import struct
+import sys
+
+EVENT = struct.Struct('<IIBBH')
+
+SCAN, REQUEST, RESULT, PUBLISH, DISPLAY = range(5)
+
+TRANSITIONS = [
+    'scan -> request',
+    'request -> result',
+    'result -> publish',
+    'publish -> display',
+    'scan -> result',
+    'scan -> display',
+]
+
+HEADER_RE = re.compile(r'trace: hz (\d+) cpu (\d+) dropped (\d+)')
+DATA_RE = re.compile(r'trace: ([0-9a-fA-F]+)\s*$')
+
+
+def read_events(lines):
+    """Return (hz, dropped, events) with events as (time, cpu, stage, key, arg)
+    in time order. Cycle counts are unwrapped per CPU, in dump order.
+    """
+    hz = None
+    dropped = {}
+    last = {}
+    wraps = collections.Counter()
+    events = []
+
+    for line in lines:
+        m = HEADER_RE.search(line)
+        if m:
+            hz = int(m.group(1))
+            dropped[int(m.group(2))] = int(m.group(3))
+            continue
+        m = DATA_RE.search(line)
+        if not m or len(m.group(1)) % (2 * EVENT.size):
+            continue
+        data = bytes.fromhex(m.group(1))
+        for cycles, key, stage, cpu, arg in EVENT.iter_unpack(data):
+            if cpu in last and cycles < last[cpu] and last[cpu] - cycles > 1 << 31:
+                wraps[cpu] += 1
+            last[cpu] = cycles
+            events.append((cycles + (wraps[cpu] << 32), cpu, stage, key, arg))
+
+    events.sort()
+    return hz, sum(dropped.values()), events
+
+
+def match(events, max_cycles):
+    """Return the latencies in cycles for each of TRANSITIONS."""
+    latency = {t: [] for t in TRANSITIONS}
+    scan = {}
+    requests = collections.defaultdict(collections.deque)
+    result = {}
+    publish = {}
+
+    def add(name, start, end):
+        if 0 <= end - start <= max_cycles:
+            latency[name].append(end - start)
+
+    for t, _, stage, key, _ in events:
+        if stage == SCAN:
+            scan[key] = t
+        elif stage == REQUEST:
+            start = scan.pop(key, None)
+            if start is not None:
+                add('scan -> request', start, t)
+            requests[key].append((t, start))
+        elif stage == RESULT:
+            if not requests[key]:
+                continue
+            req, start = requests[key].popleft()
+            add('request -> result', req, t)
+            if start is not None:
+                add('scan -> result', start, t)
+            result[key] = (t, start)
+        elif stage == PUBLISH:
+            if key not in result:
+                continue
+            res, start = result.pop(key)
+            add('result -> publish', res, t)
+            publish[key] = (t, start)
+        elif stage == DISPLAY:
+            if key not in publish:
+                continue
+            pub, start = publish.pop(key)
+            add('publish -> display', pub, t)
+            if start is not None:
+                add('scan -> display', start, t)
+
+    return latency
+
+
+def percentile(values, p):
+    """Nearest rank percentile of sorted values."""
+    rank = max(1, -(-len(values) * p // 100))
+    return values[rank - 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('log', nargs='?', type=argparse.FileType('r'), default=sys.stdin,
+                        help='console log, stdin if omitted')
+    parser.add_argument('--max-ms', type=float, default=1000,
+                        help='ignore stage pairs further apart than this (default 1000)')
+    args = parser.parse_args()
+
+    hz, dropped, events = read_events(args.log)
+    if hz is None or not events:
+        sys.exit('No trace events found')
+
+    latency = match(events, args.max_ms * hz / 1000)
+    us = 1e6 / hz
+
+    print(f'{len(events)} events, {dropped} dropped, {hz} Hz')
+    print(f'{"stage":<20} {"count":>7} {"p50 us":>10} {"p95 us":>10} {"p99 us":>10} {"max us":>10}')
+    for name in TRANSITIONS:
+        values = sorted(latency[name])
+        if not values:
+            print(f'{name:<20} {0:>7}')
+            continue
+        row = [percentile(values, p) * us for p in (50, 95, 99)] + [values[-1] * us]
+        print(f'{name:<20} {len(values):>7} ' + ' '.join(f'{v:>10.0f}' for v in row))
+
+
+if __name__ == '__main__':
+    main()
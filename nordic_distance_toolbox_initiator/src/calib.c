@@ -0,0 +1,391 @@
+#include <calib.h>
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#ifdef CONFIG_SHELL
+#include <stdlib.h>
+#include <zephyr/shell/shell.h>
+#endif
+
+LOG_MODULE_REGISTER(calib, LOG_LEVEL_DBG);
+
+#define NUM_METHODS 2
+#define NUM_PEERS CONFIG_DM_CALIB_PEERS
+#define SESSION_SAMPLES CONFIG_DM_CALIB_SAMPLES
+
+/* A method needs this many samples for its session to count. */
+#define SESSION_MIN_SAMPLES MAX(SESSION_SAMPLES / 4, 3)
+
+#define MIN_SPREAD_M (CONFIG_DM_CALIB_MIN_SPREAD_CM / 100.0f)
+#define SCALE_MIN 0.5f
+#define SCALE_MAX 2.0f
+
+#define SETTINGS_ROOT "ndt/cal"
+#define SETTINGS_BOARD "board"
+#define SETTINGS_PEERS "peers"
+
+struct calib_param {
+    float scale;
+    float offset;
+};
+
+/* Persisted per peer, most recently calibrated first. */
+struct calib_record {
+    uint64_t addr_int;
+    struct calib_fit fit[NUM_METHODS];
+};
+
+static struct k_spinlock lock;
+
+static struct calib_fit board_fit[NUM_METHODS];
+static struct calib_param board_param[NUM_METHODS];
+static struct calib_record peer_rec[NUM_PEERS];
+static struct calib_param peer_param[NUM_PEERS][NUM_METHODS];
+
+static struct {
+    bool running;
+    uint64_t peer_id;
+    float reference;
+    float samples[NUM_METHODS][SESSION_SAMPLES];
+    uint8_t count[NUM_METHODS];
+} session;
+
+static void session_finish(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(finish_work, session_finish);
+
+static const char *const method_name[NUM_METHODS] = {"MCPD", "RTT"};
+
+static const struct calib_param default_param[NUM_METHODS] = {
+    {.scale = 1.0f, .offset = CONFIG_DM_MCPD_DISTANCE_OFFSET_CM / 100.0f},
+    {.scale = 1.0f, .offset = CONFIG_DM_RTT_DISTANCE_OFFSET_CM / 100.0f},
+};
+
+static int method_index(enum dm_ranging_mode method) {
+    return method == DM_RANGING_MODE_RTT ? 1 : 0;
+}
+
+void calib_fit_add(struct calib_fit *fit, float reference, float raw) {
+    fit->n++;
+    fit->sx += reference;
+    fit->sy += raw;
+    fit->sxx += reference * reference;
+    fit->sxy += reference * raw;
+}
+
+int calib_fit_solve(const struct calib_fit *fit, float *scale, float *offset) {
+    if (fit->n == 0) {
+        return -ENODATA;
+    }
+
+    float mx = fit->sx / fit->n;
+    float my = fit->sy / fit->n;
+    float var = fit->sxx / fit->n - mx * mx;
+
+    *scale = 1.0f;
+    if (var >= MIN_SPREAD_M * MIN_SPREAD_M) {
+        float s = (fit->sxy / fit->n - mx * my) / var;
+
+        if (s >= SCALE_MIN && s <= SCALE_MAX) {
+            *scale = s;
+        }
+    }
+    *offset = my - *scale * mx;
+    return 0;
+}
+
+static void param_update(struct calib_param *param, const struct calib_fit *fit, int m) {
+    if (calib_fit_solve(fit, &param->scale, &param->offset)) {
+        *param = default_param[m];
+    }
+}
+
+static void params_update(void) {
+    for (int m = 0; m < NUM_METHODS; m++) {
+        param_update(&board_param[m], &board_fit[m], m);
+        for (int i = 0; i < NUM_PEERS; i++) {
+            param_update(&peer_param[i][m], &peer_rec[i].fit[m], m);
+        }
+    }
+}
+
+static int peer_find(uint64_t addr_int) {
+    for (int i = 0; i < NUM_PEERS; i++) {
+        if (peer_rec[i].addr_int == addr_int && addr_int != 0) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+float calib_apply(const struct peer *p, enum dm_ranging_mode method, float distance) {
+    int m = method_index(method);
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    int i = p != NULL ? peer_find(p->addr_int) : -ENOENT;
+    const struct calib_param *param = &board_param[m];
+
+    /* A peer without its own fit for this method uses the board's. */
+    if (i >= 0 && peer_rec[i].fit[m].n > 0) {
+        param = &peer_param[i][m];
+    }
+    distance = (distance - param->offset) / param->scale;
+    k_spin_unlock(&lock, key);
+
+    return distance;
+}
+
+int calib_start(uint64_t peer_id, float reference_m) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (session.running) {
+        k_spin_unlock(&lock, key);
+        return -EBUSY;
+    }
+    memset(&session, 0, sizeof(session));
+    session.running = true;
+    session.peer_id = peer_id;
+    session.reference = reference_m;
+    k_spin_unlock(&lock, key);
+
+    k_work_reschedule(&finish_work, K_MSEC(CONFIG_DM_CALIB_TIMEOUT_MS));
+    LOG_INF("Calibrating at %d cm", (int)(reference_m * 100));
+    return 0;
+}
+
+void calib_sample(const struct peer *p, enum dm_ranging_mode method, float distance) {
+    int m = method_index(method);
+    bool full = false;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (session.running && p != NULL) {
+        if (session.peer_id == 0) {
+            session.peer_id = p->addr_int;
+        }
+        if (session.peer_id == p->addr_int && session.count[m] < SESSION_SAMPLES) {
+            session.samples[m][session.count[m]++] = distance;
+            full = session.count[m] == SESSION_SAMPLES;
+        }
+    }
+    k_spin_unlock(&lock, key);
+
+    if (full) {
+        k_work_reschedule(&finish_work, K_NO_WAIT);
+    }
+}
+
+bool calib_running(void) {
+    return session.running;
+}
+
+static float median(float *v, int n) {
+    for (int i = 1; i < n; i++) {
+        float x = v[i];
+        int j = i;
+
+        for (; j > 0 && v[j - 1] > x; j--) {
+            v[j] = v[j - 1];
+        }
+        v[j] = x;
+    }
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/* Move the record for addr_int to the front, dropping the least recently
+ * calibrated peer if it is new.
+ */
+static struct calib_record *peer_promote(uint64_t addr_int) {
+    int i = peer_find(addr_int);
+    struct calib_record rec = {.addr_int = addr_int};
+
+    if (i >= 0) {
+        rec = peer_rec[i];
+    }
+    else {
+        i = NUM_PEERS - 1;
+    }
+    memmove(&peer_rec[1], &peer_rec[0], i * sizeof(peer_rec[0]));
+    peer_rec[0] = rec;
+    return &peer_rec[0];
+}
+
+static void session_finish(struct k_work *work) {
+    static float samples[NUM_METHODS][SESSION_SAMPLES];
+    uint8_t count[NUM_METHODS];
+    uint64_t peer_id;
+    float reference;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    if (!session.running) {
+        k_spin_unlock(&lock, key);
+        return;
+    }
+    memcpy(samples, session.samples, sizeof(samples));
+    memcpy(count, session.count, sizeof(count));
+    peer_id = session.peer_id;
+    reference = session.reference;
+    session.running = false;
+    k_spin_unlock(&lock, key);
+
+    /* The median keeps multipath outliers out of the fit. */
+    float raw[NUM_METHODS];
+    bool used[NUM_METHODS];
+    bool any = false;
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        used[m] = count[m] >= SESSION_MIN_SAMPLES;
+        if (used[m]) {
+            raw[m] = median(samples[m], count[m]);
+            any = true;
+            LOG_INF("%s: median %d cm over %u samples at %d cm", method_name[m],
+                    (int)(raw[m] * 100), count[m], (int)(reference * 100));
+        }
+    }
+    if (!any) {
+        LOG_WRN("Calibration failed, not enough measurements");
+        return;
+    }
+
+    struct calib_fit board[NUM_METHODS];
+    static struct calib_record peers[NUM_PEERS];
+
+    key = k_spin_lock(&lock);
+    struct calib_record *rec = peer_promote(peer_id);
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        if (used[m]) {
+            calib_fit_add(&board_fit[m], reference, raw[m]);
+            calib_fit_add(&rec->fit[m], reference, raw[m]);
+        }
+    }
+    params_update();
+    memcpy(board, board_fit, sizeof(board));
+    memcpy(peers, peer_rec, sizeof(peers));
+    k_spin_unlock(&lock, key);
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        if (used[m]) {
+            LOG_INF("%s: scale %d/1000, offset %d cm", method_name[m],
+                    (int)(board_param[m].scale * 1000), (int)(board_param[m].offset * 100));
+        }
+    }
+
+    int err = settings_save_one(SETTINGS_ROOT "/" SETTINGS_BOARD, board, sizeof(board));
+    if (err == 0) {
+        err = settings_save_one(SETTINGS_ROOT "/" SETTINGS_PEERS, peers, sizeof(peers));
+    }
+    if (err) {
+        LOG_ERR("Failed to store calibration (err %d)", err);
+    }
+}
+
+int calib_reset(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    memset(board_fit, 0, sizeof(board_fit));
+    memset(peer_rec, 0, sizeof(peer_rec));
+    params_update();
+    k_spin_unlock(&lock, key);
+
+    int err = settings_delete(SETTINGS_ROOT "/" SETTINGS_BOARD);
+    if (err == 0) {
+        err = settings_delete(SETTINGS_ROOT "/" SETTINGS_PEERS);
+    }
+    return err;
+}
+
+static int calib_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg) {
+    const char *next;
+    ssize_t ret;
+
+    if (settings_name_steq(name, SETTINGS_BOARD, &next) && !next) {
+        if (len != sizeof(board_fit)) {
+            return -EINVAL;
+        }
+        ret = read_cb(cb_arg, board_fit, sizeof(board_fit));
+    }
+    else if (settings_name_steq(name, SETTINGS_PEERS, &next) && !next) {
+        /* The table may have been stored with another CONFIG_DM_CALIB_PEERS,
+         * keep the most recent records that fit.
+         */
+        if (len % sizeof(peer_rec[0])) {
+            return -EINVAL;
+        }
+        ret = read_cb(cb_arg, peer_rec, MIN(len, sizeof(peer_rec)));
+    }
+    else {
+        return -ENOENT;
+    }
+    return ret < 0 ? ret : 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(ndt_cal, SETTINGS_ROOT, NULL, calib_set, NULL, NULL);
+
+int calib_init(void) {
+    params_update();
+
+    int err = settings_subsys_init();
+    if (err) {
+        return err;
+    }
+    err = settings_load_subtree(SETTINGS_ROOT);
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    params_update();
+    k_spin_unlock(&lock, key);
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        if (board_fit[m].n > 0) {
+            LOG_INF("%s: scale %d/1000, offset %d cm from %u sessions", method_name[m],
+                    (int)(board_param[m].scale * 1000), (int)(board_param[m].offset * 100),
+                    board_fit[m].n);
+        }
+    }
+    return err;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_calib(const struct shell *sh, size_t argc, char **argv) {
+    if (strcmp(argv[1], "reset") == 0) {
+        int err = calib_reset();
+
+        if (err) {
+            shell_error(sh, "Failed to delete stored calibrations (err %d)", err);
+            return err;
+        }
+        shell_print(sh, "Calibrations cleared, the Kconfig offsets apply");
+        return 0;
+    }
+
+    char *end;
+    long cm = strtol(argv[1], &end, 10);
+    uint64_t peer_id = 0;
+
+    if (*end != '\0' || cm <= 0) {
+        shell_error(sh, "Reference distance must be a positive number of cm");
+        return -EINVAL;
+    }
+    if (argc > 2) {
+        peer_id = strtoull(argv[2], &end, 16);
+        if (*end != '\0' || peer_id == 0) {
+            shell_error(sh, "Unknown address %s, see \"ndt peers\"", argv[2]);
+            return -EINVAL;
+        }
+    }
+
+    int err = calib_start(peer_id, cm / 100.0f);
+
+    if (err) {
+        shell_error(sh, "Calibration already running");
+        return err;
+    }
+    shell_print(sh, "Calibrating at %ld cm with %s, results are logged", cm,
+                argc > 2 ? argv[2] : "the next peer measured");
+    return 0;
+}
+
+SHELL_SUBCMD_ADD((ndt), calib, NULL,
+                 "Calibrate with a peer at a known distance: <cm> [address], or reset",
+                 cmd_calib, 2, 1);
+#endif
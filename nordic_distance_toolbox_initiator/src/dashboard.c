@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include <oled.h>
+
+#define MAX_ENTRIES CONFIG_BT_SCAN_UUID_CNT
+#define ROWS CONFIG_DISPLAY_DASHBOARD_ROWS
+#define ROW_HEIGHT 16
+#define AGE_TICK_MS 1000
+
+struct dash_entry {
+    uint64_t peer_id;
+    float distance;
+    uint32_t timestamp;
+};
+
+struct dash_row {
+    struct text_label id;
+    struct text_label distance;
+    struct text_label age;
+};
+
+/* Kept sorted by distance, nearest first. */
+static struct dash_entry entries[MAX_ENTRIES];
+static int entry_count;
+
+/* All LVGL objects are created once in dashboard_init(). */
+static struct dash_row rows[ROWS];
+static struct text_label page_label;
+
+static int page;
+static uint32_t page_shown_at;
+
+static void entry_swap(int a, int b) {
+    struct dash_entry tmp = entries[a];
+
+    entries[a] = entries[b];
+    entries[b] = tmp;
+}
+
+/* A single entry changed, so one insertion step in each direction restores
+ * the order without sorting the whole table.
+ */
+static void entry_reposition(int i) {
+    while (i > 0 && entries[i - 1].distance > entries[i].distance) {
+        entry_swap(i - 1, i);
+        i--;
+    }
+    while (i < entry_count - 1 && entries[i + 1].distance < entries[i].distance) {
+        entry_swap(i, i + 1);
+        i++;
+    }
+}
+
+void dashboard_update(const struct dm_data *data) {
+    int i;
+
+    for (i = 0; i < entry_count; i++) {
+        if (entries[i].peer_id == data->peer_id) {
+            break;
+        }
+    }
+
+    if (i == entry_count) {
+        if (entry_count < MAX_ENTRIES) {
+            entry_count++;
+        }
+        else {
+            /* Full: the farthest peer makes room. */
+            i = entry_count - 1;
+        }
+    }
+
+    entries[i].peer_id = data->peer_id;
+    entries[i].distance = data->distance;
+    entries[i].timestamp = data->timestamp;
+    entry_reposition(i);
+}
+
+static void entries_expire(uint32_t now) {
+    int kept = 0;
+
+    for (int i = 0; i < entry_count; i++) {
+        if (now - entries[i].timestamp <= CONFIG_DM_PEER_IDLE_TIMEOUT_MS) {
+            entries[kept++] = entries[i];
+        }
+    }
+    entry_count = kept;
+}
+
+void dashboard_init(lv_obj_t *screen) {
+    for (int i = 0; i < ROWS; i++) {
+        lv_coord_t y = (i + 1) * ROW_HEIGHT;
+
+        label_init(&rows[i].id, screen);
+        lv_obj_set_pos(rows[i].id.obj, 0, y);
+
+        label_init(&rows[i].distance, screen);
+        lv_obj_set_pos(rows[i].distance.obj, 44, y);
+
+        label_init(&rows[i].age, screen);
+        lv_obj_align(rows[i].age.obj, LV_ALIGN_TOP_RIGHT, 0, y);
+    }
+
+    lv_obj_t *title = lv_label_create(screen);
+    lv_label_set_text(title, "Nearest");
+    lv_obj_set_pos(title, 0, 0);
+
+    label_init(&page_label, screen);
+    lv_obj_align(page_label.obj, LV_ALIGN_TOP_RIGHT, 0, 0);
+}
+
+bool dashboard_render(uint32_t now, uint32_t *next_ms) {
+    char text[16];
+    bool changed = false;
+
+    entries_expire(now);
+
+    int pages = MAX(DIV_ROUND_UP(entry_count, ROWS), 1);
+
+    if (now - page_shown_at >= CONFIG_DISPLAY_PAGE_MS) {
+        page = (page + 1) % pages;
+        page_shown_at = now;
+    }
+    if (page >= pages) {
+        page = 0;
+    }
+
+    if (pages > 1) {
+        snprintf(text, sizeof(text), "%d/%d", page + 1, pages);
+    }
+    else {
+        snprintf(text, sizeof(text), "%d peers", entry_count);
+    }
+    changed |= label_update(&page_label, text);
+
+    for (int row = 0; row < ROWS; row++) {
+        int i = page * ROWS + row;
+
+        if (i >= entry_count) {
+            changed |= label_update(&rows[row].id, "");
+            changed |= label_update(&rows[row].distance, "");
+            changed |= label_update(&rows[row].age, "");
+            continue;
+        }
+
+        snprintf(text, sizeof(text), "%04X", (unsigned int)(entries[i].peer_id & 0xFFFF));
+        changed |= label_update(&rows[row].id, text);
+
+        snprintf(text, sizeof(text), "%.1fm", entries[i].distance);
+        changed |= label_update(&rows[row].distance, text);
+
+        snprintf(text, sizeof(text), "%us", (now - entries[i].timestamp) / 1000);
+        changed |= label_update(&rows[row].age, text);
+    }
+
+    uint32_t next_page = page_shown_at + CONFIG_DISPLAY_PAGE_MS;
+    uint32_t next_tick = now + AGE_TICK_MS - (now % AGE_TICK_MS);
+
+    *next_ms = (pages > 1 && (int32_t)(next_page - next_tick) < 0) ? next_page : next_tick;
+    if (entry_count == 0) {
+        *next_ms = now + CONFIG_DISPLAY_PAGE_MS;
+    }
+    return changed;
+}
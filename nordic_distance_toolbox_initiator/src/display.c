@@ -2,39 +2,277 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/zbus/zbus.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <zephyr/drivers/display.h>
 #include <lvgl.h>
 
 #include <messages.h>
+#include <oled.h>
+#include <seqlock.h>
+#include <trace.h>
+
+#ifdef CONFIG_DM_SIM
+#include <sim.h>
+#endif
 
 #include <dm.h>
 
 
 LOG_MODULE_REGISTER(display, LOG_LEVEL_DBG);
 
-ZBUS_CHAN_DEFINE(dm_chan, struct dm_data, NULL, NULL, ZBUS_OBSERVERS(dm_listener), ZBUS_MSG_INIT(0));
+#define NUM_SLOTS CONFIG_BT_SCAN_UUID_CNT
+
+/* Latest measurement per peer, handed from the publisher to the display
+ * thread through a seqlock. The publisher overwrites in place and never
+ * waits, the display thread only ever sees complete messages.
+ */
+struct dm_slot {
+    struct seqlock lock;
+    struct dm_data data;
+};
+
+static struct dm_slot slots[NUM_SLOTS];
+
+/* Publisher side bookkeeping, only touched from the listener. */
+static uint64_t slot_owner[NUM_SLOTS];
+static uint32_t slot_written[NUM_SLOTS];
+
+/* Display thread side: sequence of the last message consumed per slot. */
+static uint32_t slot_consumed[NUM_SLOTS];
 
-const struct dm_data *data = NULL;
+K_SEM_DEFINE(display_sem, 0, 1);
+
+static int slot_claim(uint64_t peer_id) {
+    int oldest = 0;
+
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        if (slot_written[i] != 0 && slot_owner[i] == peer_id) {
+            return i;
+        }
+        if (slot_written[i] == 0) {
+            return i;
+        }
+        if ((int32_t)(slot_written[i] - slot_written[oldest]) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
 
 static void dm_zbus_handler(const struct zbus_channel *chan) {
-    data = zbus_chan_const_msg(chan);
+    const struct dm_data *data = zbus_chan_const_msg(chan);
+    int i = slot_claim(data->peer_id);
+
+    seqlock_write_begin(&slots[i].lock);
+    slots[i].data = *data;
+    seqlock_write_end(&slots[i].lock);
+
+    slot_owner[i] = data->peer_id;
+    slot_written[i] = k_uptime_get_32() | 1;
+
+    k_sem_give(&display_sem);
 }
 
 ZBUS_LISTENER_DEFINE(dm_listener, dm_zbus_handler);
 
+ZBUS_CHAN_DEFINE(dm_chan, struct dm_data, NULL, NULL, ZBUS_OBSERVERS(dm_listener), ZBUS_MSG_INIT(0));
+
+#define FRAME_INTERVAL_MS (1000 / CONFIG_DISPLAY_MAX_FPS)
+
+static struct display_stats stats;
+
+/* Every field is updated under the lock, handler_us is 64 bits and
+ * "ndt stats" must not see half an update.
+ */
+static struct k_spinlock stats_lock;
+
+void display_get_stats(struct display_stats *out) {
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    *out = stats;
+    k_spin_unlock(&stats_lock, key);
+}
+
+/* Called by LVGL after every refresh with the number of pixels flushed. */
+static void display_monitor(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px) {
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    stats.frames++;
+    stats.pixels += px;
+    k_spin_unlock(&stats_lock, key);
+}
+
+static void counter_inc(uint32_t *counter) {
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    (*counter)++;
+    k_spin_unlock(&stats_lock, key);
+}
+
+static void task_handler(void) {
+    /* The virtual clock of native_sim stands still while LVGL renders, the
+     * host clock does not.
+     */
+#ifdef CONFIG_DM_SIM
+    uint64_t start = sim_host_time_us();
+#else
+    uint32_t start = k_cycle_get_32();
+#endif
+
+    lv_task_handler();
+    /* Flush right away instead of waiting for LVGL's refresh timer, the
+     * thread may not run again until the next measurement.
+     */
+    lv_refr_now(NULL);
+
+#ifdef CONFIG_DM_SIM
+    uint64_t us = sim_host_time_us() - start;
+#else
+    uint64_t us = k_cyc_to_us_floor64(k_cycle_get_32() - start);
+#endif
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    stats.handler_us += us;
+    k_spin_unlock(&stats_lock, key);
+}
+
+void label_init(struct text_label *label, lv_obj_t *parent) {
+    label->obj = lv_label_create(parent);
+    label->text[0] = '\0';
+    lv_label_set_text(label->obj, label->text);
+}
+
+/* Only touch LVGL when the text actually changes, so an unchanged reading
+ * causes no invalidation and no transfer to the panel.
+ */
+bool label_update(struct text_label *label, const char *text) {
+    if (strncmp(label->text, text, sizeof(label->text)) == 0) {
+        return false;
+    }
+    strncpy(label->text, text, sizeof(label->text) - 1);
+    lv_label_set_text(label->obj, label->text);
+    return true;
+}
+
+#ifdef CONFIG_DISPLAY_MODE_SINGLE
+static struct text_label ranging_label;
+static struct text_label distance_label;
+
+static void view_init(lv_obj_t *screen, lv_obj_t *logo_img) {
+    lv_obj_align(logo_img, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_img_set_zoom(logo_img, 256);
+
+    label_init(&ranging_label, screen);
+    label_update(&ranging_label, "N/A");
+    lv_obj_align(ranging_label.obj, LV_ALIGN_TOP_RIGHT, 0, 0);
+
+    label_init(&distance_label, screen);
+    label_update(&distance_label, "n/a m");
+	lv_obj_align(distance_label.obj, LV_ALIGN_CENTER, 0, 0);
+}
+
+static bool view_render(const struct dm_data *data, uint32_t now, uint32_t *next_ms) {
+    char dist_str[16];
+    bool changed = false;
+
+    *next_ms = now + UINT16_MAX;
+
+    /* Only the most recent measurement is shown. */
+    if (data == NULL) {
+        return false;
+    }
+
+    snprintf(dist_str, sizeof(dist_str), "%.2f m", data->distance);
+    changed |= label_update(&distance_label, dist_str);
+
+    if (data->ranging_method == DM_RANGING_MODE_MCPD) {
+        changed |= label_update(&ranging_label, "MCPD");
+    }
+
+    if (data->ranging_method == DM_RANGING_MODE_RTT) {
+        changed |= label_update(&ranging_label, "RTT");
+    }
+
+    return changed;
+}
+#endif
+
+#ifdef CONFIG_DISPLAY_MODE_DASHBOARD
+static void view_init(lv_obj_t *screen, lv_obj_t *logo_img) {
+    lv_obj_add_flag(logo_img, LV_OBJ_FLAG_HIDDEN);
+    dashboard_init(screen);
+}
+
+static bool view_render(const struct dm_data *data, uint32_t now, uint32_t *next_ms) {
+    return dashboard_render(now, next_ms);
+}
+#endif
+
+static void measurement_add(const struct dm_data *data) {
+#ifdef CONFIG_DISPLAY_MODE_DASHBOARD
+    dashboard_update(data);
+#endif
+}
+
+/* Bounded, so a reader that preempted the writer mid-update gives up
+ * and tries again on the next wakeup instead of spinning.
+ */
+#define READ_ATTEMPTS 4
+
+/* Copy out every slot updated since the last call. Returns the number of
+ * new measurements, the most recent one is left in *latest.
+ */
+static int collect_measurements(struct dm_data *latest, bool *retry_later) {
+    int count = 0;
+
+    for (int i = 0; i < NUM_SLOTS; i++) {
+        struct dm_data data;
+        uint32_t seq;
+        int attempt;
+
+        for (attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            seq = seqlock_read_begin(&slots[i].lock);
+            if (seq == slot_consumed[i]) {
+                break;
+            }
+            data = slots[i].data;
+            if (!seqlock_read_retry(&slots[i].lock, seq)) {
+                break;
+            }
+            counter_inc(&stats.read_retries);
+        }
+
+        if (attempt == READ_ATTEMPTS) {
+            *retry_later = true;
+            continue;
+        }
+        if (seq == slot_consumed[i]) {
+            continue;
+        }
+
+        slot_consumed[i] = seq;
+        measurement_add(&data);
+        if (count == 0 || (int32_t)(data.timestamp - latest->timestamp) >= 0) {
+            *latest = data;
+        }
+        count++;
+    }
+    return count;
+}
+
 void display(void *p1, void *p2, void *p3)
 {
     const struct device *display_dev;
 
 	display_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
-    int err = device_is_ready(display_dev);
-    LOG_INF("Error: %d", err);
 	if (!device_is_ready(display_dev)) {
         LOG_ERR("Device not ready, aborting test");
 		return;
 	}
 
+    lv_disp_get_default()->driver->monitor_cb = display_monitor;
+
     LV_IMG_DECLARE(logo);
 
     lv_obj_t *logo_img = lv_img_create(lv_scr_act());
@@ -44,43 +282,60 @@ void display(void *p1, void *p2, void *p3)
     lv_obj_t *title_label = lv_label_create(lv_scr_act());
     lv_label_set_text(title_label, "Distance Toolbox");
     lv_obj_align(title_label, LV_ALIGN_BOTTOM_MID, 0, 0);
-	lv_task_handler();
+	task_handler();
 
     k_msleep(5000);
 
-    lv_obj_align(logo_img, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_img_set_zoom(logo_img, 256);
-
-    lv_obj_t *ranging_label = lv_label_create(lv_scr_act());
+    lv_obj_add_flag(title_label, LV_OBJ_FLAG_HIDDEN);
+    view_init(lv_scr_act(), logo_img);
 
-    lv_label_set_text(ranging_label, "N/A");
+	task_handler();
+	display_blanking_off(display_dev);
 
-    lv_obj_align(ranging_label, LV_ALIGN_TOP_RIGHT, 0, 0);
+    struct dm_data data;
+    uint32_t next_render = k_uptime_get_32();
+    uint32_t next_frame = 0;
+    bool retry_later = false;
 
-    lv_obj_t *distance_label = lv_label_create(lv_scr_act());
-	lv_obj_align(distance_label, LV_ALIGN_CENTER, 0, 0);
+    while (true) {
+        int32_t timeout = next_render - k_uptime_get_32();
+        const struct dm_data *latest = NULL;
 
-	lv_task_handler();
-	display_blanking_off(display_dev);
+        /* Sleep until a measurement arrives or the view needs its own update. */
+        if (k_sem_take(&display_sem, timeout > 0 ? K_MSEC(timeout) : K_NO_WAIT) == 0) {
+            counter_inc(&stats.wakeups);
 
-    char dist_str[64] = "n/a m";
+            /* Cap the frame rate, newer measurements simply replace older
+             * ones in their slot meanwhile.
+             */
+            int32_t frame_wait = next_frame - k_uptime_get_32();
+            if (frame_wait > 0) {
+                k_msleep(frame_wait);
+            }
 
-    while (true) {
-        if (data != NULL) {
-            snprintf(dist_str, 64, "%.2f m", data->distance);
+            if (collect_measurements(&data, &retry_later) > 0) {
+                latest = &data;
+            }
         }
-        lv_label_set_text(distance_label, dist_str);
 
-        if (data->ranging_method == DM_RANGING_MODE_MCPD) {
-            lv_label_set_text(ranging_label, "MCPD");
-        }
+        uint32_t now = k_uptime_get_32();
 
-        if (data->ranging_method == DM_RANGING_MODE_RTT) {
-            lv_label_set_text(ranging_label, "RTT");
+        if (view_render(latest, now, &next_render)) {
+            task_handler();
+            next_frame = k_uptime_get_32() + FRAME_INTERVAL_MS;
+
+            /* Only a measurement that changed what is shown reached the panel. */
+            if (latest != NULL) {
+                TRACE(TRACE_DISPLAY, latest->peer_id, 0);
+            }
         }
 
-        lv_task_handler();
-        k_msleep(100);
+        /* Let the publisher finish the write we raced with. */
+        if (retry_later) {
+            retry_later = false;
+            k_msleep(1);
+            k_sem_give(&display_sem);
+        }
     }
 }
 
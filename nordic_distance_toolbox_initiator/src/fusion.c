@@ -0,0 +1,194 @@
+#include <fusion.h>
+
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+
+enum {
+    EST_IFFT,
+    EST_PHASE_SLOPE,
+    EST_RSSI,
+    EST_COUNT,
+};
+
+static float quality_weight(enum dm_quality quality) {
+    switch (quality) {
+    case DM_QUALITY_OK:
+        return 1.0f;
+    case DM_QUALITY_POOR:
+        return 0.5f;
+    default:
+        return 0.0f;
+    }
+}
+
+#ifdef CONFIG_DM_FUSION
+#define INIT_VAR ((CONFIG_DM_FUSION_INIT_STD_CM / 100.0f) * (CONFIG_DM_FUSION_INIT_STD_CM / 100.0f))
+#define MIN_VAR (0.05f * 0.05f)
+#define OUTLIER_SIGMA CONFIG_DM_FUSION_OUTLIER_SIGMA
+
+struct fusion_state {
+    uint64_t addr_int;
+    bool valid;
+    float var[EST_COUNT];
+};
+
+static struct fusion_state state[NUM_PEERS];
+
+static float median(const float *v, int n) {
+    float sorted[EST_COUNT];
+
+    for (int i = 0; i < n; i++) {
+        int j = i;
+
+        while (j > 0 && sorted[j - 1] > v[i]) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v[i];
+    }
+    return (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+static struct fusion_state *peer_state(const struct peer *p) {
+    if (p == NULL) {
+        return NULL;
+    }
+
+    struct fusion_state *s = &state[peer_slot(p)];
+
+    if (!s->valid || s->addr_int != p->addr_int) {
+        s->addr_int = p->addr_int;
+        s->valid = true;
+        for (int i = 0; i < EST_COUNT; i++) {
+            s->var[i] = INIT_VAR;
+        }
+    }
+    return s;
+}
+
+/* best is one of the other estimates picked by the DM library, fusing it too
+ * would count that estimate twice. A poor quality result weighs each of its
+ * estimates down, which widens the spread and, in the variance update, lets
+ * it move the per-peer variances less.
+ */
+static int fuse_mcpd(struct fusion_state *s, const struct dm_result *result, float qw,
+                     float *distance, float *spread) {
+    const float est[EST_COUNT] = {
+        [EST_IFFT] = result->dist_estimates.mcpd.ifft,
+        [EST_PHASE_SLOPE] = result->dist_estimates.mcpd.phase_slope,
+        [EST_RSSI] = result->dist_estimates.mcpd.rssi_openspace,
+    };
+    float valid[EST_COUNT];
+    int n = 0;
+
+    for (int i = 0; i < EST_COUNT; i++) {
+        if (isfinite(est[i]) && est[i] >= 0) {
+            valid[n++] = est[i];
+        }
+    }
+    if (n == 0) {
+        return -EINVAL;
+    }
+
+    float ref = median(valid, n);
+    float wsum = 0;
+    float sum = 0;
+    bool used[EST_COUNT] = {0};
+
+    for (int i = 0; i < EST_COUNT; i++) {
+        float var = s ? s->var[i] : INIT_VAR;
+
+        if (!isfinite(est[i]) || est[i] < 0) {
+            continue;
+        }
+        if (fabsf(est[i] - ref) > OUTLIER_SIGMA * sqrtf(var)) {
+            continue;
+        }
+        used[i] = true;
+        wsum += qw / var;
+        sum += qw * est[i] / var;
+    }
+
+    /* Everything disagreed with the median, fall back to it. */
+    if (wsum == 0) {
+        float var = s ? s->var[0] : INIT_VAR;
+
+        for (int i = 1; s && i < EST_COUNT; i++) {
+            if (s->var[i] > var) {
+                var = s->var[i];
+            }
+        }
+        *distance = ref;
+        *spread = sqrtf(var / qw);
+        return 0;
+    }
+
+    *distance = sum / wsum;
+    *spread = sqrtf(1.0f / wsum);
+
+    if (s == NULL) {
+        return 0;
+    }
+
+    /* Track how far each sub-estimate strays from the fused value. Outliers
+     * count with a capped residual so that a consistently wrong estimator
+     * loses weight without one bad sample blowing up its variance.
+     */
+    for (int i = 0; i < EST_COUNT; i++) {
+        if (!isfinite(est[i]) || est[i] < 0) {
+            continue;
+        }
+        float resid = est[i] - *distance;
+        float sq = resid * resid;
+        float cap = OUTLIER_SIGMA * OUTLIER_SIGMA * s->var[i];
+
+        if (!used[i] && sq > cap) {
+            sq = cap;
+        }
+        s->var[i] += qw * (sq - s->var[i]) / 8;
+        if (s->var[i] < MIN_VAR) {
+            s->var[i] = MIN_VAR;
+        }
+    }
+    return 0;
+}
+
+#endif /* CONFIG_DM_FUSION */
+
+int fusion_update(const struct peer *p, const struct dm_result *result,
+                  float *distance, float *confidence) {
+    float qw = quality_weight(result->quality);
+
+    if (qw == 0) {
+        return -EINVAL;
+    }
+
+    /* RTT has a single estimate, its confidence reflects the method's
+     * typical error so both methods can share one stream.
+     */
+    if (result->ranging_mode == DM_RANGING_MODE_RTT) {
+        *distance = result->dist_estimates.rtt.rtt;
+        *confidence = qw / (1.0f + CONFIG_DM_RTT_NOISE_CM / 100.0f);
+        return 0;
+    }
+
+#ifdef CONFIG_DM_FUSION
+    float spread;
+    int err = fuse_mcpd(peer_state(p), result, qw, distance, &spread);
+    if (err) {
+        return err;
+    }
+
+    /* Confidence falls off as the fused spread approaches a metre. The
+     * quality is already in the spread.
+     */
+    *confidence = 1.0f / (1.0f + spread);
+#else
+    *distance = result->dist_estimates.mcpd.best;
+    *confidence = qw;
+#endif
+    return 0;
+}
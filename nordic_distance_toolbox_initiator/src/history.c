@@ -0,0 +1,140 @@
+#include <history.h>
+
+#include <dm.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_SHELL
+#include <stdlib.h>
+#include <zephyr/shell/shell.h>
+#endif
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define HISTORY_LEN CONFIG_DM_HISTORY_LEN
+
+BUILD_ASSERT(IS_POWER_OF_TWO(HISTORY_LEN), "CONFIG_DM_HISTORY_LEN must be a power of two");
+
+/* Bounded, so a reader that keeps losing to the producer or to a handover
+ * gives up instead of spinning. Each failed attempt yields first.
+ */
+#define READ_ATTEMPTS 4
+
+/* One ring per peer table slot. head counts every sample ever written and
+ * is only advanced after the sample is in place. gen is odd while the ring
+ * is being handed over to a new peer, which readers treat as a retry.
+ */
+struct history_ring {
+    atomic_t head;
+    atomic_t gen;
+    uint64_t owner;
+    struct dm_sample samples[HISTORY_LEN];
+};
+
+static struct history_ring rings[NUM_PEERS];
+
+void history_push(const struct peer *p, const struct dm_sample *sample) {
+    struct history_ring *ring = &rings[peer_slot(p)];
+
+    if (ring->owner != p->addr_int || atomic_get(&ring->gen) == 0) {
+        atomic_inc(&ring->gen);
+        ring->owner = p->addr_int;
+        atomic_set(&ring->head, 0);
+        atomic_inc(&ring->gen);
+    }
+
+    atomic_val_t head = atomic_get(&ring->head);
+
+    ring->samples[head & (HISTORY_LEN - 1)] = *sample;
+    atomic_set(&ring->head, head + 1);
+}
+
+static int ring_copy(struct history_ring *ring, uint64_t peer_id, struct dm_sample *out, size_t max) {
+    atomic_val_t gen = atomic_get(&ring->gen);
+
+    if ((gen & 1) || ring->owner != peer_id) {
+        return -EAGAIN;
+    }
+
+    uint32_t head = atomic_get(&ring->head);
+    uint32_t count = MIN(MIN(head, HISTORY_LEN), max);
+    uint32_t first = head - count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = ring->samples[(first + i) & (HISTORY_LEN - 1)];
+    }
+
+    if (atomic_get(&ring->gen) != gen) {
+        return -EAGAIN;
+    }
+
+    /* The producer may have lapped the oldest entries while they were being
+     * copied, including the slot it is writing right now. Drop those.
+     */
+    uint32_t end = atomic_get(&ring->head);
+    uint32_t valid_from = (end >= HISTORY_LEN) ? end - HISTORY_LEN + 1 : 0;
+
+    if (first >= valid_from) {
+        return count;
+    }
+
+    uint32_t lost = MIN(valid_from - first, count);
+
+    memmove(out, out + lost, (count - lost) * sizeof(*out));
+    return count - lost;
+}
+
+int history_snapshot(uint64_t peer_id, struct dm_sample *out, size_t max) {
+    for (int i = 0; i < NUM_PEERS; i++) {
+        if (rings[i].owner != peer_id) {
+            continue;
+        }
+
+        for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            int ret = ring_copy(&rings[i], peer_id, out, max);
+
+            if (ret != -EAGAIN) {
+                return ret;
+            }
+            if (rings[i].owner != peer_id) {
+                return -ENOENT;
+            }
+            k_yield();
+        }
+        return -EAGAIN;
+    }
+    return -ENOENT;
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_history(const struct shell *sh, size_t argc, char **argv) {
+    static struct dm_sample samples[HISTORY_LEN];
+    char *end;
+    uint64_t addr_int = strtoull(argv[1], &end, 16);
+    uint32_t now = k_uptime_get_32();
+    int count = *end == '\0' ? history_snapshot(addr_int, samples, ARRAY_SIZE(samples)) : -ENOENT;
+
+    if (count == -EAGAIN) {
+        shell_error(sh, "History of %s is busy, try again", argv[1]);
+        return count;
+    }
+    if (count <= 0) {
+        shell_error(sh, "No history for %s, see \"ndt peers\"", argv[1]);
+        return -ENOENT;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const struct dm_sample *s = &samples[i];
+        int cm = (int)(s->distance * 100);
+
+        shell_print(sh, "%6u ms ago %-4s %d.%02d m, confidence %d%%", now - s->timestamp,
+                    s->ranging_method == DM_RANGING_MODE_MCPD ? "MCPD" : "RTT", cm / 100,
+                    cm % 100, (int)(s->confidence * 100));
+    }
+    return 0;
+}
+
+SHELL_SUBCMD_ADD((ndt), history, NULL, "Latest measurements of a peer, oldest first: <address>",
+                 cmd_history, 2, 0);
+#endif
@@ -0,0 +1,59 @@
+#ifndef CALIB_H__
+#define CALIB_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <dm.h>
+#include <peer.h>
+
+/* Raw distances are modelled as raw = scale * true + offset, per ranging
+ * method. A calibration session holds a peer at a known reference distance
+ * and adds the median raw distance of the session as one point to a least
+ * squares fit. The offset is fitted from a single session, the scale needs
+ * sessions at reference distances at least CONFIG_DM_CALIB_MIN_SPREAD_CM
+ * apart.
+ *
+ * Every fit is kept for this board, and for the calibrated peer if it is
+ * one of the last CONFIG_DM_CALIB_PEERS calibrated. Both are persisted with
+ * the settings subsystem. Until calibrated, the Kconfig offset applies.
+ */
+
+/* Sufficient statistics of the fit, x is the reference distance and y the
+ * session median, both in meters.
+ */
+struct calib_fit {
+    uint16_t n;
+    float sx;
+    float sy;
+    float sxx;
+    float sxy;
+};
+
+void calib_fit_add(struct calib_fit *fit, float reference, float raw);
+
+/* Solve fit for scale and offset. Falls back to scale 1 if the reference
+ * distances are too close together or give an implausible scale. Returns
+ * -ENODATA if fit is empty.
+ */
+int calib_fit_solve(const struct calib_fit *fit, float *scale, float *offset);
+
+/* Load stored calibrations, call before the first measurement. */
+int calib_init(void);
+
+/* Correct a raw distance from peer p measured with method. */
+float calib_apply(const struct peer *p, enum dm_ranging_mode method, float distance);
+
+/* Start a session at reference_m. peer_id 0 takes the first peer that
+ * reports a measurement. Returns -EBUSY if a session is running.
+ */
+int calib_start(uint64_t peer_id, float reference_m);
+
+/* Feed a raw, uncorrected distance into a running session. */
+void calib_sample(const struct peer *p, enum dm_ranging_mode method, float distance);
+
+bool calib_running(void);
+
+/* Forget every stored calibration, of this board and of all peers. */
+int calib_reset(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FUSION_H__
+#define FUSION_H__
+
+#include <dm.h>
+#include <peer.h>
+
+/* Turn a DM result into a single distance estimate and a confidence in
+ * [0, 1]. MCPD results combine ifft, phase_slope and rssi_openspace, each
+ * weighted by the result quality over a running per-peer variance of the
+ * sub-estimate, with outliers left out. p may be NULL, in which case all
+ * sub-estimates get equal weight.
+ *
+ * Returns -EINVAL for results that must not be used (CRC failure,
+ * DM_QUALITY_DO_NOT_USE or no usable sub-estimate).
+ */
+int fusion_update(const struct peer *p, const struct dm_result *result,
+                  float *distance, float *confidence);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HISTORY_H__
+#define HISTORY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <peer.h>
+
+struct dm_sample {
+    uint32_t timestamp;
+    float distance;
+    float confidence;
+    uint8_t ranging_method;
+};
+
+/* Append a measurement to p's history. Single producer: only call this from
+ * the DM result callback.
+ */
+void history_push(const struct peer *p, const struct dm_sample *sample);
+
+/* Copy up to max of the most recent samples for peer_id into out, oldest
+ * first. Never blocks the producer; samples overwritten while copying are
+ * left out, and so is the oldest slot of a full ring, which the producer
+ * may be writing. Returns the number of samples copied, -ENOENT if there
+ * is no history for peer_id, or -EAGAIN if the ring kept changing over a
+ * few attempts, the caller may try again later.
+ */
+int history_snapshot(uint64_t peer_id, struct dm_sample *out, size_t max);
+
+#endif
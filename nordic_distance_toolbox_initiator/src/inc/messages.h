@@ -1,7 +1,9 @@
-#include <zephyr/bluetooth/bluetooth.h>
+#include <stdint.h>
 
 struct dm_data {
+	uint64_t peer_id;
+	uint32_t timestamp;
 	float distance;
-	char addr[BT_ADDR_LE_STR_LEN];
-	uint32_t ranging_method;
+	float confidence;
+	uint8_t ranging_method;
 };
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef METHOD_H__
+#define METHOD_H__
+
+#include <stdint.h>
+#include <dm.h>
+#include <peer.h>
+
+enum method_policy {
+    METHOD_POLICY_AUTO,
+    METHOD_POLICY_MCPD,
+    METHOD_POLICY_RTT,
+    METHOD_POLICY_COUNT,
+};
+
+struct method_stats {
+    uint32_t mcpd;    /* MCPD measurements completed */
+    uint32_t rtt;     /* RTT measurements completed */
+    uint32_t skipped; /* opportunities with no method allowed by the policy */
+};
+
+void method_set_policy(enum method_policy policy);
+
+enum method_policy method_get_policy(void);
+
+/* Pick the ranging method for the next measurement with p. In automatic
+ * mode RTT tracks peers that are far away, moving fast or not measured
+ * yet, and MCPD is used for close, slow peers and for peers with a raised
+ * scheduler weight. Returns -ENOTSUP if p supports no method the current
+ * policy allows.
+ */
+int method_select(const struct peer *p, enum dm_ranging_mode *mode);
+
+/* Feed a completed measurement back into the policy. distance should be
+ * the smoothed one, raw RTT samples are too noisy to estimate motion from.
+ */
+void method_report(const struct peer *p, enum dm_ranging_mode mode, float distance, uint32_t now_ms);
+
+void method_get_stats(struct method_stats *stats);
+
+void method_reset_stats(void);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef OLED_H__
+#define OLED_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <lvgl.h>
+
+#include <messages.h>
+
+struct display_stats {
+    uint32_t frames;          /* LVGL refreshes flushed to the panel */
+    uint32_t pixels;          /* pixels LVGL flushed, the panel gets whole pages */
+    uint32_t wakeups;         /* display thread wakeups on new measurements */
+    uint32_t read_retries;    /* snapshot reads that raced the publisher */
+    uint64_t handler_us;      /* time spent in lv_task_handler() */
+};
+
+void display_get_stats(struct display_stats *stats);
+
+struct text_label {
+    lv_obj_t *obj;
+    char text[16];
+};
+
+/* Create an empty label on parent. */
+void label_init(struct text_label *label, lv_obj_t *parent);
+
+/* Set the label text only if it differs from what is already shown.
+ * Returns true if LVGL had to be touched.
+ */
+bool label_update(struct text_label *label, const char *text);
+
+/* Multi-peer dashboard view, owned by the display thread. */
+void dashboard_init(lv_obj_t *screen);
+
+void dashboard_update(const struct dm_data *data);
+
+/* Refresh labels for the current time. Returns true if anything changed
+ * and sets *next_ms to when the view next needs refreshing on its own.
+ */
+bool dashboard_render(uint32_t now, uint32_t *next_ms);
+
+#endif
@@ -2,33 +2,96 @@
 #define PEER_H__
 #include <stdint.h>
 #include <stdbool.h>
+#include <zephyr/bluetooth/addr.h>
 #include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/dlist.h>
 
 struct peer {
     uint32_t rng_seed;
+    /* Advertised base seed and epoch rng_seed was derived from, it is only
+     * derived again when the reflector moves to a new epoch.
+     */
+    uint32_t seed_base;
+    uint16_t seed_epoch;
+    bool seed_set;
     uint64_t addr_int;
     uint32_t color;
     struct bt_uuid_128 uuid;
+    uint32_t id;
     bool filter_set;
     bool is_active;
     uint32_t timestamp;
-    uint32_t ranging_mode;
-};
+    uint32_t last_seen;
+    uint8_t modes;          /* NDT_ADV_MODE_* the reflector supports */
+
+    /* Current ranging interval, adapted to how fast the distance changes. */
+    uint32_t interval_ms;
+    float distance_avg;
+    uint32_t distance_count;
+
+    /* Ranging scheduler state, owned by scheduler.c. */
+    sys_dnode_t sched_node;
+    uint32_t sched_pass;
+    uint32_t sched_deadline;
+    uint32_t sched_last_report;
+    uint32_t sched_report_interval;
+    uint8_t sched_weight;
+    bool sched_ready;
 
-enum ranging_mode {
-    RANGING_MODE_MCPD,
-    RANGING_MODE_RTT,
+    /* Measurement counters, owned by stats.c. */
+    uint32_t stats_since;
+    atomic_t stats_results;
+    atomic_t stats_ok;
 };
 
-#define SUPPORT_MCPD_CODE 0x0D17A9CE
-#define SUPPORT_RTT_CODE 0x1D17A9CE
+/* The scan callbacks change the peer table while the DM callback and the
+ * shell use the peers in it. Hold the peer lock from looking a peer up to
+ * the last use of it: the functions below that change the table take the
+ * lock as well, so a peer is never removed or handed to another address
+ * under its user. The holder may take it again.
+ */
+void peer_lock(void);
 
+void peer_unlock(void);
+
+uint64_t bt_addr_to_int(const bt_addr_le_t *addr);
+
+/* Call with the peer lock held, the peer is only valid until it is released. */
 struct peer * get_peer(struct bt_uuid_128 *uuid);
 
+struct peer * get_peer_by_addr(uint64_t addr_int);
+
+/* Index of p in the peer table, for modules keeping per-peer arrays. */
+int peer_slot(const struct peer *p);
+
 int uuid_set_peer(uint64_t addr_int, struct bt_uuid_128 uuid);
 
+/* Activate a peer by the compact ID from its advertisement, instead of a
+ * UUID. A new ID means the reflector restarted, its history is dropped.
+ */
+int id_set_peer(uint64_t addr_int, uint32_t id);
+
 int remove_peer(uint64_t addr_int);
 
-int create_peer(uint64_t addr_int, uint32_t rng_seed, uint32_t support_dm_code);
+/* modes is the NDT_ADV_MODE_* bitmask the reflector advertises. A new peer
+ * has no seed until the caller sets one.
+ */
+int create_peer(uint64_t addr_int, uint8_t modes);
+
+typedef void (*peer_cb_t)(struct peer *p, void *user_data);
+
+/* Call with the peer lock held. */
+void peer_foreach_active(peer_cb_t cb, void *user_data);
+
+/* Remove every peer that has not been seen for more than max_idle_ms.
+ * Returns the number of evicted peers.
+ */
+int peer_evict_idle(uint32_t max_idle_ms);
+
+/* Remove the least recently seen peer if it has been idle for at least
+ * min_idle_ms. Returns -ENOMEM if every peer is more recent than that.
+ */
+int peer_evict_lru(uint32_t min_idle_ms);
 
 #endif
\ No newline at end of file
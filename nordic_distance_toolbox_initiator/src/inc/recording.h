@@ -0,0 +1,125 @@
+#ifndef RECORDING_H__
+#define RECORDING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+#include <dm.h>
+
+struct bt_scan_device_info;
+
+/* Recorded ranging session, written by the recorder (CONFIG_DM_RECORD) and
+ * replayed on native_sim (CONFIG_DM_SIM_REPLAY). A recording is a plain
+ * sequence of records, so it can be appended to as it is written and cut
+ * anywhere between records. Every record starts with
+ *
+ *   0  type (1)       RECORDING_*
+ *   1  length (1)     of the payload
+ *   2  time (4)       k_uptime_get_32() when recorded
+ *   6  payload
+ *
+ * and all fields are little endian. Addresses are bt_addr_le_t, type
+ * first. A recording starts with a RECORDING_START record, a new one in
+ * the middle means the initiator restarted.
+ *
+ *   START    magic (4) "NDTR", version (1), own address (7)
+ *   SCAN     address (7), advertising type (1), RSSI (1), data (0-31)
+ *   REQUEST  address (7), ranging mode (1), RNG seed (4), start delay (4),
+ *            extra window (4)
+ *   RESULT   address (7), status (1), quality (1), ranging mode (1),
+ *            estimates (4 floats: MCPD ifft, phase slope, RSSI, best, or
+ *            the RTT estimate followed by zeros)
+ *
+ * common/scripts/ndr.py prints and generates recordings.
+ */
+
+#define RECORDING_MAGIC 0x5254444E /* "NDTR" */
+#define RECORDING_VERSION 1
+
+#define RECORDING_HEADER_LEN 6
+#define RECORDING_SCAN_DATA_MAX 31
+#define RECORDING_PAYLOAD_MAX (BT_ADDR_LE_SIZE + 2 + RECORDING_SCAN_DATA_MAX)
+#define RECORDING_RECORD_MAX (RECORDING_HEADER_LEN + RECORDING_PAYLOAD_MAX)
+
+enum recording_type {
+    RECORDING_START = 1,
+    RECORDING_SCAN,
+    RECORDING_REQUEST,
+    RECORDING_RESULT,
+};
+
+struct recording_scan {
+    bt_addr_le_t addr;
+    uint8_t adv_type;
+    int8_t rssi;
+    uint8_t data_len;
+    uint8_t data[RECORDING_SCAN_DATA_MAX];
+};
+
+/* One record of a recording being read. */
+struct recording_record {
+    enum recording_type type;
+    uint32_t time_ms;
+    const uint8_t *payload;
+    uint8_t len;
+};
+
+/* Encoders, each fills buf with a whole record and returns its length.
+ * buf must hold RECORDING_RECORD_MAX bytes.
+ */
+size_t recording_encode_start(uint8_t *buf, uint32_t time_ms, const bt_addr_le_t *own_addr);
+
+size_t recording_encode_scan(uint8_t *buf, uint32_t time_ms, const struct recording_scan *scan);
+
+size_t recording_encode_request(uint8_t *buf, uint32_t time_ms, const struct dm_request *req);
+
+size_t recording_encode_result(uint8_t *buf, uint32_t time_ms, const struct dm_result *result);
+
+/* Read the record at *pos and advance past it. Returns -ENODATA at the end
+ * and -EINVAL if the record is cut short.
+ */
+int recording_next(const uint8_t *data, size_t len, size_t *pos, struct recording_record *rec);
+
+/* Decoders for the payload of a record of the matching type. */
+int recording_decode_start(const struct recording_record *rec, bt_addr_le_t *own_addr);
+
+int recording_decode_scan(const struct recording_record *rec, struct recording_scan *scan);
+
+int recording_decode_request(const struct recording_record *rec, struct dm_request *req);
+
+int recording_decode_result(const struct recording_record *rec, struct dm_result *result);
+
+struct record_stats {
+    uint32_t records;  /* handed to the backend */
+    uint32_t dropped;  /* backend full */
+};
+
+#ifdef CONFIG_DM_RECORD
+/* Start a recording with a RECORDING_START record, after bt_enable(). */
+int record_init(void);
+
+/* Record an advertising report, skipped unless it is from a reflector. */
+void record_scan(const struct bt_scan_device_info *device_info);
+
+void record_request(const struct dm_request *req);
+
+void record_result(const struct dm_result *result);
+
+void record_get_stats(struct record_stats *stats);
+#else
+static inline int record_init(void) {
+    return 0;
+}
+
+static inline void record_scan(const struct bt_scan_device_info *device_info) {
+}
+
+static inline void record_request(const struct dm_request *req) {
+}
+
+static inline void record_result(const struct dm_result *result) {
+}
+#endif
+
+#endif
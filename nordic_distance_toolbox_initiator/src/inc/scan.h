@@ -1,6 +1,14 @@
 #ifndef SCAN_H__
 #define SCAN_H__
 
+#include <stdint.h>
+
 int scan_init(void);
 
+/* Number of batched UUID filter reconfigurations committed so far. */
+uint32_t scan_filter_commits(void);
+
+/* Total time scanning has been stopped for filter reconfiguration. */
+uint64_t scan_paused_time_us(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef SCHEDULER_H__
+#define SCHEDULER_H__
+
+#include <stdint.h>
+#include <dm.h>
+#include <peer.h>
+
+struct sched_stats {
+    uint32_t granted;
+    uint32_t not_due;
+    uint32_t not_turn;
+    uint32_t rate_limited;
+    uint32_t rejected;
+};
+
+/* Offer a ranging opportunity for peer p, called whenever one of its
+ * advertisements is received. The request is passed on to dm_request_add()
+ * only if the peer is due, it is the most underserved ready peer and the
+ * global measurement rate allows it. Returns -EBUSY when the opportunity is
+ * declined, otherwise the result of dm_request_add().
+ */
+int sched_request(struct peer *p, struct dm_request *req);
+
+/* Feed a new distance for p so its ranging interval can follow how fast it
+ * is moving, between CONFIG_DM_PEER_INTERVAL_MIN_MS and
+ * CONFIG_DM_PEER_INTERVAL_MAX_MS.
+ */
+void sched_report_distance(struct peer *p, float distance);
+
+/* Give p a larger (or smaller) share of the ranging slots. A weight of N
+ * targets N times the peer's adaptive update rate.
+ */
+int sched_set_weight(struct peer *p, uint8_t weight);
+
+/* The weight of p, 1 unless set. It is reset when the peer is evicted. */
+uint8_t sched_weight(const struct peer *p);
+
+void sched_remove(struct peer *p);
+
+void sched_get_stats(struct sched_stats *stats);
+
+void sched_reset_stats(void);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SEQLOCK_H__
+#define SEQLOCK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+
+/* Single-writer sequence lock. The writer never blocks. Readers take a copy
+ * and retry if the sequence was odd (write in progress) or moved while they
+ * were copying. Neither side takes a lock or disables interrupts.
+ */
+struct seqlock {
+    atomic_t seq;
+};
+
+static inline void seqlock_write_begin(struct seqlock *sl) {
+    atomic_inc(&sl->seq);
+    barrier_dmem_fence_full();
+}
+
+static inline void seqlock_write_end(struct seqlock *sl) {
+    barrier_dmem_fence_full();
+    atomic_inc(&sl->seq);
+}
+
+static inline uint32_t seqlock_read_begin(const struct seqlock *sl) {
+    uint32_t seq = atomic_get(&sl->seq);
+
+    barrier_dmem_fence_full();
+    return seq;
+}
+
+/* Returns true if the data copied since seqlock_read_begin() may be torn. */
+static inline bool seqlock_read_retry(const struct seqlock *sl, uint32_t seq) {
+    barrier_dmem_fence_full();
+    return (seq & 1) || atomic_get(&sl->seq) != seq;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SMOOTHING_H__
+#define SMOOTHING_H__
+
+#include <dm.h>
+#include <peer.h>
+
+/* Run a new distance sample for peer p through the filter chain selected in
+ * Kconfig (sliding median, then EMA, then constant-velocity Kalman) and
+ * return the smoothed distance. State is kept per peer table slot and is
+ * reset automatically when the slot is reused by another peer. The Kalman
+ * filter trusts each sample according to the noise of its ranging method.
+ */
+float smoothing_update(const struct peer *p, float distance, enum dm_ranging_mode method,
+                       uint32_t now_ms);
+
+#endif
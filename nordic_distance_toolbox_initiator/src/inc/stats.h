@@ -0,0 +1,39 @@
+#ifndef STATS_H__
+#define STATS_H__
+
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+
+#include <dm.h>
+#include <peer.h>
+
+/* Initiator counters shown by the "ndt stats" and "ndt peers" shell
+ * commands, next to the scheduler, method and scan filter statistics. They
+ * cover events that otherwise only show up as log lines.
+ */
+
+enum stats_counter {
+    STATS_PEER_NO_MEM,     /* create_peer() failed, even after evicting */
+    STATS_SCAN_ERRORS,     /* bt_scan calls failed while committing filters */
+    STATS_FILTER_FULL,     /* peers refused, UUID filter queue full */
+    STATS_UNPUBLISHED,     /* results fusion found no usable distance in */
+    STATS_REPORTS_DROPPED, /* measurements not logged, report queue full */
+    STATS_PUBLISH_DROPPED, /* measurements not published, zbus channel busy */
+    STATS_COUNTER_COUNT,
+};
+
+extern atomic_t stats_counters[STATS_COUNTER_COUNT];
+
+static inline void stats_inc(enum stats_counter counter) {
+    atomic_inc(&stats_counters[counter]);
+}
+
+/* Account a ranging result with p, NULL if it is not in the peer table, that
+ * data_ready() took callback_us to handle.
+ */
+void stats_result(struct peer *p, enum dm_quality quality, uint32_t callback_us);
+
+/* Clear these counters and those of the scheduler and method selection. */
+void stats_reset(void);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef STREAM_H__
+#define STREAM_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/util.h>
+
+#include <dm.h>
+
+struct dm_data;
+
+/* Binary measurement stream to a host over the UART chosen as
+ * "ndt,stream-uart", never the console. Frames are queued without locks or
+ * blocking and written by a low priority thread, so a slow link drops
+ * frames instead of stalling the DM callback.
+ *
+ * On the wire every frame is COBS encoded and ends with a zero byte:
+ *
+ *   0  type (1)      STREAM_TYPE_*
+ *   1  sequence (2)  counts every frame queued, gaps are drops
+ *   3  payload       little endian, layout given by the type
+ *   n  CRC (2)       CRC-16/CCITT-FALSE of everything before it
+ *
+ * scripts/stream_receive.py decodes it on the host.
+ */
+
+#define STREAM_PAYLOAD_MAX 48
+
+enum stream_type {
+    STREAM_TYPE_MEASUREMENT = 1,
+    STREAM_TYPE_RECORD,     /* one record of a recording, see recording.h */
+};
+
+#define STREAM_FLAG_PUBLISHED BIT(0)
+
+/* One ranging result with everything the DM library reported for it. */
+struct stream_measurement {
+    uint32_t timestamp_ms;
+    uint64_t peer_id;       /* bt_addr_to_int() of the reflector */
+    uint8_t method;         /* enum dm_ranging_mode */
+    uint8_t quality;        /* enum dm_quality */
+    uint8_t flags;          /* STREAM_FLAG_* */
+    uint8_t reserved;
+    float distance;         /* calibrated and smoothed, if published */
+    float confidence;
+    float mcpd_ifft;
+    float mcpd_phase_slope;
+    float mcpd_rssi_openspace;
+    float mcpd_best;
+    float rtt;
+} __packed;
+
+struct stream_stats {
+    uint32_t frames;   /* written to the UART */
+    uint32_t dropped;  /* not queued, queue full */
+};
+
+#ifdef CONFIG_DM_STREAM
+/* Queue a frame, from any context. Returns -ENOBUFS if the queue is full. */
+int stream_put(enum stream_type type, const void *payload, size_t len);
+
+void stream_measurement(const struct dm_result *result, const struct dm_data *data, bool published);
+
+void stream_get_stats(struct stream_stats *stats);
+#else
+static inline void stream_measurement(const struct dm_result *result, const struct dm_data *data,
+                                      bool published) {
+}
+#endif
+
+#endif
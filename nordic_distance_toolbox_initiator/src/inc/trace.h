@@ -0,0 +1,46 @@
+#ifndef TRACE_H__
+#define TRACE_H__
+
+#include <stdint.h>
+#include <zephyr/toolchain.h>
+
+/* Latency tracing of one measurement through the initiator, from the scan
+ * report to the display. Every stage records a fixed-size event, keyed by
+ * the peer, into a ring per CPU. The rings are dumped to the console as
+ * hex and scripts/trace_decode.py pairs the stages up and prints latency
+ * percentiles. Without CONFIG_DM_TRACE the TRACE() calls compile to
+ * nothing and their arguments are not evaluated.
+ */
+
+enum trace_stage {
+    TRACE_SCAN,     /* advertising report handed to peer_range() */
+    TRACE_REQUEST,  /* ranging queued with dm_request_add() */
+    TRACE_RESULT,   /* data_ready() entered */
+    TRACE_PUBLISH,  /* measurement published on zbus */
+    TRACE_DISPLAY,  /* frame with the measurement drawn */
+    TRACE_STAGE_COUNT,
+};
+
+/* Layout shared with scripts/trace_decode.py, little endian. */
+struct trace_event {
+    uint32_t cycles;
+    uint32_t key;   /* low 32 bits of the peer address */
+    uint8_t stage;
+    uint8_t cpu;
+    uint16_t arg;   /* stage specific: ranging mode, quality */
+} __packed;
+
+#ifdef CONFIG_DM_TRACE
+void trace_init(void);
+
+void trace_record(enum trace_stage stage, uint64_t peer_id, uint16_t arg);
+
+#define TRACE(stage, peer_id, arg) trace_record(stage, peer_id, arg)
+#else
+static inline void trace_init(void) {
+}
+
+#define TRACE(stage, peer_id, arg) do { } while (0)
+#endif
+
+#endif
@@ -7,11 +7,34 @@
 
 #include <zephyr/bluetooth/bluetooth.h>
 
+#ifdef CONFIG_DM_CALLBACK_TIMING
+#ifdef CONFIG_CPU_CORTEX_M_HAS_DWT
+#include <cmsis_core.h>
+#else
+#include <zephyr/timing/timing.h>
+#endif
+#endif
+
 #include <dm.h>
 
 #include <color.h>
 #include <scan.h>
+#include <peer.h>
+#include <scheduler.h>
+#include <smoothing.h>
+#include <fusion.h>
+#include <history.h>
+#include <method.h>
+#include <calib.h>
 #include <messages.h>
+#include <recording.h>
+#include <stats.h>
+#include <stream.h>
+#include <trace.h>
+
+#ifdef CONFIG_DM_SIM
+#include <sim.h>
+#endif
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 
@@ -47,55 +70,211 @@ void set_led_color(uint32_t rgba_color) {
 }
 #endif
 
-void data_ready(struct dm_result *result)
+/* Everything needed to log a measurement later, so that data_ready() does
+ * no string formatting of its own.
+ */
+struct dm_report {
+	bt_addr_le_t addr;
+	struct dm_data data;
+	uint8_t quality;
+	bool published;
+	uint32_t cb_cycles;
+};
+
+K_MSGQ_DEFINE(report_msgq, sizeof(struct dm_report), CONFIG_DM_REPORT_QUEUE_SIZE, 4);
+
+#ifdef CONFIG_DM_CALLBACK_TIMING
+/* Written by data_ready() and read by the report thread. */
+static struct k_spinlock cb_lock;
+static uint64_t cb_cycles_total;
+static uint32_t cb_cycles_max;
+static uint32_t cb_count;
+#endif
+
+/* The callback is timed once, with the CPU cycle counter when callback
+ * timing is on and the system clock otherwise.
+ */
+static inline void cb_clock_init(void)
+{
+#if defined(CONFIG_DM_CALLBACK_TIMING) && defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#elif defined(CONFIG_DM_CALLBACK_TIMING)
+	timing_init();
+	timing_start();
+#endif
+}
+
+static inline uint32_t cb_clock(void)
+{
+#if defined(CONFIG_DM_CALLBACK_TIMING) && defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	return DWT->CYCCNT;
+#elif defined(CONFIG_DM_CALLBACK_TIMING)
+	return (uint32_t)timing_counter_get();
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+static inline uint32_t cb_cycles_to_ns(uint64_t cycles)
 {
-	if (result->quality == DM_QUALITY_CRC_FAIL) {
-		LOG_INF("Quality: %d", result->quality);
-		LOG_INF("Poor quality measurement, not publishing");
-		return;
+#if defined(CONFIG_DM_CALLBACK_TIMING) && defined(CONFIG_CPU_CORTEX_M_HAS_DWT)
+	return (uint32_t)(cycles * NSEC_PER_SEC / SystemCoreClock);
+#elif defined(CONFIG_DM_CALLBACK_TIMING)
+	return (uint32_t)timing_cycles_to_ns(cycles);
+#else
+	return (uint32_t)k_cyc_to_ns_floor64(cycles);
+#endif
+}
+
+#ifdef CONFIG_BOARD_THINGY53_NRF5340_CPUAPP
+static uint32_t peer_color(struct peer *p, const bt_addr_le_t *bt_addr)
+{
+	/* The reflector derives its LED color from its own address string, so
+	 * the initiator has to hash the same string. Do it once per peer.
+	 */
+	if (p->color == 0) {
+		char addr[BT_ADDR_LE_STR_LEN];
+
+		bt_addr_le_to_str(bt_addr, addr, sizeof(addr));
+		p->color = addr_to_color(addr, BT_ADDR_STR_LEN - 1);
 	}
+	return p->color;
+}
+#endif
 
-	const char *quality[DM_QUALITY_NONE + 1] = {"ok", "poor", "do not use", "crc fail", "none"};
-	char addr[BT_ADDR_LE_STR_LEN];
+void data_ready(struct dm_result *result)
+{
+	uint32_t cb_start = cb_clock();
+	struct dm_report report = {
+		.quality = result->quality,
+	};
+	struct dm_data *dm_data = &report.data;
 
-	bt_addr_le_to_str(&result->bt_addr, addr, sizeof(addr));
+	record_result(result);
+	bt_addr_le_copy(&report.addr, &result->bt_addr);
+	dm_data->peer_id = bt_addr_to_int(&result->bt_addr);
+	TRACE(TRACE_RESULT, dm_data->peer_id, result->quality);
+	dm_data->timestamp = k_uptime_get_32();
+	dm_data->ranging_method = result->ranging_mode;
 
-	struct dm_data dm_data = {0};
+	/* Keeps the scan callbacks from evicting or reusing p until we are done. */
+	peer_lock();
+	struct peer *p = get_peer_by_addr(dm_data->peer_id);
 
-	if (result->ranging_mode == DM_RANGING_MODE_MCPD) {
-		dm_data.distance = result->dist_estimates.mcpd.best;
-		dm_data.ranging_method = DM_RANGING_MODE_MCPD;
+	int err = fusion_update(p, result, &dm_data->distance, &dm_data->confidence);
+	if (err == 0) {
+		report.published = true;
 
-		dm_data.distance -= CONFIG_DM_MCPD_DISTANCE_OFFSET_CM / 100.0;
-		if (dm_data.distance < 0) {
-			dm_data.distance = 0;
+		calib_sample(p, result->ranging_mode, dm_data->distance);
+		dm_data->distance = calib_apply(p, result->ranging_mode, dm_data->distance);
+		if (dm_data->distance < 0) {
+			dm_data->distance = 0;
 		}
 	}
+	else {
+		stats_inc(STATS_UNPUBLISHED);
+	}
+
+	if (report.published && p != NULL) {
+		sched_report_distance(p, dm_data->distance);
+		dm_data->distance = smoothing_update(p, dm_data->distance, result->ranging_mode,
+						     dm_data->timestamp);
+		method_report(p, result->ranging_mode, dm_data->distance, dm_data->timestamp);
+#ifdef CONFIG_DM_SIM
+		sim_report_distance(&result->bt_addr, dm_data->distance);
+#endif
 
-	if (result->ranging_mode == DM_RANGING_MODE_RTT) {
-		dm_data.distance = result->dist_estimates.rtt.rtt;
-		dm_data.ranging_method = DM_RANGING_MODE_RTT;
+		struct dm_sample sample = {
+			.timestamp = dm_data->timestamp,
+			.distance = dm_data->distance,
+			.confidence = dm_data->confidence,
+			.ranging_method = dm_data->ranging_method,
+		};
+		history_push(p, &sample);
 
-		dm_data.distance -= CONFIG_DM_RTT_DISTANCE_OFFSET_CM / 100.0;
-		if (dm_data.distance < 0) {
-			dm_data.distance = 0;
+		#ifdef CONFIG_BOARD_THINGY53_NRF5340_CPUAPP
+		static uint32_t led_color;
+		uint32_t color = peer_color(p, &result->bt_addr);
+
+		if (color != led_color) {
+			led_color = color;
+			set_led_color(color);
 		}
+		#endif
 	}
 
-	memcpy(dm_data.addr, addr, sizeof(addr));
+	#ifdef CONFIG_DISTANCE_DISPLAY_OLED
+	if (report.published) {
+		/* The display reads the channel, it must not hold up the BT stack. */
+		if (zbus_chan_pub(&dm_chan, dm_data, K_NO_WAIT)) {
+			stats_inc(STATS_PUBLISH_DROPPED);
+		}
+		else {
+			TRACE(TRACE_PUBLISH, dm_data->peer_id, 0);
+		}
+	}
+	#endif
 
-	// Get my address and convert to color:
+	stream_measurement(result, dm_data, report.published);
 
-	#ifdef CONFIG_BOARD_THINGY53_NRF5340_CPUAPP
-	set_led_color(addr_to_color(addr, 17));
-	#endif
+	report.cb_cycles = cb_clock() - cb_start;
+#ifdef CONFIG_DM_CALLBACK_TIMING
+	k_spinlock_key_t key = k_spin_lock(&cb_lock);
 
-	#ifdef CONFIG_DISTANCE_DISPLAY_OLED
-	zbus_chan_pub(&dm_chan, &dm_data, K_MSEC(500));
-	#endif
-	LOG_INF("Distance: %f, Quality: %s", dm_data.distance, quality[result->quality]);
+	cb_cycles_total += report.cb_cycles;
+	cb_cycles_max = MAX(cb_cycles_max, report.cb_cycles);
+	cb_count++;
+	k_spin_unlock(&cb_lock, key);
+#endif
+	stats_result(p, result->quality, cb_cycles_to_ns(report.cb_cycles) / 1000);
+	peer_unlock();
+
+	/* Logging is best effort, drop the report rather than wait. */
+	if (k_msgq_put(&report_msgq, &report, K_NO_WAIT)) {
+		stats_inc(STATS_REPORTS_DROPPED);
+	}
+}
+
+static void report_thread(void *p1, void *p2, void *p3)
+{
+	const char *quality[DM_QUALITY_NONE + 1] = {"ok", "poor", "do not use", "crc fail", "none"};
+	struct dm_report report;
+	char addr[BT_ADDR_LE_STR_LEN];
+
+	while (true) {
+		k_msgq_get(&report_msgq, &report, K_FOREVER);
+
+		bt_addr_le_to_str(&report.addr, addr, sizeof(addr));
+
+		if (!report.published) {
+			LOG_INF("%s: unusable measurement (quality %s), not publishing", addr,
+				quality[MIN(report.quality, DM_QUALITY_NONE)]);
+			continue;
+		}
+
+		LOG_INF("%s: Distance: %f, Confidence: %f, Quality: %s", addr,
+			report.data.distance, report.data.confidence,
+			quality[MIN(report.quality, DM_QUALITY_NONE)]);
+
+#ifdef CONFIG_DM_CALLBACK_TIMING
+		k_spinlock_key_t key = k_spin_lock(&cb_lock);
+		uint64_t total = cb_cycles_total;
+		uint32_t max = cb_cycles_max;
+		uint32_t count = cb_count;
+
+		k_spin_unlock(&cb_lock, key);
+		LOG_INF("data_ready: %u ns, avg %u ns, max %u ns over %u calls",
+			cb_cycles_to_ns(report.cb_cycles), cb_cycles_to_ns(total / count),
+			cb_cycles_to_ns(max), count);
+#endif
+	}
 }
 
+K_THREAD_DEFINE(report_id, 1536, report_thread, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
 static struct dm_cb dm_cb = {
 	.data_ready = data_ready,
 };
@@ -108,12 +287,25 @@ int main(void)
 	struct dm_init_param init_param;
 	init_param.cb = &dm_cb;
 
+	cb_clock_init();
+	trace_init();
+
+	err = calib_init();
+	if (err) {
+		LOG_ERR("Calibration failed to load (err %d)\n", err);
+	}
+
 	err = bt_enable(NULL);
 	if (err) {
 		LOG_ERR("Bluetooth failed to start (err %d)\n", err);
 	}
 	LOG_INF("Bluetooth initialized\n");
 
+	err = record_init();
+	if (err) {
+		LOG_ERR("Recording failed to start (err %d)\n", err);
+	}
+
 	err = scan_init();
 	if (err) {
 		LOG_ERR("Scanning failed to start (err %d)\n", err);
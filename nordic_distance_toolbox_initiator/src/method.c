@@ -0,0 +1,122 @@
+#include <method.h>
+
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include <ndt_adv.h>
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+
+#define NEAR_M (CONFIG_DM_METHOD_MCPD_RANGE_CM / 100.0f)
+#define SLOW_MPS (CONFIG_DM_METHOD_MCPD_MAX_SPEED_CMS / 100.0f)
+
+/* Switching back needs a margin, so a peer sitting right at a threshold
+ * does not flip methods on every measurement.
+ */
+#define HYSTERESIS 1.2f
+
+struct method_state {
+    uint64_t addr_int;
+    bool valid;
+    bool mcpd;
+    float distance;
+    float velocity;
+    uint32_t last_ms;
+};
+
+static struct method_state state[NUM_PEERS];
+static enum method_policy policy = METHOD_POLICY_AUTO;
+static struct method_stats stats;
+
+void method_set_policy(enum method_policy new_policy) {
+    policy = new_policy;
+}
+
+enum method_policy method_get_policy(void) {
+    return policy;
+}
+
+static struct method_state *peer_state(const struct peer *p) {
+    struct method_state *s = &state[peer_slot(p)];
+
+    if (s->addr_int != p->addr_int) {
+        memset(s, 0, sizeof(*s));
+        s->addr_int = p->addr_int;
+    }
+    return s;
+}
+
+static bool auto_wants_mcpd(const struct peer *p, struct method_state *s) {
+    if (p->sched_weight > 1) {
+        return true;
+    }
+    if (!s->valid) {
+        return false;
+    }
+
+    float near = s->mcpd ? NEAR_M * HYSTERESIS : NEAR_M;
+    float slow = s->mcpd ? SLOW_MPS * HYSTERESIS : SLOW_MPS;
+
+    return s->distance < near && fabsf(s->velocity) < slow;
+}
+
+int method_select(const struct peer *p, enum dm_ranging_mode *mode) {
+    bool mcpd = p->modes & NDT_ADV_MODE_MCPD;
+    bool rtt = p->modes & NDT_ADV_MODE_RTT;
+
+    if (policy == METHOD_POLICY_MCPD) {
+        rtt = false;
+    }
+    else if (policy == METHOD_POLICY_RTT) {
+        mcpd = false;
+    }
+    else if (mcpd && rtt) {
+        struct method_state *s = peer_state(p);
+
+        s->mcpd = auto_wants_mcpd(p, s);
+        mcpd = s->mcpd;
+    }
+
+    if (mcpd) {
+        *mode = DM_RANGING_MODE_MCPD;
+        return 0;
+    }
+    if (rtt) {
+        *mode = DM_RANGING_MODE_RTT;
+        return 0;
+    }
+    stats.skipped++;
+    return -ENOTSUP;
+}
+
+void method_report(const struct peer *p, enum dm_ranging_mode mode, float distance, uint32_t now_ms) {
+    struct method_state *s = peer_state(p);
+
+    if (mode == DM_RANGING_MODE_MCPD) {
+        stats.mcpd++;
+    }
+    else {
+        stats.rtt++;
+    }
+
+    /* Average the signed velocity, jitter in the smoothed distance cancels
+     * out instead of adding up as it would with the absolute value.
+     */
+    if (s->valid && now_ms != s->last_ms) {
+        float velocity = (distance - s->distance) * 1000.0f / (now_ms - s->last_ms);
+
+        s->velocity += (velocity - s->velocity) / 8;
+    }
+    s->distance = distance;
+    s->last_ms = now_ms;
+    s->valid = true;
+}
+
+void method_get_stats(struct method_stats *out) {
+    *out = stats;
+}
+
+void method_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
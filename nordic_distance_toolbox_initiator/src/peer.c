@@ -1,69 +1,317 @@
 #include <peer.h>
+#include <ndt_adv.h>
+#include <scheduler.h>
 #include <string.h>
 #include <stddef.h>
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/uuid.h>
+#include <zephyr/sys/hash_function.h>
+#include <zephyr/sys/util.h>
 
 #define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define HASH_SIZE CONFIG_DM_PEER_HASH_SIZE
+#define HASH_MASK (HASH_SIZE - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(HASH_SIZE), "CONFIG_DM_PEER_HASH_SIZE must be a power of two");
+BUILD_ASSERT(HASH_SIZE > NUM_PEERS, "CONFIG_DM_PEER_HASH_SIZE must be larger than the peer count");
+
+/* Index slots hold the peer_array index plus one, zero marks an empty slot. */
+#define SLOT_EMPTY 0
+
+enum peer_key {
+    PEER_KEY_ADDR,
+    PEER_KEY_UUID,
+    PEER_KEY_COUNT,
+};
 
 struct peer peer_array[NUM_PEERS] = {0};
 
-int create_peer(uint64_t addr_int, uint32_t rng_seed, uint32_t support_dm_code) {
-    for (int i = 0; i < NUM_PEERS; i++) {
-        if (peer_array[i].is_active == false) {
-            peer_array[i].addr_int = addr_int;
-            peer_array[i].timestamp = 0;
-            peer_array[i].rng_seed = rng_seed;
+static bool peer_used[NUM_PEERS];
 
-            if (support_dm_code == SUPPORT_MCPD_CODE) {
-                peer_array[i].ranging_mode = RANGING_MODE_MCPD;
-            }
-            else if (support_dm_code == SUPPORT_RTT_CODE) {
-                peer_array[i].ranging_mode = RANGING_MODE_RTT;
-            }
-            else {
-                return -EINVAL;
+/* Whether a peer's UUID is in the UUID index, compact ID peers may have none. */
+static bool uuid_indexed[NUM_PEERS];
+
+/* The scan callbacks change the table while the DM callback and the shell
+ * use the peers in it, see peer_lock().
+ */
+static K_MUTEX_DEFINE(peer_mutex);
+
+/* Open-addressing (linear probing) indexes into peer_array, one per key. */
+static uint16_t peer_index[PEER_KEY_COUNT][HASH_SIZE];
+
+/* Cached key hashes so that deletion can find an entry's home slot without rehashing. */
+static uint32_t peer_hash[PEER_KEY_COUNT][NUM_PEERS];
+
+static uint32_t addr_hash(uint64_t addr_int) {
+    return sys_hash32_murmur3((const char *)&addr_int, sizeof(addr_int));
+}
+
+static uint32_t uuid_hash(const struct bt_uuid_128 *uuid) {
+    return sys_hash32_murmur3((const char *)uuid->val, BT_UUID_SIZE_128);
+}
+
+static bool key_match(enum peer_key key, int idx, const void *val) {
+    if (key == PEER_KEY_ADDR) {
+        return peer_array[idx].addr_int == *(const uint64_t *)val;
+    }
+    return memcmp(peer_array[idx].uuid.val, val, BT_UUID_SIZE_128) == 0;
+}
+
+static int index_find(enum peer_key key, uint32_t hash, const void *val, size_t *slot_out) {
+    size_t slot = hash & HASH_MASK;
+
+    for (size_t probe = 0; probe < HASH_SIZE; probe++) {
+        uint16_t entry = peer_index[key][slot];
+
+        if (entry == SLOT_EMPTY) {
+            break;
+        }
+        if (peer_hash[key][entry - 1] == hash && key_match(key, entry - 1, val)) {
+            if (slot_out) {
+                *slot_out = slot;
             }
+            return entry - 1;
+        }
+        slot = (slot + 1) & HASH_MASK;
+    }
+    return -ENOENT;
+}
+
+static void index_insert(enum peer_key key, int idx, uint32_t hash) {
+    size_t slot = hash & HASH_MASK;
 
-            return 0;
+    /* The index is always larger than peer_array, so a free slot exists. */
+    while (peer_index[key][slot] != SLOT_EMPTY) {
+        slot = (slot + 1) & HASH_MASK;
+    }
+    peer_hash[key][idx] = hash;
+    peer_index[key][slot] = idx + 1;
+}
+
+/* Backward-shift deletion: pull later entries of the probe run into the hole
+ * so that lookups never need tombstones.
+ */
+static void index_remove(enum peer_key key, size_t hole) {
+    size_t next = (hole + 1) & HASH_MASK;
+
+    while (peer_index[key][next] != SLOT_EMPTY) {
+        uint16_t entry = peer_index[key][next];
+        size_t home = peer_hash[key][entry - 1] & HASH_MASK;
+
+        if (((next - home) & HASH_MASK) >= ((next - hole) & HASH_MASK)) {
+            peer_index[key][hole] = entry;
+            hole = next;
+        }
+        next = (next + 1) & HASH_MASK;
+    }
+    peer_index[key][hole] = SLOT_EMPTY;
+}
+
+static void index_erase(enum peer_key key, int idx, const void *val) {
+    size_t slot;
+
+    if (index_find(key, peer_hash[key][idx], val, &slot) == idx) {
+        index_remove(key, slot);
+    }
+}
+
+void peer_lock(void) {
+    k_mutex_lock(&peer_mutex, K_FOREVER);
+}
+
+void peer_unlock(void) {
+    k_mutex_unlock(&peer_mutex);
+}
+
+uint64_t bt_addr_to_int(const bt_addr_le_t *addr) {
+    uint64_t addr_int = 0;
+    for (int i = 0; i < BT_ADDR_SIZE; i++) {
+        addr_int = addr_int << 8;
+        addr_int += addr->a.val[i];
+    }
+    return addr_int;
+}
+
+int create_peer(uint64_t addr_int, uint8_t modes) {
+    modes &= NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT;
+    if (modes == 0) {
+        return -EINVAL;
+    }
+
+    uint32_t hash = addr_hash(addr_int);
+
+    peer_lock();
+    int idx = index_find(PEER_KEY_ADDR, hash, &addr_int, NULL);
+
+    if (idx < 0) {
+        for (idx = 0; idx < NUM_PEERS; idx++) {
+            if (!peer_used[idx]) {
+                break;
+            }
         }
+        if (idx == NUM_PEERS) {
+            peer_unlock();
+            return -ENOMEM;
+        }
+
+        memset(&peer_array[idx], 0, sizeof(peer_array[idx]));
+        peer_array[idx].addr_int = addr_int;
+        peer_array[idx].interval_ms = CONFIG_DM_PEER_DELAY_MS;
+        peer_used[idx] = true;
+        index_insert(PEER_KEY_ADDR, idx, hash);
     }
-    return -ENOMEM;
+
+    peer_array[idx].modes = modes;
+    peer_array[idx].last_seen = k_uptime_get_32();
+    peer_unlock();
+
+    return 0;
 }
 
 int uuid_set_peer(uint64_t addr_int, struct bt_uuid_128 uuid) {
-    for (int i = 0; i < NUM_PEERS; i++) {
-        if (peer_array[i].addr_int == addr_int) {
-            peer_array[i].uuid = uuid;
-            memcpy(peer_array[i].uuid.val, uuid.val, BT_UUID_SIZE_128);
-            peer_array[i].uuid.uuid.type = BT_UUID_TYPE_128;
+    peer_lock();
+    int idx = index_find(PEER_KEY_ADDR, addr_hash(addr_int), &addr_int, NULL);
+    if (idx < 0) {
+        peer_unlock();
+        return -ENOENT;
+    }
+
+    struct peer *p = &peer_array[idx];
 
-            peer_array[i].is_active = true;
-            return 0;
+    if (uuid_indexed[idx]) {
+        if (memcmp(p->uuid.val, uuid.val, BT_UUID_SIZE_128) == 0) {
+            peer_unlock();
+            return -EALREADY;
         }
+        index_erase(PEER_KEY_UUID, idx, p->uuid.val);
     }
-    return -ENOMEM;
+
+    memcpy(p->uuid.val, uuid.val, BT_UUID_SIZE_128);
+    p->uuid.uuid.type = BT_UUID_TYPE_128;
+    index_insert(PEER_KEY_UUID, idx, uuid_hash(&p->uuid));
+
+    uuid_indexed[idx] = true;
+    p->is_active = true;
+    peer_unlock();
+    return 0;
+}
+
+int id_set_peer(uint64_t addr_int, uint32_t id) {
+    int ret = 0;
+
+    peer_lock();
+    int idx = index_find(PEER_KEY_ADDR, addr_hash(addr_int), &addr_int, NULL);
+
+    if (idx < 0) {
+        ret = -ENOENT;
+        goto out;
+    }
+
+    struct peer *p = &peer_array[idx];
+
+    if (p->is_active) {
+        if (p->id == id) {
+            ret = -EALREADY;
+            goto out;
+        }
+        sched_remove(p);
+        p->interval_ms = CONFIG_DM_PEER_DELAY_MS;
+        p->distance_avg = 0;
+        p->distance_count = 0;
+    }
+
+    p->id = id;
+    p->is_active = true;
+out:
+    peer_unlock();
+    return ret;
 }
 
 int remove_peer(uint64_t addr_int) {
+    size_t slot;
+
+    peer_lock();
+    int idx = index_find(PEER_KEY_ADDR, addr_hash(addr_int), &addr_int, &slot);
+    if (idx < 0) {
+        peer_unlock();
+        return -ENOENT;
+    }
+
+    index_remove(PEER_KEY_ADDR, slot);
+    if (uuid_indexed[idx]) {
+        index_erase(PEER_KEY_UUID, idx, peer_array[idx].uuid.val);
+    }
+
+    uuid_indexed[idx] = false;
+    peer_array[idx].is_active = false;
+    peer_used[idx] = false;
+    sched_remove(&peer_array[idx]);
+    peer_unlock();
+    return 0;
+}
+
+struct peer * get_peer(struct bt_uuid_128 *uuid) {
+    int idx = index_find(PEER_KEY_UUID, uuid_hash(uuid), uuid->val, NULL);
+
+    if (idx < 0) {
+        return NULL;
+    }
+    return &peer_array[idx];
+}
+
+struct peer * get_peer_by_addr(uint64_t addr_int) {
+    int idx = index_find(PEER_KEY_ADDR, addr_hash(addr_int), &addr_int, NULL);
+
+    if (idx < 0) {
+        return NULL;
+    }
+    return &peer_array[idx];
+}
+
+int peer_slot(const struct peer *p) {
+    return p - peer_array;
+}
+
+void peer_foreach_active(peer_cb_t cb, void *user_data) {
     for (int i = 0; i < NUM_PEERS; i++) {
-        if (peer_array[i].is_active == true && peer_array[i].addr_int == addr_int) {
-            peer_array[i].is_active = false;
-            return 0;
+        if (peer_used[i] && peer_array[i].is_active) {
+            cb(&peer_array[i], user_data);
         }
     }
-    return -ENOENT;
 }
 
-struct peer * get_peer(struct bt_uuid_128 *uuid) {
-    int cmp;
+int peer_evict_idle(uint32_t max_idle_ms) {
+    uint32_t now = k_uptime_get_32();
+    int evicted = 0;
+
+    peer_lock();
     for (int i = 0; i < NUM_PEERS; i++) {
-        if (peer_array[i].is_active == true) {
-            cmp = strncmp(peer_array[i].uuid.val, uuid->val, BT_UUID_SIZE_128);
-            if (cmp == 0) {
-                return &peer_array[i];
-            }
+        if (peer_used[i] && (now - peer_array[i].last_seen) > max_idle_ms) {
+            remove_peer(peer_array[i].addr_int);
+            evicted++;
+        }
+    }
+    peer_unlock();
+    return evicted;
+}
+
+int peer_evict_lru(uint32_t min_idle_ms) {
+    uint32_t now = k_uptime_get_32();
+    uint32_t oldest_idle = 0;
+    int oldest = -1;
+    int ret = -ENOMEM;
+
+    peer_lock();
+    for (int i = 0; i < NUM_PEERS; i++) {
+        if (peer_used[i] && (now - peer_array[i].last_seen) >= oldest_idle) {
+            oldest_idle = now - peer_array[i].last_seen;
+            oldest = i;
         }
     }
-    return NULL;
-}
\ No newline at end of file
+
+    if (oldest >= 0 && oldest_idle >= min_idle_ms) {
+        ret = remove_peer(peer_array[oldest].addr_int);
+    }
+    peer_unlock();
+    return ret;
+}
@@ -0,0 +1,188 @@
+#include <recording.h>
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <bluetooth/scan.h>
+
+#ifdef CONFIG_DM_RECORD_FS
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/ring_buffer.h>
+#endif
+
+#include <ndt_adv.h>
+#include <stream.h>
+
+LOG_MODULE_REGISTER(recorder, LOG_LEVEL_INF);
+
+/* Writes the recording as the session runs. Records are encoded where the
+ * event happens and handed to the backend without blocking: the stream
+ * backend queues them as STREAM_TYPE_RECORD frames, the file backend
+ * copies them to a ring buffer that a low priority thread appends to the
+ * file. Records that do not fit are dropped whole, so the recording stays
+ * readable.
+ */
+
+static atomic_t records;
+static atomic_t dropped;
+
+#ifdef CONFIG_DM_RECORD_FS
+#define FS_BUFFER_SIZE CONFIG_DM_RECORD_FS_BUFFER_SIZE
+
+RING_BUF_DECLARE(fs_ring, FS_BUFFER_SIZE);
+static struct k_spinlock fs_lock;
+static K_SEM_DEFINE(fs_sem, 0, 1);
+
+static int record_write(const uint8_t *rec, size_t len) {
+    k_spinlock_key_t key = k_spin_lock(&fs_lock);
+    int err = 0;
+
+    if (ring_buf_space_get(&fs_ring) < len) {
+        err = -ENOBUFS;
+    }
+    else {
+        ring_buf_put(&fs_ring, rec, len);
+    }
+    k_spin_unlock(&fs_lock, key);
+
+    if (!err) {
+        k_sem_give(&fs_sem);
+    }
+    return err;
+}
+
+static void fs_thread(void *p1, void *p2, void *p3) {
+    static uint8_t chunk[256];
+    struct fs_file_t file;
+    uint32_t synced = k_uptime_get_32();
+    bool dirty = false;
+    int err;
+
+    fs_file_t_init(&file);
+
+    /* The file system is mounted by the board, wait for the first record. */
+    k_sem_take(&fs_sem, K_FOREVER);
+    err = fs_open(&file, CONFIG_DM_RECORD_FS_PATH, FS_O_CREATE | FS_O_WRITE | FS_O_APPEND);
+    if (err) {
+        LOG_ERR("Failed to open %s (err %d)", CONFIG_DM_RECORD_FS_PATH, err);
+        return;
+    }
+
+    while (true) {
+        k_spinlock_key_t key = k_spin_lock(&fs_lock);
+        uint32_t len = ring_buf_get(&fs_ring, chunk, sizeof(chunk));
+
+        k_spin_unlock(&fs_lock, key);
+
+        if (len > 0) {
+            ssize_t written = fs_write(&file, chunk, len);
+
+            if (written != (ssize_t)len) {
+                LOG_ERR("Failed to write recording (err %d)", (int)written);
+                fs_close(&file);
+                return;
+            }
+            dirty = true;
+            continue;
+        }
+
+        /* Flash wears with every sync, so only sync once things go quiet
+         * or every CONFIG_DM_RECORD_FS_SYNC_MS.
+         */
+        if (dirty && (k_sem_take(&fs_sem, K_MSEC(100)) ||
+                      k_uptime_get_32() - synced >= CONFIG_DM_RECORD_FS_SYNC_MS)) {
+            fs_sync(&file);
+            synced = k_uptime_get_32();
+            dirty = false;
+            continue;
+        }
+        if (!dirty) {
+            k_sem_take(&fs_sem, K_FOREVER);
+        }
+    }
+}
+
+K_THREAD_DEFINE(record_fs_id, 2048, fs_thread, NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO,
+                0, 0);
+#else
+BUILD_ASSERT(RECORDING_RECORD_MAX <= STREAM_PAYLOAD_MAX, "Records must fit in a stream frame");
+
+static int record_write(const uint8_t *rec, size_t len) {
+    return stream_put(STREAM_TYPE_RECORD, rec, len);
+}
+#endif
+
+static void record(const uint8_t *rec, size_t len) {
+    if (record_write(rec, len)) {
+        atomic_inc(&dropped);
+        return;
+    }
+    atomic_inc(&records);
+}
+
+int record_init(void) {
+    uint8_t rec[RECORDING_RECORD_MAX];
+    bt_addr_le_t own_addr;
+    size_t count = 1;
+
+    bt_id_get(&own_addr, &count);
+    if (count == 0) {
+        return -ENODEV;
+    }
+    record(rec, recording_encode_start(rec, k_uptime_get_32(), &own_addr));
+    return 0;
+}
+
+static bool ndt_adv_find(struct bt_data *data, void *user_data) {
+    struct ndt_adv adv;
+
+    if (data->type == BT_DATA_MANUFACTURER_DATA && !ndt_adv_parse(data->data, data->data_len, &adv)) {
+        *(bool *)user_data = true;
+        return false;
+    }
+    return true;
+}
+
+void record_scan(const struct bt_scan_device_info *device_info) {
+    struct net_buf_simple adv_data = *device_info->adv_data;
+    bool reflector = false;
+
+    /* Only reflectors take part in a session, and every report of theirs
+     * carries the manufacturer data.
+     */
+    bt_data_parse(&adv_data, ndt_adv_find, &reflector);
+    if (!reflector) {
+        return;
+    }
+
+    struct recording_scan scan = {
+        .adv_type = device_info->recv_info->adv_type,
+        .rssi = device_info->recv_info->rssi,
+        .data_len = MIN(device_info->adv_data->len, RECORDING_SCAN_DATA_MAX),
+    };
+    uint8_t rec[RECORDING_RECORD_MAX];
+
+    bt_addr_le_copy(&scan.addr, device_info->recv_info->addr);
+    memcpy(scan.data, device_info->adv_data->data, scan.data_len);
+    record(rec, recording_encode_scan(rec, k_uptime_get_32(), &scan));
+}
+
+void record_request(const struct dm_request *req) {
+    uint8_t rec[RECORDING_RECORD_MAX];
+
+    record(rec, recording_encode_request(rec, k_uptime_get_32(), req));
+}
+
+void record_result(const struct dm_result *result) {
+    uint8_t rec[RECORDING_RECORD_MAX];
+
+    record(rec, recording_encode_result(rec, k_uptime_get_32(), result));
+}
+
+void record_get_stats(struct record_stats *stats) {
+    stats->records = atomic_get(&records);
+    stats->dropped = atomic_get(&dropped);
+}
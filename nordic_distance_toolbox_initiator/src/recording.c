@@ -0,0 +1,185 @@
+#include <recording.h>
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#define START_LEN (4 + 1 + BT_ADDR_LE_SIZE)
+#define SCAN_LEN_MIN (BT_ADDR_LE_SIZE + 2)
+#define REQUEST_LEN (BT_ADDR_LE_SIZE + 1 + 4 + 4 + 4)
+#define RESULT_LEN (BT_ADDR_LE_SIZE + 3 + 4 * 4)
+
+BUILD_ASSERT(SCAN_LEN_MIN + RECORDING_SCAN_DATA_MAX <= RECORDING_PAYLOAD_MAX);
+BUILD_ASSERT(REQUEST_LEN <= RECORDING_PAYLOAD_MAX && RESULT_LEN <= RECORDING_PAYLOAD_MAX);
+
+static uint8_t *put_header(uint8_t *buf, enum recording_type type, uint8_t len, uint32_t time_ms) {
+    buf[0] = type;
+    buf[1] = len;
+    sys_put_le32(time_ms, &buf[2]);
+    return &buf[RECORDING_HEADER_LEN];
+}
+
+static uint8_t *put_addr(uint8_t *p, const bt_addr_le_t *addr) {
+    p[0] = addr->type;
+    memcpy(&p[1], addr->a.val, sizeof(addr->a.val));
+    return p + BT_ADDR_LE_SIZE;
+}
+
+static const uint8_t *get_addr(const uint8_t *p, bt_addr_le_t *addr) {
+    addr->type = p[0];
+    memcpy(addr->a.val, &p[1], sizeof(addr->a.val));
+    return p + BT_ADDR_LE_SIZE;
+}
+
+static uint8_t *put_float(uint8_t *p, float value) {
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    sys_put_le32(bits, p);
+    return p + 4;
+}
+
+static float get_float(const uint8_t *p) {
+    uint32_t bits = sys_get_le32(p);
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+size_t recording_encode_start(uint8_t *buf, uint32_t time_ms, const bt_addr_le_t *own_addr) {
+    uint8_t *p = put_header(buf, RECORDING_START, START_LEN, time_ms);
+
+    sys_put_le32(RECORDING_MAGIC, p);
+    p[4] = RECORDING_VERSION;
+    put_addr(&p[5], own_addr);
+    return RECORDING_HEADER_LEN + START_LEN;
+}
+
+size_t recording_encode_scan(uint8_t *buf, uint32_t time_ms, const struct recording_scan *scan) {
+    uint8_t len = MIN(scan->data_len, RECORDING_SCAN_DATA_MAX);
+    uint8_t *p = put_header(buf, RECORDING_SCAN, SCAN_LEN_MIN + len, time_ms);
+
+    p = put_addr(p, &scan->addr);
+    p[0] = scan->adv_type;
+    p[1] = scan->rssi;
+    memcpy(&p[2], scan->data, len);
+    return RECORDING_HEADER_LEN + SCAN_LEN_MIN + len;
+}
+
+size_t recording_encode_request(uint8_t *buf, uint32_t time_ms, const struct dm_request *req) {
+    uint8_t *p = put_header(buf, RECORDING_REQUEST, REQUEST_LEN, time_ms);
+
+    p = put_addr(p, &req->bt_addr);
+    p[0] = req->ranging_mode;
+    sys_put_le32(req->rng_seed, &p[1]);
+    sys_put_le32(req->start_delay_us, &p[5]);
+    sys_put_le32(req->extra_window_time_us, &p[9]);
+    return RECORDING_HEADER_LEN + REQUEST_LEN;
+}
+
+size_t recording_encode_result(uint8_t *buf, uint32_t time_ms, const struct dm_result *result) {
+    uint8_t *p = put_header(buf, RECORDING_RESULT, RESULT_LEN, time_ms);
+
+    p = put_addr(p, &result->bt_addr);
+    p[0] = result->status;
+    p[1] = result->quality;
+    p[2] = result->ranging_mode;
+    p += 3;
+    if (result->ranging_mode == DM_RANGING_MODE_MCPD) {
+        p = put_float(p, result->dist_estimates.mcpd.ifft);
+        p = put_float(p, result->dist_estimates.mcpd.phase_slope);
+        p = put_float(p, result->dist_estimates.mcpd.rssi_openspace);
+        put_float(p, result->dist_estimates.mcpd.best);
+    }
+    else {
+        p = put_float(p, result->dist_estimates.rtt.rtt);
+        memset(p, 0, 3 * 4);
+    }
+    return RECORDING_HEADER_LEN + RESULT_LEN;
+}
+
+int recording_next(const uint8_t *data, size_t len, size_t *pos, struct recording_record *rec) {
+    if (*pos >= len) {
+        return -ENODATA;
+    }
+    if (len - *pos < RECORDING_HEADER_LEN ||
+        len - *pos - RECORDING_HEADER_LEN < data[*pos + 1]) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = &data[*pos];
+
+    rec->type = p[0];
+    rec->len = p[1];
+    rec->time_ms = sys_get_le32(&p[2]);
+    rec->payload = &p[RECORDING_HEADER_LEN];
+    *pos += RECORDING_HEADER_LEN + rec->len;
+    return 0;
+}
+
+/* Payloads may grow within a version, so only a minimum length is checked. */
+int recording_decode_start(const struct recording_record *rec, bt_addr_le_t *own_addr) {
+    const uint8_t *p = rec->payload;
+
+    if (rec->type != RECORDING_START || rec->len < START_LEN || sys_get_le32(p) != RECORDING_MAGIC ||
+        p[4] != RECORDING_VERSION) {
+        return -EINVAL;
+    }
+    get_addr(&p[5], own_addr);
+    return 0;
+}
+
+int recording_decode_scan(const struct recording_record *rec, struct recording_scan *scan) {
+    if (rec->type != RECORDING_SCAN || rec->len < SCAN_LEN_MIN) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = get_addr(rec->payload, &scan->addr);
+
+    scan->adv_type = p[0];
+    scan->rssi = p[1];
+    scan->data_len = MIN(rec->len - SCAN_LEN_MIN, RECORDING_SCAN_DATA_MAX);
+    memcpy(scan->data, &p[2], scan->data_len);
+    return 0;
+}
+
+int recording_decode_request(const struct recording_record *rec, struct dm_request *req) {
+    if (rec->type != RECORDING_REQUEST || rec->len < REQUEST_LEN) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = get_addr(rec->payload, &req->bt_addr);
+
+    req->role = DM_ROLE_INITIATOR;
+    req->ranging_mode = p[0];
+    req->rng_seed = sys_get_le32(&p[1]);
+    req->start_delay_us = sys_get_le32(&p[5]);
+    req->extra_window_time_us = sys_get_le32(&p[9]);
+    return 0;
+}
+
+int recording_decode_result(const struct recording_record *rec, struct dm_result *result) {
+    if (rec->type != RECORDING_RESULT || rec->len < RESULT_LEN) {
+        return -EINVAL;
+    }
+
+    const uint8_t *p = get_addr(rec->payload, &result->bt_addr);
+
+    memset(&result->dist_estimates, 0, sizeof(result->dist_estimates));
+    result->status = p[0];
+    result->quality = p[1];
+    result->ranging_mode = p[2];
+    p += 3;
+    if (result->ranging_mode == DM_RANGING_MODE_MCPD) {
+        result->dist_estimates.mcpd.ifft = get_float(p);
+        result->dist_estimates.mcpd.phase_slope = get_float(p + 4);
+        result->dist_estimates.mcpd.rssi_openspace = get_float(p + 8);
+        result->dist_estimates.mcpd.best = get_float(p + 12);
+    }
+    else {
+        result->dist_estimates.rtt.rtt = get_float(p);
+    }
+    return 0;
+}
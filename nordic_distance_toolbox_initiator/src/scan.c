@@ -15,97 +15,97 @@
 
 #include <dm.h>
 
+#include <dm_seed.h>
+#include <ndt_adv.h>
+#include <calib.h>
+#include <method.h>
 #include <peer.h>
+#include <scheduler.h>
+#include <recording.h>
+#include <stats.h>
+#include <trace.h>
 
-struct adv_mfg_data {
-	uint16_t company_code;	    /* Company Identifier Code. */
-	uint32_t support_dm_code;   /* To identify the device that supports distance measurement. */
-	uint32_t rng_seed;          /* Random seed used for generating hopping patterns. */
-} __packed;
+/* Our identity address, the reflector sees it in our scan requests. */
+static bt_addr_le_t own_addr;
 
 // TODO add log level kconfig
 LOG_MODULE_REGISTER(scan, LOG_LEVEL_DBG);
 
-static uint64_t bt_addr_to_int(const bt_addr_le_t *addr) {
-    uint64_t addr_int = 0;
-    for (int i = 0; i < BT_ADDR_SIZE; i++) {
-        addr_int = addr_int << 8;
-        addr_int += addr->a.val[i];
-    }
-    return addr_int;
-}
-
-#define MCPD 0
-#define RTT 1
-volatile int mode_set = MCPD;
-
+/* A short press of the button cycles the ranging method policy: automatic,
+ * MCPD, RTT. Holding it starts a calibration with the next peer measured,
+ * which must be at CONFIG_DM_CALIB_REFERENCE_CM.
+ */
 static void toggle_mode_set(struct input_event *evt) {
-    if (evt->value == 0) {
+    static int64_t pressed_at;
+
+    if (evt->value) {
+        pressed_at = k_uptime_get();
         return;
     }
-    if (mode_set == MCPD) {
-        mode_set = RTT;
+    if (k_uptime_get() - pressed_at < CONFIG_DM_CALIB_HOLD_MS) {
+        method_set_policy((method_get_policy() + 1) % METHOD_POLICY_COUNT);
+        return;
     }
-    else {
-        mode_set = MCPD;
+
+    int err = calib_start(0, CONFIG_DM_CALIB_REFERENCE_CM / 100.0f);
+    if (err) {
+        LOG_WRN("Calibration already running");
     }
 }
 
 INPUT_CALLBACK_DEFINE(NULL, toggle_mode_set);
 
-static void scan_filter_match(struct bt_scan_device_info *device_info,
-                       struct bt_scan_filter_match *filter_match,
-                       bool connectable)
-{
-    uint64_t addr_int = bt_addr_to_int(&device_info->recv_info->addr);
-
-    if (!filter_match->uuid.match) {
-        return;
+static bool ndt_adv_find(struct bt_data *data, void *user_data) {
+    if (data->type == BT_DATA_MANUFACTURER_DATA) {
+        return ndt_adv_parse(data->data, data->data_len, user_data) != 0;
     }
+    return true;
+}
 
-    static struct bt_uuid_128 *uuid;
-    if (filter_match->uuid.uuid[0]->type == 2) {
-        uuid = (struct bt_uuid_128 *)(filter_match->uuid.uuid[0]);
-    }
-    else {
-        return;
-    }
+/* Returns 0 if the report carries our manufacturer data. The view points
+ * into the report, so it is only valid inside the scan callback.
+ */
+static int ndt_adv_find_in(struct net_buf_simple *adv_data, struct ndt_adv *adv) {
+    adv->data = NULL;
+    bt_data_parse(adv_data, ndt_adv_find, adv);
+    return adv->data != NULL ? 0 : -ENOENT;
+}
 
-    struct peer *p = get_peer(uuid);
-    if (p == NULL) {
-        return;
-    }
+/* The seed is derived once per advertised seed and epoch, not per report. */
+static void peer_seed_update(struct peer *p, const struct ndt_adv *adv) {
+    uint32_t base = ndt_adv_rng_seed(adv);
+    uint16_t epoch = ndt_adv_seed_epoch(adv);
 
-    uint32_t current_time = k_uptime_get();
-    if (p->timestamp + CONFIG_DM_PEER_DELAY_MS < current_time) {
-        p->timestamp = current_time;
-    }
-    else {
+    if (p->seed_set && p->seed_base == base && p->seed_epoch == epoch) {
         return;
     }
+    p->seed_base = base;
+    p->seed_epoch = epoch;
+    p->rng_seed = dm_seed_derive(base, &own_addr, epoch);
+    p->seed_set = true;
+}
+
+/* Request a ranging with p, triggered by one of its advertising reports.
+ * adv is the report's manufacturer data, already parsed by the caller.
+ */
+static void peer_range(struct peer *p, struct bt_scan_device_info *device_info,
+                       const struct ndt_adv *adv) {
+    TRACE(TRACE_SCAN, p->addr_int, 0);
+    p->last_seen = k_uptime_get_32();
 
     struct dm_request req;
     req.role = DM_ROLE_INITIATOR;
 
-    if (p->ranging_mode == RANGING_MODE_MCPD) {
-        if (mode_set == MCPD) {
-            req.ranging_mode = DM_RANGING_MODE_MCPD;
-        }
-        else {
-            return;
-        }
-    }
-    else if (p->ranging_mode == RANGING_MODE_RTT) {
-        if (mode_set == RTT) {
-            req.ranging_mode = DM_RANGING_MODE_RTT;
-        }
-        else {
-            return;
-        }
-    }
-    else {
+    enum dm_ranging_mode mode;
+
+    if (method_select(p, &mode)) {
         return;
     }
+    req.ranging_mode = mode;
+
+    /* The start delay tells the reflector which method this ranging uses. */
+    req.start_delay_us = ndt_adv_start_delay_us(p->modes, mode == DM_RANGING_MODE_RTT ? NDT_ADV_MODE_RTT
+                                                                                      : NDT_ADV_MODE_MCPD);
 
    /* We need to make sure that we only initiate a ranging to a single peer.
     * A scan response that is received by this device can be received by
@@ -120,58 +120,227 @@ static void scan_filter_match(struct bt_scan_device_info *device_info,
 
     bt_addr_le_copy(&req.bt_addr, device_info->recv_info->addr);
 
+    /* Pick up a new seed epoch from this report, the reflector uses it
+     * for the ranging this report's scan request triggers.
+     */
+    peer_seed_update(p, adv);
+
     req.rng_seed = p->rng_seed;
-    req.start_delay_us = 0;
     req.extra_window_time_us = 0;
 
-    int err = dm_request_add(&req);
-    if (err) {
+    int err = sched_request(p, &req);
+    if (!err) {
+        TRACE(TRACE_REQUEST, p->addr_int, mode);
+        record_request(&req);
+    }
+    if (err && err != -EBUSY) {
         LOG_ERR("Failed to add request (err %d)\n", err);
     }
 }
 
-bool validate_ndt_manufacturer_data(uint8_t *data, uint8_t data_len) {
-    struct adv_mfg_data *mfg_data;
+static void scan_filter_match(struct bt_scan_device_info *device_info,
+                       struct bt_scan_filter_match *filter_match,
+                       bool connectable)
+{
+    uint64_t addr_int = bt_addr_to_int(device_info->recv_info->addr);
+
+    record_scan(device_info);
 
-    mfg_data = (struct adv_mfg_data *)data;
+    if (!filter_match->uuid.match) {
+        return;
+    }
+
+    static struct bt_uuid_128 *uuid;
+    if (filter_match->uuid.uuid[0]->type == 2) {
+        uuid = (struct bt_uuid_128 *)(filter_match->uuid.uuid[0]);
+    }
+    else {
+        return;
+    }
 
+    /* The scan response carries the UUID and the seed epoch. */
+    struct net_buf_simple adv_data = *device_info->adv_data;
+    struct ndt_adv adv;
 
-    if (mfg_data->support_dm_code == 0x0D17A9CE) {
-        return true;
+    if (ndt_adv_find_in(&adv_data, &adv)) {
+        return;
     }
 
-    if (mfg_data->support_dm_code == 0x1D17A9CE) {
-        return true;
+    peer_lock();
+    struct peer *p = get_peer(uuid);
+
+    if (p != NULL) {
+        peer_range(p, device_info, &adv);
     }
-    return false;
+    peer_unlock();
 }
 
-static void set_filter_uuid(struct bt_uuid_128 *uuid) {
-    LOG_INF("Adding filter");
+#define NUM_FILTERS CONFIG_BT_SCAN_UUID_CNT
+
+/* UUID filters waiting to be committed by filter_work. When filter_rebuild is
+ * set the queue holds every active peer and the installed filters are
+ * replaced, otherwise the queued UUIDs are appended to them.
+ */
+static struct k_spinlock filter_lock;
+static struct bt_uuid_128 filter_queue[NUM_FILTERS];
+static size_t filter_queue_len;
+static bool filter_rebuild;
+
+static size_t filters_installed;
+static uint32_t filter_commits;
+static uint64_t scan_paused_us;
+
+static void filter_work_handler(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(filter_work, filter_work_handler);
+
+/* Returns -ENOMEM if the queue is full until the next commit. */
+static int filter_queue_add(const struct bt_uuid_128 *uuid) {
+    int err = 0;
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+
+    if (filter_queue_len < NUM_FILTERS) {
+        filter_queue[filter_queue_len++] = *uuid;
+    }
+    else {
+        err = -ENOMEM;
+    }
+
+    k_spin_unlock(&filter_lock, key);
+
+    k_work_schedule(&filter_work, K_MSEC(CONFIG_DM_SCAN_FILTER_COALESCE_MS));
+    return err;
+}
 
+struct filter_snapshot {
+    struct bt_uuid_128 uuids[NUM_FILTERS];
+    size_t len;
+};
+
+static void snapshot_peer_filter(struct peer *p, void *user_data) {
+    struct filter_snapshot *snap = user_data;
+
+    if (snap->len < NUM_FILTERS) {
+        snap->uuids[snap->len++] = p->uuid;
+        p->filter_set = true;
+    }
+}
+
+/* bt_scan cannot remove a single filter, so evicted peers are dropped by
+ * clearing all filters and re-adding the ones for peers still in the table.
+ * The table is read under the peer lock first, the queue is only swapped
+ * under filter_lock, so a spinlock is never held across the walk.
+ */
+static void filter_queue_rebuild(void) {
+    struct filter_snapshot snap = {0};
+
+    /* Peers discovered from a single advertisement have no UUID filter. */
+    if (IS_ENABLED(CONFIG_DM_DISCOVERY_SINGLE_ADV)) {
+        return;
+    }
+
+    peer_lock();
+    peer_foreach_active(snapshot_peer_filter, &snap);
+    peer_unlock();
+
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+
+    memcpy(filter_queue, snap.uuids, snap.len * sizeof(filter_queue[0]));
+    filter_queue_len = snap.len;
+    filter_rebuild = true;
+
+    k_spin_unlock(&filter_lock, key);
+
+    k_work_schedule(&filter_work, K_MSEC(CONFIG_DM_SCAN_FILTER_COALESCE_MS));
+}
+
+static void filter_work_handler(struct k_work *work) {
+    struct bt_uuid_128 uuids[NUM_FILTERS];
+    size_t count;
+    bool rebuild;
     int err;
+
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+
+    count = filter_queue_len;
+    rebuild = filter_rebuild;
+    memcpy(uuids, filter_queue, count * sizeof(uuids[0]));
+    filter_queue_len = 0;
+    filter_rebuild = false;
+
+    k_spin_unlock(&filter_lock, key);
+
+    if (count == 0 && !rebuild) {
+        return;
+    }
+
+    LOG_INF("Committing %zu filters%s", count, rebuild ? " (rebuild)" : "");
+
+    int64_t paused_at = k_uptime_ticks();
+
     err = bt_scan_stop();
     if (err) {
         LOG_ERR("Scanning failed to stop (err %d)\n", err);
-        return err;
+        stats_inc(STATS_SCAN_ERRORS);
     }
 
-	err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, uuid);
-	if (err) {
-		LOG_ERR("Scanning filters cannot be set (err %d)\n", err);
-		return err;
-	}
+    if (rebuild) {
+        bt_scan_filter_remove_all();
+        filters_installed = 0;
+    }
 
-	err = bt_scan_filter_enable(BT_SCAN_UUID_FILTER, false);
-	if (err) {
-		LOG_ERR("Filters cannot be turned on (err %d)\n", err);
-		return err;
-	}
+    for (size_t i = 0; i < count; i++) {
+        err = bt_scan_filter_add(BT_SCAN_FILTER_TYPE_UUID, &uuids[i]);
+        if (err) {
+            LOG_ERR("Scanning filters cannot be set (err %d)\n", err);
+            stats_inc(STATS_SCAN_ERRORS);
+            break;
+        }
+        filters_installed++;
+    }
+
+    if (filters_installed > 0) {
+        err = bt_scan_filter_enable(BT_SCAN_UUID_FILTER, false);
+        if (err) {
+            LOG_ERR("Filters cannot be turned on (err %d)\n", err);
+            stats_inc(STATS_SCAN_ERRORS);
+        }
+    }
+    else {
+        bt_scan_filter_disable();
+    }
 
     err = bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
     if (err) {
         LOG_ERR("Scanning failed to start (err %d)\n", err);
-        return err;
+        stats_inc(STATS_SCAN_ERRORS);
+    }
+
+    filter_commits++;
+    scan_paused_us += k_ticks_to_us_ceil64(k_uptime_ticks() - paused_at);
+}
+
+uint32_t scan_filter_commits(void) {
+    return filter_commits;
+}
+
+uint64_t scan_paused_time_us(void) {
+    return scan_paused_us;
+}
+
+static void peer_sweep(void) {
+    static uint32_t last_sweep;
+    uint32_t now = k_uptime_get_32();
+
+    if (now - last_sweep < CONFIG_DM_PEER_IDLE_TIMEOUT_MS / 4) {
+        return;
+    }
+    last_sweep = now;
+
+    int evicted = peer_evict_idle(CONFIG_DM_PEER_IDLE_TIMEOUT_MS);
+    if (evicted > 0) {
+        LOG_INF("Evicted %d idle peers", evicted);
+        filter_queue_rebuild();
     }
 }
 
@@ -180,12 +349,24 @@ static bool ndt_supported(struct bt_data *data, void *user_data) {
     volatile uint64_t addr = *(uint64_t *)user_data;
     switch(data->type) {
         case BT_DATA_MANUFACTURER_DATA:
-            struct adv_mfg_data mfg_data = *(struct adv_mfg_data *)data->data;
-            if (validate_ndt_manufacturer_data(data->data, data->data_len)) {
-                err = create_peer(addr, mfg_data.rng_seed, mfg_data.support_dm_code);
+            struct ndt_adv adv;
+
+            if (ndt_adv_parse(data->data, data->data_len, &adv) == 0) {
+                err = create_peer(addr, ndt_adv_modes(&adv));
+                if (err == -ENOMEM && peer_evict_lru(CONFIG_DM_PEER_EVICT_MIN_IDLE_MS) == 0) {
+                    filter_queue_rebuild();
+                    err = create_peer(addr, ndt_adv_modes(&adv));
+                }
+                if (err == -ENOMEM) {
+                    stats_inc(STATS_PEER_NO_MEM);
+                }
                 if (err) {
                     LOG_ERR("Failed to create peer (err %d)\n", err);
+                    break;
                 }
+                peer_lock();
+                peer_seed_update(get_peer_by_addr(addr), &adv);
+                peer_unlock();
             }
             break;
         case BT_DATA_UUID128_ALL:
@@ -195,12 +376,19 @@ static bool ndt_supported(struct bt_data *data, void *user_data) {
             uuid.uuid.type = BT_UUID_TYPE_128;
 
             err = uuid_set_peer(addr, uuid);
+            if (err == -EALREADY) {
+                break;
+            }
             if (err) {
                 LOG_ERR("Failed to set peer uuid (err %d)\n", err);
                 LOG_ERR("UUID: %s", bt_uuid_str(&uuid));
             } 
-            else {
-                set_filter_uuid(&uuid);
+            else if (filter_queue_add(&uuid)) {
+                /* Refused for now, its next scan response finds the queue
+                 * committed and adds the peer again.
+                 */
+                remove_peer(addr);
+                stats_inc(STATS_FILTER_FULL);
             }
             break;
         default:
@@ -209,10 +397,57 @@ static bool ndt_supported(struct bt_data *data, void *user_data) {
     return true;
 }
 
+/* Everything needed to range is in the reflector's advertising data, so a
+ * new peer is created and ranged from the very first report, without
+ * waiting for a scan response and a UUID filter.
+ */
+static void discover_single_adv(struct bt_scan_device_info *device_info) {
+    struct net_buf_simple adv_data = *device_info->adv_data;
+    struct ndt_adv adv;
+    uint32_t id;
+    int err;
+
+    if (ndt_adv_find_in(&adv_data, &adv) || ndt_adv_id(&adv, &id)) {
+        return;
+    }
+
+    uint64_t addr_int = bt_addr_to_int(device_info->recv_info->addr);
+
+    err = create_peer(addr_int, ndt_adv_modes(&adv));
+    if (err == -ENOMEM && peer_evict_lru(CONFIG_DM_PEER_EVICT_MIN_IDLE_MS) == 0) {
+        err = create_peer(addr_int, ndt_adv_modes(&adv));
+    }
+    if (err == -ENOMEM) {
+        stats_inc(STATS_PEER_NO_MEM);
+    }
+    if (err) {
+        LOG_ERR("Failed to create peer (err %d)\n", err);
+        return;
+    }
+
+    err = id_set_peer(addr_int, id);
+    if (err && err != -EALREADY) {
+        LOG_ERR("Failed to set peer id (err %d)\n", err);
+        return;
+    }
+
+    peer_lock();
+    peer_range(get_peer_by_addr(addr_int), device_info, &adv);
+    peer_unlock();
+}
+
 static void scan_filter_no_match(struct bt_scan_device_info *device_info,
                           bool connectable)
 {
-    uint64_t addr_int = bt_addr_to_int(&device_info->recv_info->addr);
+    uint64_t addr_int = bt_addr_to_int(device_info->recv_info->addr);
+
+    record_scan(device_info);
+    peer_sweep();
+
+    if (IS_ENABLED(CONFIG_DM_DISCOVERY_SINGLE_ADV)) {
+        discover_single_adv(device_info);
+        return;
+    }
 
     switch (device_info->recv_info->adv_type) {
         case BT_GAP_ADV_TYPE_SCAN_RSP:
@@ -231,7 +466,9 @@ static struct bt_le_scan_param scan_param = {
     .type = BT_LE_SCAN_TYPE_ACTIVE,
     .interval = BT_GAP_SCAN_FAST_INTERVAL,
     .window = BT_GAP_SCAN_FAST_WINDOW,
-    .options = BT_LE_SCAN_OPT_FILTER_DUPLICATE,
+    /* Without scan filters every report is a chance to range. */
+    .options = IS_ENABLED(CONFIG_DM_DISCOVERY_SINGLE_ADV) ? BT_LE_SCAN_OPT_NONE
+                                                         : BT_LE_SCAN_OPT_FILTER_DUPLICATE,
     .timeout = 0,
 };
 
@@ -245,6 +482,10 @@ int scan_init(void)
 		.conn_param = BT_LE_CONN_PARAM_DEFAULT
 	};
 
+	size_t id_count = 1;
+
+	bt_id_get(&own_addr, &id_count);
+
 	bt_scan_init(&scan_init);
 	bt_scan_cb_register(&scan_cb);
 
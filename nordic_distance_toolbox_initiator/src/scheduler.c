@@ -0,0 +1,262 @@
+#include <scheduler.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/dlist.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_SHELL
+#include <stdlib.h>
+#include <zephyr/shell/shell.h>
+#endif
+
+LOG_MODULE_REGISTER(sched, LOG_LEVEL_DBG);
+
+/* Stride scheduling: every grant advances a peer's pass by STRIDE / weight,
+ * and the ready peer with the lowest pass is the one owed the next slot.
+ */
+#define STRIDE (1 << 16)
+#define GRANT_INTERVAL_MS (1000 / CONFIG_DM_SCHED_MAX_RATE_HZ)
+
+/* Peers waiting for their deadline, sorted by deadline. */
+static sys_dlist_t waiting = SYS_DLIST_STATIC_INIT(&waiting);
+
+/* Peers whose deadline has passed, sorted by pass. */
+static sys_dlist_t ready = SYS_DLIST_STATIC_INIT(&ready);
+
+static uint32_t global_pass;
+static uint32_t next_grant;
+static struct sched_stats stats;
+
+static bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+
+static void insert_sorted(sys_dlist_t *list, struct peer *p, bool by_deadline) {
+    struct peer *it;
+
+    SYS_DLIST_FOR_EACH_CONTAINER(list, it, sched_node) {
+        bool before = by_deadline ? time_before(p->sched_deadline, it->sched_deadline)
+                                  : time_before(p->sched_pass, it->sched_pass);
+        if (before) {
+            sys_dlist_insert(&it->sched_node, &p->sched_node);
+            return;
+        }
+    }
+    sys_dlist_append(list, &p->sched_node);
+}
+
+static void make_ready(struct peer *p) {
+    /* A peer that has been away must not catch up on the slots it missed. */
+    if (time_before(p->sched_pass, global_pass)) {
+        p->sched_pass = global_pass;
+    }
+    p->sched_ready = true;
+    insert_sorted(&ready, p, false);
+}
+
+static void promote_due(uint32_t now) {
+    sys_dnode_t *node;
+
+    while ((node = sys_dlist_peek_head(&waiting)) != NULL) {
+        struct peer *p = CONTAINER_OF(node, struct peer, sched_node);
+
+        if (time_before(now, p->sched_deadline)) {
+            break;
+        }
+        sys_dlist_remove(node);
+        make_ready(p);
+    }
+}
+
+/* A peer counts as reachable until it misses roughly two of its own
+ * advertising intervals, so slow advertisers keep their claim on a slot.
+ */
+static bool peer_reachable(const struct peer *p, uint32_t now) {
+    uint32_t grace = MAX(CONFIG_DM_SCHED_STALE_MS, 2 * p->sched_report_interval);
+
+    return now - p->last_seen <= grace;
+}
+
+/* Whether p has to leave this slot to a ready peer at least a round behind
+ * it. Any peer in the same round as the most underserved one may take the
+ * slot, so a peer with a slow advertising interval does not hold everyone
+ * else back. Peers further ahead may too, unless a peer behind them is
+ * expected to advertise before the slot after this one opens: the slots it
+ * cannot take go to the others instead of unused.
+ */
+static bool slot_owed_elsewhere(const struct peer *p, uint32_t now) {
+    uint32_t slot_end = MAX(now, next_grant) + GRANT_INTERVAL_MS;
+    struct peer *q;
+
+    SYS_DLIST_FOR_EACH_CONTAINER(&ready, q, sched_node) {
+        if (time_before(p->sched_pass, q->sched_pass + STRIDE)) {
+            break;
+        }
+        if (peer_reachable(q, now) &&
+            time_before(q->sched_last_report + q->sched_report_interval, slot_end)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void track_report_interval(struct peer *p, uint32_t now) {
+    if (p->sched_last_report != 0) {
+        int32_t gap = now - p->sched_last_report;
+        int32_t interval = p->sched_report_interval;
+
+        p->sched_report_interval = interval + (gap - interval) / 4;
+    }
+    p->sched_last_report = now;
+}
+
+int sched_request(struct peer *p, struct dm_request *req) {
+    uint32_t now = k_uptime_get_32();
+
+    track_report_interval(p, now);
+
+    if (!sys_dnode_is_linked(&p->sched_node)) {
+        make_ready(p);
+    }
+
+    promote_due(now);
+
+    if (!p->sched_ready) {
+        stats.not_due++;
+        return -EBUSY;
+    }
+
+    if (slot_owed_elsewhere(p, now)) {
+        stats.not_turn++;
+        return -EBUSY;
+    }
+
+    if (time_before(now, next_grant)) {
+        stats.rate_limited++;
+        return -EBUSY;
+    }
+
+    int err = dm_request_add(req);
+    if (err) {
+        stats.rejected++;
+        return err;
+    }
+
+    stats.granted++;
+    next_grant = now + GRANT_INTERVAL_MS;
+    global_pass = p->sched_pass;
+
+    p->timestamp = now;
+    p->sched_pass += STRIDE / sched_weight(p);
+
+    /* Deadlines advance from the previous deadline rather than from now, so
+     * that waiting for the peer's next advertisement does not stretch its
+     * period. A peer that fell far behind restarts half a period out.
+     */
+    uint32_t period = p->interval_ms / sched_weight(p);
+    p->sched_deadline += period;
+    if (time_before(p->sched_deadline, now + period / 2)) {
+        p->sched_deadline = now + period / 2;
+    }
+    p->sched_ready = false;
+
+    sys_dlist_remove(&p->sched_node);
+    insert_sorted(&waiting, p, true);
+
+    return 0;
+}
+
+void sched_report_distance(struct peer *p, float distance) {
+    if (p->distance_count == 0) {
+        p->distance_avg = distance;
+        p->distance_count++;
+        return;
+    }
+
+    /* Compare successive values of a short moving average so that
+     * measurement noise alone does not push the rate up.
+     */
+    float prev = p->distance_avg;
+    p->distance_avg += (distance - prev) / 4;
+
+    /* Aim for the peer to move about one step between measurements: halve
+     * the interval as soon as it moves more than that, and back off
+     * gradually while it is well below.
+     */
+    float step = CONFIG_DM_PEER_ADAPT_STEP_CM / 100.0f;
+    float travel = fabsf(p->distance_avg - prev);
+    uint32_t interval = p->interval_ms;
+
+    if (travel > step) {
+        interval /= 2;
+    }
+    else if (travel < step / 4) {
+        interval += interval / 4;
+    }
+
+    p->interval_ms = CLAMP(interval, CONFIG_DM_PEER_INTERVAL_MIN_MS, CONFIG_DM_PEER_INTERVAL_MAX_MS);
+}
+
+int sched_set_weight(struct peer *p, uint8_t weight) {
+    if (weight == 0) {
+        return -EINVAL;
+    }
+    p->sched_weight = weight;
+    return 0;
+}
+
+uint8_t sched_weight(const struct peer *p) {
+    return p->sched_weight ? p->sched_weight : 1;
+}
+
+void sched_remove(struct peer *p) {
+    if (sys_dnode_is_linked(&p->sched_node)) {
+        sys_dlist_remove(&p->sched_node);
+    }
+    p->sched_ready = false;
+}
+
+void sched_get_stats(struct sched_stats *out) {
+    *out = stats;
+}
+
+void sched_reset_stats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_weight(const struct shell *sh, size_t argc, char **argv) {
+    char *end;
+    uint64_t addr_int = strtoull(argv[1], &end, 16);
+    long weight = strtol(argv[2], NULL, 10);
+
+    if (weight < 1 || weight > UINT8_MAX) {
+        shell_error(sh, "Weight must be 1 to %u", UINT8_MAX);
+        return -EINVAL;
+    }
+
+    peer_lock();
+    struct peer *p = *end == '\0' ? get_peer_by_addr(addr_int) : NULL;
+
+    if (p != NULL) {
+        sched_set_weight(p, weight);
+    }
+    peer_unlock();
+
+    if (p == NULL) {
+        shell_error(sh, "No peer %s, see \"ndt peers\"", argv[1]);
+        return -ENOENT;
+    }
+    shell_print(sh, "%012llx weight %ld", addr_int, weight);
+    return 0;
+}
+
+SHELL_SUBCMD_ADD((ndt), weight, NULL,
+                 "Give a peer a larger share of the ranging slots: <address> <1-255>", cmd_weight,
+                 3, 0);
+#endif
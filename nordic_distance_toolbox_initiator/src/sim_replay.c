@@ -0,0 +1,141 @@
+#include <sim.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include <dm.h>
+#include <recording.h>
+
+#include <sim_replay.h>
+
+LOG_MODULE_REGISTER(sim_replay, LOG_LEVEL_INF);
+
+/* The recording is compiled in from common/recordings, see ndr.py. */
+
+#define MATCH_MS CONFIG_DM_SIM_REPLAY_MATCH_MS
+
+static bt_addr_le_t own_addr;
+static size_t session_len;
+static uint32_t start_ms;
+static uint32_t duration_ms;
+
+static uint32_t base_ms;
+static uint64_t base_host_us;
+
+static ATOMIC_DEFINE(used, MAX(SIM_REPLAY_RESULTS, 1));
+static uint32_t matched;
+static uint32_t unmatched;
+
+static int replay_init(void) {
+    struct recording_record rec;
+    size_t pos = 0;
+
+    if (recording_next(sim_replay, sizeof(sim_replay), &pos, &rec) ||
+        recording_decode_start(&rec, &own_addr)) {
+        LOG_ERR("Replay is not a recording");
+        return -EINVAL;
+    }
+    start_ms = rec.time_ms;
+    session_len = sizeof(sim_replay);
+
+    while (true) {
+        size_t at = pos;
+        int err = recording_next(sim_replay, sizeof(sim_replay), &pos, &rec);
+
+        if (err == -ENODATA) {
+            break;
+        }
+        if (err || rec.type == RECORDING_START) {
+            if (err) {
+                LOG_WRN("Replay cut short at byte %zu", at);
+            }
+            session_len = at;
+            break;
+        }
+        duration_ms = rec.time_ms - start_ms;
+    }
+    return 0;
+}
+
+SYS_INIT(replay_init, APPLICATION, 0);
+
+void sim_replay_start(void) {
+    base_ms = k_uptime_get_32();
+    base_host_us = sim_host_time_us();
+}
+
+const bt_addr_le_t *sim_replay_own_addr(void) {
+    return &own_addr;
+}
+
+uint32_t sim_replay_duration_ms(void) {
+    return duration_ms;
+}
+
+int sim_replay_next_scan(size_t *pos, uint32_t *uptime_ms, struct recording_scan *scan) {
+    struct recording_record rec;
+
+    while (!recording_next(sim_replay, session_len, pos, &rec)) {
+        if (rec.type == RECORDING_SCAN && !recording_decode_scan(&rec, scan)) {
+            *uptime_ms = base_ms + rec.time_ms - start_ms;
+            return 0;
+        }
+    }
+    return -ENODATA;
+}
+
+bool sim_replay_result(const struct dm_request *req, struct dm_result *result) {
+    uint32_t now = k_uptime_get_32() - base_ms;
+    uint32_t best_diff = MATCH_MS + 1;
+    int best = -1;
+    int index = 0;
+    struct recording_record rec;
+    struct dm_result r;
+    size_t pos = 0;
+
+    /* Records are in time order, the search ends past the match window. */
+    while (!recording_next(sim_replay, session_len, &pos, &rec)) {
+        int32_t diff = rec.time_ms - start_ms - now;
+
+        if (diff > MATCH_MS) {
+            break;
+        }
+        if (rec.type != RECORDING_RESULT) {
+            continue;
+        }
+
+        int i = index++;
+
+        if (abs(diff) >= best_diff || atomic_test_bit(used, i) ||
+            recording_decode_result(&rec, &r) || r.ranging_mode != req->ranging_mode ||
+            !bt_addr_le_eq(&r.bt_addr, &req->bt_addr)) {
+            continue;
+        }
+        best = i;
+        best_diff = abs(diff);
+        *result = r;
+    }
+
+    if (best < 0) {
+        unmatched++;
+        return false;
+    }
+    atomic_set_bit(used, best);
+    matched++;
+    return result->status;
+}
+
+void sim_replay_summary(void) {
+    uint32_t replayed_ms = k_uptime_get_32() - base_ms;
+    uint64_t host_us = MAX(sim_host_time_us() - base_host_us, 1);
+    uint32_t speed = (uint64_t)replayed_ms * 100000 / host_us;
+
+    LOG_INF("replay: %u requests, %u answered from %u recorded results, %u unmatched",
+            matched + unmatched, matched, SIM_REPLAY_RESULTS, unmatched);
+    LOG_INF("replay: %u ms recorded, %u ms replayed in %u ms, %u.%02ux real time", duration_ms,
+            replayed_ms, (uint32_t)(host_us / 1000), speed / 100, speed % 100);
+}
@@ -0,0 +1,432 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <bluetooth/scan.h>
+
+#include <ndt_adv.h>
+#include <recording.h>
+#include <sim.h>
+#include <method.h>
+#include <scan.h>
+#include <scheduler.h>
+
+#ifdef CONFIG_DISTANCE_DISPLAY_OLED
+#include <oled.h>
+#endif
+
+LOG_MODULE_REGISTER(sim_scan, LOG_LEVEL_INF);
+
+/* Stand-in for bt_scan and the parts of the Bluetooth host scan.c uses.
+ * Every reflector in the scenario advertises at its interval with the same
+ * advertising data and scan response layout as the reflector app, and the
+ * reports are handed to the scan callbacks the way bt_scan would, through
+ * the UUID filter when one matches. With CONFIG_DM_SIM_REPLAY the reports
+ * come from a recording instead.
+ */
+
+#define NUM_FILTERS CONFIG_BT_SCAN_UUID_CNT
+#define MAX_REFLECTORS 32
+
+/* Advertising events are delayed by up to 10 ms at random, as on air. */
+#define ADV_DELAY_MAX_MS 10
+
+struct sim_reflector {
+    const struct sim_node *node;
+    uint32_t next_adv_ms;
+    uint8_t uuid[BT_UUID_SIZE_128];
+    uint8_t ad[31];
+    uint8_t ad_len;
+    uint8_t sd[31];
+    uint8_t sd_len;
+    bool heard;
+    uint32_t first_heard_ms;
+};
+
+static struct sim_reflector reflectors[MAX_REFLECTORS];
+static int reflector_count;
+
+static struct bt_scan_cb *scan_cb;
+static bool scanning;
+static bool active;
+
+static struct k_spinlock filter_lock;
+static struct bt_uuid_128 filters[NUM_FILTERS];
+static size_t filter_count;
+static bool filter_enabled;
+
+static uint32_t adv_reports;
+static uint32_t scan_responses;
+static uint32_t filter_matches;
+
+static size_t ad_put(uint8_t *buf, size_t len, uint8_t type, const void *data, size_t data_len) {
+    buf[len] = data_len + 1;
+    buf[len + 1] = type;
+    memcpy(&buf[len + 2], data, data_len);
+    return len + 2 + data_len;
+}
+
+static void reflector_init(struct sim_reflector *r, const struct sim_node *node) {
+    struct ndt_adv_info info = {
+        .modes = node->modes,
+        .rng_seed = sim_rand(),
+    };
+    uint8_t mfg[NDT_ADV_LEN_ID];
+    uint8_t flags = BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR;
+
+    r->node = node;
+    r->next_adv_ms = sim_rand() % node->interval_ms;
+    for (int i = 0; i < sizeof(r->uuid); i += 4) {
+        sys_put_le32(sim_rand(), &r->uuid[i]);
+    }
+    info.id = sys_get_le32(r->uuid);
+
+    ndt_adv_encode(mfg, NDT_ADV_LEN_ID, &info);
+    r->ad_len = ad_put(r->ad, 0, BT_DATA_FLAGS, &flags, sizeof(flags));
+    r->ad_len = ad_put(r->ad, r->ad_len, BT_DATA_MANUFACTURER_DATA, mfg, NDT_ADV_LEN_ID);
+    r->ad_len = ad_put(r->ad, r->ad_len, BT_DATA_NAME_COMPLETE, "Thingy", 6);
+
+    ndt_adv_encode(mfg, NDT_ADV_LEN, &info);
+    r->sd_len = ad_put(r->sd, 0, BT_DATA_MANUFACTURER_DATA, mfg, NDT_ADV_LEN);
+    r->sd_len = ad_put(r->sd, r->sd_len, BT_DATA_UUID128_ALL, r->uuid, sizeof(r->uuid));
+}
+
+static int filter_find(const uint8_t *uuid) {
+    for (size_t i = 0; i < filter_count; i++) {
+        if (!memcmp(filters[i].val, uuid, BT_UUID_SIZE_128)) {
+            return i;
+        }
+    }
+    return -ENOENT;
+}
+
+/* Hand one report to the scan callbacks. uuid is the UUID the report
+ * carries, if any.
+ */
+static void report(const bt_addr_le_t *from, uint8_t adv_type, int8_t rssi, uint8_t *data,
+                   uint8_t len, const uint8_t *uuid) {
+    struct net_buf_simple buf;
+    bt_addr_le_t addr = *from;
+    struct bt_le_scan_recv_info recv_info = {
+        .addr = &addr,
+        .sid = BT_GAP_SID_INVALID,
+        .rssi = rssi,
+        .tx_power = BT_GAP_TX_POWER_INVALID,
+        .adv_type = adv_type,
+        .adv_props = BT_GAP_ADV_PROP_SCANNABLE,
+    };
+    struct bt_scan_device_info device_info = {
+        .recv_info = &recv_info,
+        .adv_data = &buf,
+    };
+
+    if (adv_type == BT_GAP_ADV_TYPE_SCAN_RSP) {
+        recv_info.adv_props |= BT_GAP_ADV_PROP_SCAN_RESPONSE;
+    }
+    net_buf_simple_init_with_data(&buf, data, len);
+
+    /* bt_scan hands the report to filter_match if it carries a UUID with
+     * a filter, the scan response of a known reflector here.
+     */
+    struct bt_scan_filter_match match = {0};
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+    int i = adv_type == BT_GAP_ADV_TYPE_SCAN_RSP && filter_enabled && uuid != NULL ? filter_find(uuid)
+                                                                                 : -ENOENT;
+
+    if (i >= 0) {
+        match.uuid.match = true;
+        match.uuid.uuid[0] = &filters[i].uuid;
+        match.uuid.count = 1;
+    }
+    k_spin_unlock(&filter_lock, key);
+
+    if (match.uuid.match) {
+        filter_matches++;
+        scan_cb->cb_addr->filter_match(&device_info, &match, false);
+    }
+    else {
+        scan_cb->cb_addr->filter_no_match(&device_info, false);
+    }
+}
+
+static void advertise(struct sim_reflector *r, const struct sim_node *self, uint32_t now) {
+    if (!scanning || scan_cb == NULL || !sim_in_range(self, r->node, now)) {
+        return;
+    }
+    if (sim_chance(CONFIG_DM_SIM_ADV_LOSS_PERMILLE)) {
+        return;
+    }
+    adv_reports++;
+    if (!r->heard) {
+        r->heard = true;
+        r->first_heard_ms = now;
+    }
+    report(&r->node->addr, BT_GAP_ADV_TYPE_SCAN_IND, -60, r->ad, r->ad_len, r->uuid);
+
+    if (!active || sim_chance(CONFIG_DM_SIM_ADV_LOSS_PERMILLE)) {
+        return;
+    }
+    scan_responses++;
+    report(&r->node->addr, BT_GAP_ADV_TYPE_SCAN_RSP, -60, r->sd, r->sd_len, r->uuid);
+}
+
+#ifdef CONFIG_DM_SIM_REPLAY
+static bool uuid_find(struct bt_data *data, void *user_data) {
+    if (data->type == BT_DATA_UUID128_ALL && data->data_len == BT_UUID_SIZE_128) {
+        *(const uint8_t **)user_data = data->data;
+        return false;
+    }
+    return true;
+}
+
+/* Feed the recorded reports instead of the scenario's reflectors. They
+ * were received once already, so none are lost on the way.
+ */
+static void replay(void) {
+    struct recording_scan scan;
+    uint32_t due;
+    size_t pos = 0;
+
+    sim_replay_start();
+    while (!sim_replay_next_scan(&pos, &due, &scan)) {
+        int32_t wait = due - k_uptime_get_32();
+
+        if (wait > 0) {
+            k_msleep(wait);
+        }
+        if (!scanning || scan_cb == NULL ||
+            (scan.adv_type == BT_GAP_ADV_TYPE_SCAN_RSP && !active)) {
+            continue;
+        }
+
+        struct net_buf_simple buf;
+        const uint8_t *uuid = NULL;
+
+        net_buf_simple_init_with_data(&buf, scan.data, scan.data_len);
+        bt_data_parse(&buf, uuid_find, &uuid);
+
+        if (scan.adv_type == BT_GAP_ADV_TYPE_SCAN_RSP) {
+            scan_responses++;
+        }
+        else {
+            adv_reports++;
+        }
+        report(&scan.addr, scan.adv_type, scan.rssi, scan.data, scan.data_len, uuid);
+    }
+    LOG_INF("Replay finished");
+}
+#endif
+
+static void sim_scan_thread(void *p1, void *p2, void *p3) {
+#ifdef CONFIG_DM_SIM_REPLAY
+    replay();
+    return;
+#endif
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+
+    if (self == NULL) {
+        LOG_ERR("Scenario has no initiator %d", CONFIG_DM_SIM_SELF);
+        return;
+    }
+
+    for (int i = 0; i < sim_node_count() && reflector_count < MAX_REFLECTORS; i++) {
+        if (sim_node_get(i)->role == SIM_ROLE_REFLECTOR) {
+            reflector_init(&reflectors[reflector_count++], sim_node_get(i));
+        }
+    }
+
+    while (reflector_count > 0) {
+        struct sim_reflector *next = &reflectors[0];
+
+        for (int i = 1; i < reflector_count; i++) {
+            if ((int32_t)(reflectors[i].next_adv_ms - next->next_adv_ms) < 0) {
+                next = &reflectors[i];
+            }
+        }
+
+        int32_t wait = next->next_adv_ms - k_uptime_get_32();
+
+        if (wait > 0) {
+            k_msleep(wait);
+        }
+        advertise(next, self, k_uptime_get_32());
+        next->next_adv_ms += next->node->interval_ms + sim_rand() % (ADV_DELAY_MAX_MS + 1);
+    }
+}
+
+K_THREAD_DEFINE(sim_scan_id, 2048, sim_scan_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO - 1, 0, 0);
+
+int bt_enable(bt_ready_cb_t cb) {
+    if (cb != NULL) {
+        cb(0);
+    }
+    return 0;
+}
+
+void bt_id_get(bt_addr_le_t *addrs, size_t *count) {
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+
+    if (self == NULL || *count == 0) {
+        *count = 0;
+        return;
+    }
+#ifdef CONFIG_DM_SIM_REPLAY
+    /* Seeds are derived from our address, so it has to be the recorded one. */
+    bt_addr_le_copy(&addrs[0], sim_replay_own_addr());
+#else
+    bt_addr_le_copy(&addrs[0], &self->addr);
+#endif
+    *count = 1;
+}
+
+void bt_data_parse(struct net_buf_simple *ad, bool (*func)(struct bt_data *data, void *user_data),
+                   void *user_data) {
+    size_t i = 0;
+
+    while (i + 1 < ad->len) {
+        uint8_t len = ad->data[i];
+        struct bt_data data;
+
+        if (len == 0 || i + 1 + len > ad->len) {
+            return;
+        }
+        data.type = ad->data[i + 1];
+        data.data_len = len - 1;
+        data.data = &ad->data[i + 2];
+        if (!func(&data, user_data)) {
+            return;
+        }
+        i += 1 + len;
+    }
+}
+
+const char *bt_uuid_str(const struct bt_uuid *uuid) {
+    static char str[2 * BT_UUID_SIZE_128 + 1];
+
+    bin2hex(BT_UUID_128(uuid)->val, BT_UUID_SIZE_128, str, sizeof(str));
+    return str;
+}
+
+void bt_scan_init(const struct bt_scan_init_param *init) {
+    active = init->scan_param == NULL || init->scan_param->type == BT_LE_SCAN_TYPE_ACTIVE;
+}
+
+void bt_scan_cb_register(struct bt_scan_cb *cb) {
+    scan_cb = cb;
+}
+
+int bt_scan_start(enum bt_scan_type scan_type) {
+    if (scanning) {
+        return -EALREADY;
+    }
+    active = scan_type == BT_SCAN_TYPE_SCAN_ACTIVE;
+    scanning = true;
+    return 0;
+}
+
+int bt_scan_stop(void) {
+    if (!scanning) {
+        return -EALREADY;
+    }
+    scanning = false;
+    return 0;
+}
+
+int bt_scan_filter_add(enum bt_scan_filter_type type, const void *data) {
+    if (type != BT_SCAN_FILTER_TYPE_UUID) {
+        return -ENOTSUP;
+    }
+
+    const struct bt_uuid_128 *uuid = data;
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+    int err = 0;
+
+    if (filter_count == NUM_FILTERS) {
+        err = -ENOMEM;
+    }
+    else if (filter_find(uuid->val) < 0) {
+        filters[filter_count++] = *uuid;
+    }
+    k_spin_unlock(&filter_lock, key);
+    return err;
+}
+
+void bt_scan_filter_remove_all(void) {
+    k_spinlock_key_t key = k_spin_lock(&filter_lock);
+
+    filter_count = 0;
+    k_spin_unlock(&filter_lock, key);
+}
+
+int bt_scan_filter_enable(uint8_t mode, bool match_all) {
+    filter_enabled = mode & BT_SCAN_UUID_FILTER;
+    return 0;
+}
+
+void bt_scan_filter_disable(void) {
+    filter_enabled = false;
+}
+
+/* Time to the first distance of each reflector, from power-on and from its
+ * first advertisement that reached us.
+ */
+static void first_distance_summary(void) {
+    int32_t first = -1;
+    uint32_t sum = 0;
+    uint32_t most = 0;
+    int ranged = 0;
+
+    for (int i = 0; i < reflector_count; i++) {
+        struct sim_reflector *r = &reflectors[i];
+        int32_t at = sim_first_distance_ms(r->node);
+
+        if (at < 0 || !r->heard) {
+            continue;
+        }
+        if (first < 0 || at < first) {
+            first = at;
+        }
+        sum += at - r->first_heard_ms;
+        most = MAX(most, at - r->first_heard_ms);
+        ranged++;
+    }
+    if (ranged == 0) {
+        LOG_INF("sim: first distance never, %d reflectors", reflector_count);
+        return;
+    }
+    LOG_INF("sim: first distance %d ms after power-on, %u ms after the first advertisement "
+            "on average, %u ms at most, %d of %d reflectors", first, sum / ranged, most, ranged,
+            reflector_count);
+}
+
+void sim_app_summary(void) {
+    struct method_stats method;
+    struct sched_stats sched;
+
+    method_get_stats(&method);
+    sched_get_stats(&sched);
+
+    LOG_INF("sim: scan %u reports, %u scan responses, %u filter matches, %u filter commits",
+            adv_reports, scan_responses, filter_matches, scan_filter_commits());
+    LOG_INF("sim: method %u MCPD, %u RTT, %u skipped", method.mcpd, method.rtt, method.skipped);
+    LOG_INF("sim: scheduler %u granted, %u not due, %u not turn, %u rate limited, %u rejected",
+            sched.granted, sched.not_due, sched.not_turn, sched.rate_limited, sched.rejected);
+    if (reflector_count > 0) {
+        first_distance_summary();
+    }
+#ifdef CONFIG_DISTANCE_DISPLAY_OLED
+    struct display_stats display;
+
+    display_get_stats(&display);
+    LOG_INF("sim: display %u frames, %u pixels, %u wakeups, %u us per frame on the host",
+            display.frames, display.pixels, display.wakeups,
+            display.frames ? (uint32_t)(display.handler_us / display.frames) : 0);
+#endif
+#ifdef CONFIG_DM_SIM_REPLAY
+    sim_replay_summary();
+#endif
+}
@@ -0,0 +1,144 @@
+#include <smoothing.h>
+
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+
+#ifdef CONFIG_DM_SMOOTH_MEDIAN
+#define MEDIAN_WINDOW CONFIG_DM_SMOOTH_MEDIAN_WINDOW
+#endif
+
+struct smooth_state {
+    uint64_t addr_int;
+    bool valid;
+#ifdef CONFIG_DM_SMOOTH_MEDIAN
+    float window[MEDIAN_WINDOW];
+    uint8_t window_len;
+    uint8_t window_pos;
+#endif
+#ifdef CONFIG_DM_SMOOTH_EMA
+    float ema;
+#endif
+#ifdef CONFIG_DM_SMOOTH_KALMAN
+    float x[2];     /* distance (m), velocity (m/s) */
+    float p[2][2];  /* estimate covariance */
+    uint32_t last_ms;
+#endif
+};
+
+static struct smooth_state state[NUM_PEERS];
+
+#ifdef CONFIG_DM_SMOOTH_MEDIAN
+static float median_update(struct smooth_state *s, float distance) {
+    float sorted[MEDIAN_WINDOW];
+
+    s->window[s->window_pos] = distance;
+    s->window_pos = (s->window_pos + 1) % MEDIAN_WINDOW;
+    if (s->window_len < MEDIAN_WINDOW) {
+        s->window_len++;
+    }
+
+    /* Insertion sort, the window is at most a handful of samples. */
+    for (int i = 0; i < s->window_len; i++) {
+        float v = s->window[i];
+        int j = i;
+
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    return sorted[s->window_len / 2];
+}
+#endif
+
+#ifdef CONFIG_DM_SMOOTH_EMA
+static float ema_update(struct smooth_state *s, float distance, bool first) {
+    if (first) {
+        s->ema = distance;
+    }
+    else {
+        s->ema += (CONFIG_DM_SMOOTH_EMA_ALPHA / 100.0f) * (distance - s->ema);
+    }
+    return s->ema;
+}
+#endif
+
+#ifdef CONFIG_DM_SMOOTH_KALMAN
+static float kalman_update(struct smooth_state *s, float distance, float r, uint32_t now_ms, bool first) {
+    const float q = CONFIG_DM_SMOOTH_KALMAN_ACCEL_CM / 100.0f;
+
+    if (first) {
+        s->x[0] = distance;
+        s->x[1] = 0;
+        s->p[0][0] = r * r;
+        s->p[0][1] = 0;
+        s->p[1][0] = 0;
+        s->p[1][1] = 1.0f;
+        s->last_ms = now_ms;
+        return distance;
+    }
+
+    float dt = (now_ms - s->last_ms) / 1000.0f;
+    s->last_ms = now_ms;
+
+    /* Predict with a constant-velocity model and white acceleration noise. */
+    float dt2 = dt * dt;
+    float qa = q * q;
+
+    s->x[0] += dt * s->x[1];
+
+    float p00 = s->p[0][0] + dt * (s->p[1][0] + s->p[0][1]) + dt2 * s->p[1][1] + qa * dt2 * dt2 / 4;
+    float p01 = s->p[0][1] + dt * s->p[1][1] + qa * dt2 * dt / 2;
+    float p11 = s->p[1][1] + qa * dt2;
+
+    /* Update with the measured distance. */
+    float innovation = distance - s->x[0];
+    float gain_den = p00 + r * r;
+    float k0 = p00 / gain_den;
+    float k1 = p01 / gain_den;
+
+    s->x[0] += k0 * innovation;
+    s->x[1] += k1 * innovation;
+
+    s->p[0][0] = (1 - k0) * p00;
+    s->p[0][1] = (1 - k0) * p01;
+    s->p[1][0] = s->p[0][1];
+    s->p[1][1] = p11 - k1 * p01;
+
+    return s->x[0];
+}
+#endif
+
+float smoothing_update(const struct peer *p, float distance, enum dm_ranging_mode method,
+                       uint32_t now_ms) {
+    struct smooth_state *s = &state[peer_slot(p)];
+    bool first = !s->valid || s->addr_int != p->addr_int;
+
+    if (first) {
+        memset(s, 0, sizeof(*s));
+        s->addr_int = p->addr_int;
+        s->valid = true;
+    }
+
+#ifdef CONFIG_DM_SMOOTH_MEDIAN
+    distance = median_update(s, distance);
+#endif
+#ifdef CONFIG_DM_SMOOTH_EMA
+    distance = ema_update(s, distance, first);
+#endif
+#ifdef CONFIG_DM_SMOOTH_KALMAN
+    float r = (method == DM_RANGING_MODE_RTT ? CONFIG_DM_RTT_NOISE_CM
+                                             : CONFIG_DM_SMOOTH_KALMAN_NOISE_CM) / 100.0f;
+
+    distance = kalman_update(s, distance, r, now_ms, first);
+#endif
+
+    if (distance < 0) {
+        distance = 0;
+    }
+    return distance;
+}
@@ -0,0 +1,188 @@
+#include <stats.h>
+
+#include <zephyr/kernel.h>
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <ndt_adv.h>
+#include <ndt_stats.h>
+#include <method.h>
+#include <scan.h>
+#include <scheduler.h>
+#include <stream.h>
+#include <recording.h>
+
+#ifdef CONFIG_DISTANCE_DISPLAY_OLED
+#include <oled.h>
+#endif
+
+atomic_t stats_counters[STATS_COUNTER_COUNT];
+
+static struct ndt_quality quality;
+static struct ndt_hist callback_hist;
+static uint32_t since_ms;
+
+void stats_result(struct peer *p, enum dm_quality q, uint32_t callback_us) {
+    ndt_quality_add(&quality, q);
+    ndt_hist_add(&callback_hist, callback_us);
+
+    if (p == NULL) {
+        return;
+    }
+    /* A peer's rate is counted from its first result. */
+    if (atomic_inc(&p->stats_results) == 0) {
+        p->stats_since = k_uptime_get_32();
+    }
+    if (q == DM_QUALITY_OK) {
+        atomic_inc(&p->stats_ok);
+    }
+}
+
+static void peer_reset(struct peer *p, void *user_data) {
+    atomic_clear(&p->stats_results);
+    atomic_clear(&p->stats_ok);
+}
+
+void stats_reset(void) {
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        atomic_clear(&stats_counters[i]);
+    }
+    ndt_quality_reset(&quality);
+    ndt_hist_reset(&callback_hist);
+    peer_lock();
+    peer_foreach_active(peer_reset, NULL);
+    peer_unlock();
+    sched_reset_stats();
+    method_reset_stats();
+    since_ms = k_uptime_get_32();
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv) {
+    uint32_t now = k_uptime_get_32();
+    uint32_t rate = ndt_rate_centi(ndt_quality_total(&quality), since_ms, now);
+    struct sched_stats sched;
+    struct method_stats method;
+
+    sched_get_stats(&sched);
+    method_get_stats(&method);
+
+    shell_print(sh, "uptime %u s, counting for %u s", now / 1000, (now - since_ms) / 1000);
+    shell_print(sh, "results: %u.%02u per second", rate / 100, rate % 100);
+    ndt_quality_print(sh, &quality);
+    ndt_hist_print(sh, "callback", "us", &callback_hist);
+    shell_print(sh, "unpublished: %u, log drops: %u, zbus drops: %u",
+                (uint32_t)atomic_get(&stats_counters[STATS_UNPUBLISHED]),
+                (uint32_t)atomic_get(&stats_counters[STATS_REPORTS_DROPPED]),
+                (uint32_t)atomic_get(&stats_counters[STATS_PUBLISH_DROPPED]));
+    shell_print(sh, "scheduler: %u granted, %u not due, %u not turn, %u rate limited, %u rejected",
+                sched.granted, sched.not_due, sched.not_turn, sched.rate_limited, sched.rejected);
+    shell_print(sh, "method: %u MCPD, %u RTT, %u skipped", method.mcpd, method.rtt, method.skipped);
+    shell_print(sh, "peers: %u table full, %u filter queue full",
+                (uint32_t)atomic_get(&stats_counters[STATS_PEER_NO_MEM]),
+                (uint32_t)atomic_get(&stats_counters[STATS_FILTER_FULL]));
+    shell_print(sh, "scan: %u filter commits, paused %u ms since boot, %u errors",
+                scan_filter_commits(), (uint32_t)(scan_paused_time_us() / 1000),
+                (uint32_t)atomic_get(&stats_counters[STATS_SCAN_ERRORS]));
+#ifdef CONFIG_DM_STREAM
+    struct stream_stats stream;
+
+    stream_get_stats(&stream);
+    shell_print(sh, "stream: %u frames, %u dropped since boot", stream.frames, stream.dropped);
+#endif
+#ifdef CONFIG_DISTANCE_DISPLAY_OLED
+    struct display_stats display;
+
+    display_get_stats(&display);
+    shell_print(sh, "display: %u frames, %u pixels, %u wakeups, %u read retries since boot, %u us per frame",
+                display.frames, display.pixels, display.wakeups, display.read_retries,
+                display.frames ? (uint32_t)(display.handler_us / display.frames) : 0);
+#endif
+#ifdef CONFIG_DM_RECORD
+    struct record_stats rec;
+
+    record_get_stats(&rec);
+    shell_print(sh, "record: %u records, %u dropped since boot", rec.records, rec.dropped);
+#endif
+    return 0;
+}
+
+/* A copy of what "ndt peers" prints, taken under the peer lock so that
+ * the scan and DM callbacks do not wait for the shell.
+ */
+struct peer_row {
+    uint64_t addr_int;
+    uint8_t modes;
+    uint32_t results;
+    uint32_t ok;
+    uint32_t since;
+    uint32_t interval_ms;
+    uint8_t weight;
+    uint32_t last_seen;
+};
+
+struct peer_rows {
+    struct peer_row row[CONFIG_BT_SCAN_UUID_CNT];
+    size_t count;
+};
+
+static void peer_copy(struct peer *p, void *user_data) {
+    struct peer_rows *rows = user_data;
+
+    if (rows->count == ARRAY_SIZE(rows->row)) {
+        return;
+    }
+    rows->row[rows->count++] = (struct peer_row){
+        .addr_int = p->addr_int,
+        .modes = p->modes,
+        .results = atomic_get(&p->stats_results),
+        .ok = atomic_get(&p->stats_ok),
+        .since = p->stats_since,
+        .interval_ms = p->interval_ms,
+        .weight = sched_weight(p),
+        .last_seen = p->last_seen,
+    };
+}
+
+static int cmd_peers(const struct shell *sh, size_t argc, char **argv) {
+    static struct peer_rows rows;
+
+    peer_lock();
+    rows.count = 0;
+    peer_foreach_active(peer_copy, &rows);
+    peer_unlock();
+
+    uint32_t now = k_uptime_get_32();
+
+    for (size_t i = 0; i < rows.count; i++) {
+        const struct peer_row *r = &rows.row[i];
+        uint32_t rate = r->results ? ndt_rate_centi(r->results, r->since, now) : 0;
+        const char *modes = r->modes == (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT) ? "MCPD+RTT"
+                            : r->modes == NDT_ADV_MODE_MCPD                     ? "MCPD"
+                                                                                : "RTT";
+
+        shell_print(sh, "%012llx %-8s %u results, %u ok, %u.%02u/s, interval %u ms, weight %u, "
+                    "seen %u ms ago",
+                    r->addr_int, modes, r->results, r->ok, rate / 100, rate % 100, r->interval_ms,
+                    r->weight, now - r->last_seen);
+    }
+    return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv) {
+    stats_reset();
+    shell_print(sh, "Statistics cleared");
+    return 0;
+}
+
+/* Other modules add their own "ndt" subcommands with SHELL_SUBCMD_ADD((ndt), ...). */
+SHELL_SUBCMD_SET_CREATE(ndt_cmds, (ndt));
+
+SHELL_SUBCMD_ADD((ndt), stats, NULL, "Counters and latency since the last reset", cmd_stats, 1, 0);
+SHELL_SUBCMD_ADD((ndt), peers, NULL, "Measurement rate and quality per peer", cmd_peers, 1, 0);
+SHELL_SUBCMD_ADD((ndt), reset, NULL, "Clear the counters", cmd_reset, 1, 0);
+
+SHELL_CMD_REGISTER(ndt, &ndt_cmds, "Distance toolbox", NULL);
+#endif
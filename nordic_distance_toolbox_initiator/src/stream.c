@@ -0,0 +1,250 @@
+#include <stream.h>
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include <messages.h>
+
+LOG_MODULE_REGISTER(stream, LOG_LEVEL_INF);
+
+/* CONFIG_DM_STREAM depends on the chosen node, binary frames on the console
+ * or the shell would garble both.
+ */
+#define STREAM_UART DT_CHOSEN(ndt_stream_uart)
+
+#if DT_HAS_CHOSEN(zephyr_console)
+BUILD_ASSERT(!DT_SAME_NODE(STREAM_UART, DT_CHOSEN(zephyr_console)),
+             "ndt,stream-uart must not be the console UART");
+#endif
+#if DT_HAS_CHOSEN(zephyr_shell_uart)
+BUILD_ASSERT(!DT_SAME_NODE(STREAM_UART, DT_CHOSEN(zephyr_shell_uart)),
+             "ndt,stream-uart must not be the shell UART");
+#endif
+
+#define QUEUE_SIZE CONFIG_DM_STREAM_QUEUE_SIZE
+#define HEADER_LEN 3
+#define CRC_LEN 2
+#define FRAME_MAX (HEADER_LEN + STREAM_PAYLOAD_MAX + CRC_LEN)
+
+/* COBS adds one byte per 254 and the delimiter. */
+#define ENCODED_MAX (FRAME_MAX + FRAME_MAX / 254 + 2)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(QUEUE_SIZE), "Stream queue size must be a power of two");
+BUILD_ASSERT(sizeof(struct stream_measurement) <= STREAM_PAYLOAD_MAX, "Measurement frame too large");
+
+/* Bounded multi-producer queue. A producer claims a slot by advancing head
+ * and marks it ready once filled, the stream thread only takes slots in
+ * order and only once they are ready.
+ */
+struct stream_slot {
+    atomic_t ready;
+    uint8_t len;
+    uint8_t frame[HEADER_LEN + STREAM_PAYLOAD_MAX];
+};
+
+static struct stream_slot queue[QUEUE_SIZE];
+static atomic_t head;
+static atomic_t tail;
+static atomic_t sequence;
+static atomic_t frames;
+static atomic_t dropped;
+
+static K_SEM_DEFINE(stream_sem, 0, 1);
+
+static const struct device *const uart = DEVICE_DT_GET(STREAM_UART);
+
+/* Encoded bytes on their way to the UART. The stream thread puts whole
+ * frames or parts of them, the TX interrupt takes whatever the FIFO
+ * accepts and wakes the thread when there is room again.
+ */
+RING_BUF_DECLARE(stream_tx_ring, CONFIG_DM_STREAM_TX_BUF_SIZE);
+static struct k_spinlock tx_lock;
+static K_SEM_DEFINE(tx_sem, 0, 1);
+static bool tx_irq;
+
+int stream_put(enum stream_type type, const void *payload, size_t len) {
+    uint16_t seq = atomic_inc(&sequence);
+    atomic_val_t h;
+
+    if (len > STREAM_PAYLOAD_MAX) {
+        return -EINVAL;
+    }
+
+    do {
+        h = atomic_get(&head);
+        if ((uint32_t)(h - atomic_get(&tail)) >= QUEUE_SIZE) {
+            atomic_inc(&dropped);
+            return -ENOBUFS;
+        }
+    } while (!atomic_cas(&head, h, h + 1));
+
+    struct stream_slot *slot = &queue[h & (QUEUE_SIZE - 1)];
+
+    slot->frame[0] = type;
+    sys_put_le16(seq, &slot->frame[1]);
+    memcpy(&slot->frame[HEADER_LEN], payload, len);
+    slot->len = HEADER_LEN + len;
+    atomic_set(&slot->ready, 1);
+
+    k_sem_give(&stream_sem);
+    return 0;
+}
+
+void stream_measurement(const struct dm_result *result, const struct dm_data *data, bool published) {
+    struct stream_measurement m = {
+        .timestamp_ms = data->timestamp,
+        .peer_id = data->peer_id,
+        .method = result->ranging_mode,
+        .quality = result->quality,
+        .flags = published ? STREAM_FLAG_PUBLISHED : 0,
+        .distance = published ? data->distance : 0,
+        .confidence = published ? data->confidence : 0,
+    };
+
+    if (result->ranging_mode == DM_RANGING_MODE_MCPD) {
+        m.mcpd_ifft = result->dist_estimates.mcpd.ifft;
+        m.mcpd_phase_slope = result->dist_estimates.mcpd.phase_slope;
+        m.mcpd_rssi_openspace = result->dist_estimates.mcpd.rssi_openspace;
+        m.mcpd_best = result->dist_estimates.mcpd.best;
+    }
+    else {
+        m.rtt = result->dist_estimates.rtt.rtt;
+    }
+
+    (void)stream_put(STREAM_TYPE_MEASUREMENT, &m, sizeof(m));
+}
+
+void stream_get_stats(struct stream_stats *stats) {
+    stats->frames = atomic_get(&frames);
+    stats->dropped = atomic_get(&dropped);
+}
+
+/* Take the oldest frame if it is ready. */
+static bool queue_get(uint8_t *frame, size_t *len) {
+    atomic_val_t t = atomic_get(&tail);
+    struct stream_slot *slot = &queue[t & (QUEUE_SIZE - 1)];
+
+    if (t == atomic_get(&head) || !atomic_get(&slot->ready)) {
+        return false;
+    }
+
+    *len = slot->len;
+    memcpy(frame, slot->frame, slot->len);
+    atomic_clear(&slot->ready);
+    atomic_set(&tail, t + 1);
+    return true;
+}
+
+/* COBS encode len bytes of in, followed by the zero delimiter. Returns the
+ * encoded length.
+ */
+static size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_at = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_at] = code;
+            code_at = o++;
+            code = 1;
+        }
+    }
+    out[code_at] = code;
+    out[o++] = 0;
+    return o;
+}
+
+#ifdef CONFIG_UART_INTERRUPT_DRIVEN
+static void uart_isr(const struct device *dev, void *user_data) {
+    uint8_t *data;
+
+    if (!uart_irq_update(dev) || !uart_irq_tx_ready(dev)) {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&tx_lock);
+    uint32_t len = ring_buf_get_claim(&stream_tx_ring, &data, CONFIG_DM_STREAM_TX_BUF_SIZE);
+
+    if (len == 0) {
+        uart_irq_tx_disable(dev);
+    }
+    else {
+        int sent = uart_fifo_fill(dev, data, len);
+
+        ring_buf_get_finish(&stream_tx_ring, MAX(sent, 0));
+    }
+    k_spin_unlock(&tx_lock, key);
+
+    k_sem_give(&tx_sem);
+}
+#endif
+
+static void uart_write(const uint8_t *data, size_t len) {
+    if (!tx_irq) {
+        for (size_t i = 0; i < len; i++) {
+            uart_poll_out(uart, data[i]);
+        }
+        return;
+    }
+
+    while (len > 0) {
+        k_spinlock_key_t key = k_spin_lock(&tx_lock);
+        uint32_t put = ring_buf_put(&stream_tx_ring, data, len);
+
+        k_spin_unlock(&tx_lock, key);
+        data += put;
+        len -= put;
+
+        uart_irq_tx_enable(uart);
+        if (len > 0) {
+            k_sem_take(&tx_sem, K_FOREVER);
+        }
+    }
+}
+
+static void stream_thread(void *p1, void *p2, void *p3) {
+    uint8_t frame[FRAME_MAX];
+    uint8_t encoded[ENCODED_MAX];
+    size_t len;
+
+    if (!device_is_ready(uart)) {
+        LOG_ERR("Stream UART not ready");
+        return;
+    }
+
+#ifdef CONFIG_UART_INTERRUPT_DRIVEN
+    tx_irq = uart_irq_callback_user_data_set(uart, uart_isr, NULL) == 0;
+#endif
+    if (!tx_irq) {
+        LOG_INF("Stream UART has no TX interrupt, polling");
+    }
+
+    while (true) {
+        k_sem_take(&stream_sem, K_FOREVER);
+
+        while (queue_get(frame, &len)) {
+            sys_put_le16(crc16_itu_t(0xFFFF, frame, len), &frame[len]);
+
+            size_t n = cobs_encode(frame, len + CRC_LEN, encoded);
+
+            uart_write(encoded, n);
+            atomic_inc(&frames);
+        }
+    }
+}
+
+K_THREAD_DEFINE(stream_id, 1024, stream_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
@@ -0,0 +1,144 @@
+#include <trace.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+#include <zephyr/timing/timing.h>
+#endif
+
+#define RING_SIZE CONFIG_DM_TRACE_RING_SIZE
+#define NUM_CPUS CONFIG_MP_MAX_NUM_CPUS
+
+/* Events per console line. */
+#define DUMP_CHUNK 8
+
+BUILD_ASSERT(IS_POWER_OF_TWO(RING_SIZE), "Trace ring size must be a power of two");
+BUILD_ASSERT(sizeof(struct trace_event) == 12, "Trace event layout changed");
+
+struct trace_ring {
+    struct k_spinlock lock;
+    struct trace_event events[RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+};
+
+static struct trace_ring rings[NUM_CPUS];
+
+static inline uint32_t trace_cycles(void) {
+#ifdef CONFIG_TIMING_FUNCTIONS
+    return (uint32_t)timing_counter_get();
+#else
+    return k_cycle_get_32();
+#endif
+}
+
+static inline uint32_t trace_hz(void) {
+#ifdef CONFIG_TIMING_FUNCTIONS
+    return (uint32_t)timing_freq_get();
+#else
+    return sys_clock_hw_cycles_per_sec();
+#endif
+}
+
+static inline int curr_cpu(void) {
+#ifdef CONFIG_SMP
+    return arch_curr_cpu()->id;
+#else
+    return 0;
+#endif
+}
+
+void trace_record(enum trace_stage stage, uint64_t peer_id, uint16_t arg) {
+    struct trace_ring *r;
+    k_spinlock_key_t key;
+    int cpu;
+
+    /* The spinlock keeps the thread on its CPU, so the id read under it
+     * holds until the unlock. A migration between the first read and the
+     * lock only costs a retry.
+     */
+    while (true) {
+        r = &rings[curr_cpu()];
+        key = k_spin_lock(&r->lock);
+        cpu = curr_cpu();
+        if (r == &rings[cpu]) {
+            break;
+        }
+        k_spin_unlock(&r->lock, key);
+    }
+
+    struct trace_event *e = &r->events[r->head & (RING_SIZE - 1)];
+
+    e->cycles = trace_cycles();
+    e->key = (uint32_t)peer_id;
+    e->stage = stage;
+    e->cpu = cpu;
+    e->arg = arg;
+    r->head++;
+
+    k_spin_unlock(&r->lock, key);
+}
+
+/* Copy out up to max of the oldest events, newer ones overwrite the oldest
+ * if the dump falls behind. The count of overwritten events is read with
+ * them.
+ */
+static int ring_read(struct trace_ring *r, struct trace_event *out, int max, uint32_t *dropped) {
+    k_spinlock_key_t key = k_spin_lock(&r->lock);
+    uint32_t count = r->head - r->tail;
+    int n;
+
+    if (count > RING_SIZE) {
+        r->dropped += count - RING_SIZE;
+        r->tail = r->head - RING_SIZE;
+    }
+    for (n = 0; n < max && r->tail != r->head; n++) {
+        out[n] = r->events[r->tail++ & (RING_SIZE - 1)];
+    }
+    *dropped = r->dropped;
+    k_spin_unlock(&r->lock, key);
+
+    return n;
+}
+
+/* The console is slow, so the dump runs in its own thread below every
+ * other one rather than holding up the system workqueue.
+ */
+static void dump_thread(void *p1, void *p2, void *p3) {
+    struct trace_event events[DUMP_CHUNK];
+    char hex[sizeof(events) * 2 + 1];
+
+    while (true) {
+        k_msleep(CONFIG_DM_TRACE_DUMP_MS);
+
+        for (int cpu = 0; cpu < NUM_CPUS; cpu++) {
+            struct trace_ring *r = &rings[cpu];
+            bool header = false;
+            uint32_t dropped;
+            int n;
+
+            while ((n = ring_read(r, events, DUMP_CHUNK, &dropped)) > 0) {
+                if (!header) {
+                    printk("trace: hz %u cpu %d dropped %u\n", trace_hz(), cpu, dropped);
+                    header = true;
+                }
+                bin2hex((const uint8_t *)events, n * sizeof(events[0]), hex, sizeof(hex));
+                printk("trace: %s\n", hex);
+            }
+        }
+    }
+}
+
+K_THREAD_DEFINE(trace_dump_id, 1024, dump_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO, 0, SYS_FOREVER_MS);
+
+void trace_init(void) {
+#ifdef CONFIG_TIMING_FUNCTIONS
+    timing_init();
+    timing_start();
+#endif
+    k_thread_start(trace_dump_id);
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <peer.h>
+#include <scheduler.h>
+#include <sim.h>
+
+/* The distance from the simulated initiator to every reflector of the
+ * scenario is measured whenever the peer's ranging interval has passed,
+ * with the simulation's MCPD noise. Between measurements the last one
+ * stands in for the distance, and the tracking error is its difference
+ * from the true distance, sampled every STEP_MS. The adaptive interval is
+ * compared with fixed ones, the same noise samples for each.
+ */
+
+#define STEP_MS 10
+#define NOISE_M (CONFIG_DM_SIM_MCPD_NOISE_CM / 100.0f)
+
+/* Not under test, only the interval is. */
+int dm_request_add(struct dm_request *req) {
+    return 0;
+}
+
+struct trace_result {
+    uint32_t measurements;
+    float rms_error;
+    float max_error;
+};
+
+/* fixed_ms 0 for the adaptive interval. */
+static void replay(const struct sim_node *self, const struct sim_node *refl, uint32_t fixed_ms,
+                   struct trace_result *r) {
+    struct peer p = {.interval_ms = fixed_ms ? fixed_ms : CONFIG_DM_PEER_DELAY_MS};
+    uint32_t next = 0;
+    float held = 0;
+    float sq_error = 0;
+    int samples = 0;
+
+    memset(r, 0, sizeof(*r));
+    for (uint32_t t = 0; t < sim_duration_ms(); t += STEP_MS) {
+        float d = sim_distance(self, refl, t);
+
+        if (!sim_in_range(self, refl, t)) {
+            continue;
+        }
+        if (t >= next) {
+            held = d + NOISE_M * sim_gauss();
+            r->measurements++;
+            if (!fixed_ms) {
+                sched_report_distance(&p, held);
+            }
+            next = t + p.interval_ms;
+        }
+
+        float error = fabsf(held - d);
+
+        sq_error += error * error;
+        r->max_error = MAX(r->max_error, error);
+        samples++;
+    }
+    r->rms_error = samples ? sqrtf(sq_error / samples) : 0;
+}
+
+struct policy {
+    const char *name;
+    uint32_t fixed_ms;
+    struct trace_result total;
+    float sq_error;
+};
+
+ZTEST(adaptive_rate, test_traces) {
+    static struct policy policies[] = {
+        {"adaptive", 0},
+        {"fixed min", CONFIG_DM_PEER_INTERVAL_MIN_MS},
+        {"fixed default", CONFIG_DM_PEER_DELAY_MS},
+        {"fixed max", CONFIG_DM_PEER_INTERVAL_MAX_MS},
+    };
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+    int traces = 0;
+
+    zassert_not_null(self);
+    for (int i = 0; i < sim_node_count(); i++) {
+        const struct sim_node *refl = sim_node_get(i);
+
+        if (refl->role != SIM_ROLE_REFLECTOR) {
+            continue;
+        }
+        traces++;
+        for (int j = 0; j < ARRAY_SIZE(policies); j++) {
+            struct trace_result r;
+
+            replay(self, refl, policies[j].fixed_ms, &r);
+            TC_PRINT("%s to %s, %s: %u measurements, rms error %d cm, max %d cm\n", self->name,
+                     refl->name, policies[j].name, r.measurements, (int)(r.rms_error * 100),
+                     (int)(r.max_error * 100));
+            policies[j].total.measurements += r.measurements;
+            policies[j].total.max_error = MAX(policies[j].total.max_error, r.max_error);
+            policies[j].sq_error += r.rms_error * r.rms_error;
+        }
+    }
+    zassert_true(traces > 0, "scenario has no reflector");
+
+    for (int j = 0; j < ARRAY_SIZE(policies); j++) {
+        struct policy *pol = &policies[j];
+
+        pol->total.rms_error = sqrtf(pol->sq_error / traces);
+        TC_PRINT("%s: %u measurements, rms error %d cm, max %d cm\n", pol->name,
+                 pol->total.measurements, (int)(pol->total.rms_error * 100),
+                 (int)(pol->total.max_error * 100));
+    }
+
+    struct trace_result *adaptive = &policies[0].total;
+    struct trace_result *fast = &policies[1].total;
+    struct trace_result *slow = &policies[3].total;
+
+    /* Fewer measurements than always ranging at the fastest rate, and
+     * better tracking than always ranging at the slowest. Where it lands
+     * against the default fixed interval depends on how much of the trace
+     * is spent moving, see the printed numbers.
+     */
+    zassert_true(adaptive->measurements < fast->measurements, "%u measurements",
+                 adaptive->measurements);
+    zassert_true(adaptive->rms_error < slow->rms_error, "rms error %d cm",
+                 (int)(adaptive->rms_error * 100));
+}
+
+ZTEST_SUITE(adaptive_rate, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,177 @@
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <calib.h>
+#include <peer.h>
+
+/* The least squares fit on exact points, then whole calibration sessions
+ * fed with raw distances that follow raw = scale * true + offset plus
+ * noise and multipath outliers, as the simulation produces them. After
+ * sessions at a few reference distances the corrected distance is scored
+ * against the true one from 0.5 m to 5 m, and against the Kconfig offsets
+ * alone.
+ */
+
+#define MCPD_SCALE 1.05f
+#define MCPD_OFFSET_M 1.28f
+#define MCPD_NOISE_M 0.15f
+#define RTT_SCALE 1.0f
+#define RTT_OFFSET_M -5.5f
+#define RTT_NOISE_M 1.0f
+#define OUTLIER_PERMILLE 100
+#define OUTLIER_M 3.0f
+#define MIN_SPREAD_M (CONFIG_DM_CALIB_MIN_SPREAD_CM / 100.0f)
+
+static struct peer peer = {.addr_int = 0xD00000000001ULL};
+static struct peer other = {.addr_int = 0xD00000000002ULL};
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static float gauss(void) {
+    float u1 = (rand32() + 1.0f) / 4294967296.0f;
+    float u2 = rand32() / 4294967296.0f;
+
+    return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * 3.14159265f * u2);
+}
+
+static float raw_distance(enum dm_ranging_mode method, float d) {
+    bool mcpd = method == DM_RANGING_MODE_MCPD;
+    float raw = mcpd ? MCPD_SCALE * d + MCPD_OFFSET_M + MCPD_NOISE_M * gauss()
+                     : RTT_SCALE * d + RTT_OFFSET_M + RTT_NOISE_M * gauss();
+
+    if (rand32() % 1000 < OUTLIER_PERMILLE) {
+        raw += OUTLIER_M * (rand32() % 1000) / 1000.0f;
+    }
+    return raw;
+}
+
+/* The session ends as soon as one method has all its samples. */
+static void session(float reference_m) {
+    zassert_ok(calib_start(peer.addr_int, reference_m));
+    zassert_equal(calib_start(0, reference_m), -EBUSY);
+    for (int i = 0; i < CONFIG_DM_CALIB_SAMPLES; i++) {
+        calib_sample(&other, DM_RANGING_MODE_MCPD, 0);
+        calib_sample(&peer, DM_RANGING_MODE_MCPD, raw_distance(DM_RANGING_MODE_MCPD, reference_m));
+        calib_sample(&peer, DM_RANGING_MODE_RTT, raw_distance(DM_RANGING_MODE_RTT, reference_m));
+    }
+    for (int i = 0; i < 100 && calib_running(); i++) {
+        k_sleep(K_MSEC(1));
+    }
+    zassert_false(calib_running(), "session did not finish");
+}
+
+/* Corrected against true distance over 0.5 m to 5 m, without noise. */
+static int model_rms_cm(const struct peer *p, enum dm_ranging_mode method) {
+    bool mcpd = method == DM_RANGING_MODE_MCPD;
+    float sq = 0;
+    int n = 0;
+
+    for (float d = 0.5f; d <= 5.0f; d += 0.1f, n++) {
+        float raw = mcpd ? MCPD_SCALE * d + MCPD_OFFSET_M : RTT_SCALE * d + RTT_OFFSET_M;
+        float error = calib_apply(p, method, raw) - d;
+
+        sq += error * error;
+    }
+    return (int)(sqrtf(sq / n) * 100);
+}
+
+static void *setup(void) {
+    zassert_ok(calib_init());
+    return NULL;
+}
+
+static void reset(void *fixture) {
+    zassert_ok(calib_reset());
+}
+
+ZTEST(calib, test_fit_exact) {
+    struct calib_fit fit = {0};
+    float scale, offset;
+
+    zassert_equal(calib_fit_solve(&fit, &scale, &offset), -ENODATA);
+
+    /* One point only gives the offset. */
+    calib_fit_add(&fit, 1.0f, 2.5f);
+    zassert_ok(calib_fit_solve(&fit, &scale, &offset));
+    zassert_within(scale, 1.0f, 1e-6f);
+    zassert_within(offset, 1.5f, 1e-5f);
+
+    for (float d = 2.0f; d <= 5.0f; d += 1.0f) {
+        calib_fit_add(&fit, d, 1.1f * d + 1.4f);
+    }
+    zassert_ok(calib_fit_solve(&fit, &scale, &offset));
+    zassert_within(scale, 1.1f, 1e-4f);
+    zassert_within(offset, 1.4f, 1e-3f);
+}
+
+ZTEST(calib, test_fit_fallback) {
+    struct calib_fit fit = {0};
+    float scale, offset;
+
+    /* Too close together for a scale. */
+    calib_fit_add(&fit, 1.0f, 2.0f);
+    calib_fit_add(&fit, 1.0f + MIN_SPREAD_M, 2.0f + 2 * MIN_SPREAD_M);
+    zassert_ok(calib_fit_solve(&fit, &scale, &offset));
+    zassert_within(scale, 1.0f, 1e-6f);
+    zassert_within(offset, 1.0f + MIN_SPREAD_M / 2, 1e-5f);
+
+    /* Far enough apart, but not a plausible scale. */
+    memset(&fit, 0, sizeof(fit));
+    calib_fit_add(&fit, 1.0f, 1.0f);
+    calib_fit_add(&fit, 3.0f, 9.0f);
+    zassert_ok(calib_fit_solve(&fit, &scale, &offset));
+    zassert_within(scale, 1.0f, 1e-6f);
+    zassert_within(offset, 3.0f, 1e-5f);
+}
+
+ZTEST(calib, test_sessions) {
+    static const float references[] = {1.0f, 2.0f, 3.0f};
+    int mcpd_before = model_rms_cm(&peer, DM_RANGING_MODE_MCPD);
+    int rtt_before = model_rms_cm(&peer, DM_RANGING_MODE_RTT);
+
+    for (int i = 0; i < ARRAY_SIZE(references); i++) {
+        session(references[i]);
+
+        TC_PRINT("after %d cm: MCPD rms %d cm, RTT rms %d cm, other peer MCPD rms %d cm\n",
+                 (int)(references[i] * 100), model_rms_cm(&peer, DM_RANGING_MODE_MCPD),
+                 model_rms_cm(&peer, DM_RANGING_MODE_RTT),
+                 model_rms_cm(&other, DM_RANGING_MODE_MCPD));
+    }
+
+    int mcpd_after = model_rms_cm(&peer, DM_RANGING_MODE_MCPD);
+    int rtt_after = model_rms_cm(&peer, DM_RANGING_MODE_RTT);
+
+    TC_PRINT("uncalibrated: MCPD rms %d cm, RTT rms %d cm\n", mcpd_before, rtt_before);
+    zassert_true(mcpd_after < 10, "MCPD rms %d cm", mcpd_after);
+    zassert_true(rtt_after < rtt_before, "RTT rms %d cm", rtt_after);
+
+    /* The board fit covers peers without one of their own. */
+    zassert_true(model_rms_cm(&other, DM_RANGING_MODE_MCPD) < 10);
+
+    zassert_ok(calib_reset());
+    zassert_equal(model_rms_cm(&peer, DM_RANGING_MODE_MCPD), mcpd_before);
+}
+
+ZTEST(calib, test_too_few_samples) {
+    float before = calib_apply(&peer, DM_RANGING_MODE_MCPD, 2.0f);
+
+    zassert_ok(calib_start(peer.addr_int, 1.0f));
+    calib_sample(&peer, DM_RANGING_MODE_MCPD, 5.0f);
+    zassert_true(calib_running());
+
+    /* Ends at the timeout without a fit. */
+    k_sleep(K_MSEC(CONFIG_DM_CALIB_TIMEOUT_MS + 100));
+    zassert_false(calib_running());
+    zassert_within(calib_apply(&peer, DM_RANGING_MODE_MCPD, 2.0f), before, 1e-6f);
+}
+
+ZTEST_SUITE(calib, NULL, setup, reset, NULL, NULL);
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/sys/hash_function.h>
+
+#include <color.h>
+#include <color_table.h>
+
+/* The generated table against the runtime HSL code it replaced, for every
+ * hue at the configured saturation and luminance. The reference below is
+ * the original color.c, unchanged apart from taking the hue as an int.
+ */
+
+static float hue_to_rgb(float temp1, float temp2, float hue) {
+    if (hue < 0) hue += 1;
+    if (hue > 1) hue -= 1;
+    if (hue < 1.0 / 6.0) return temp1 + (temp2 - temp1) * 6 * hue;
+    if (hue < 0.5) return temp2;
+    if (hue < 2.0 / 3.0) return temp1 + (temp2 - temp1) * (2.0 / 3.0 - hue) * 6;
+    return temp1;
+}
+
+static uint32_t hsl_to_rgba(float h, float s, float l) {
+    float r, g, b;
+    float temp1, temp2;
+
+    if (s == 0) {
+        r = g = b = l;
+    } else {
+        temp2 = (l < 0.5) ? (l * (1 + s)) : ((l + s) - (s * l));
+        temp1 = 2 * l - temp2;
+
+        r = hue_to_rgb(temp1, temp2, h / 360.0 + 1.0 / 3.0);
+        g = hue_to_rgb(temp1, temp2, h / 360.0);
+        b = hue_to_rgb(temp1, temp2, h / 360.0 - 1.0 / 3.0);
+    }
+
+    uint32_t rgba = ((uint32_t)(r * 255) << 24) | ((uint32_t)(g * 255) << 16) | ((uint32_t)(b * 255) << 8) | 0xFF;
+    return rgba;
+}
+
+static uint32_t reference(int hue) {
+    float saturation = CONFIG_INDICATOR_LED_SATURATION/100.0;
+    float luminance = CONFIG_INDICATOR_LED_LUMINANCE/100.0;
+
+    return hsl_to_rgba(hue * 1.0, saturation, luminance);
+}
+
+ZTEST(color_table, test_every_hue) {
+    int mismatches = 0;
+
+    zassert_equal(COLOR_TABLE_SIZE, 360);
+    for (int hue = 0; hue < COLOR_TABLE_SIZE; hue++) {
+        if (color_table[hue] != reference(hue)) {
+            TC_PRINT("hue %d: table %08x, runtime %08x\n", hue, color_table[hue], reference(hue));
+            mismatches++;
+        }
+    }
+    zassert_equal(mismatches, 0, "%d of %d hues differ", mismatches, COLOR_TABLE_SIZE);
+}
+
+ZTEST(color_table, test_addr_to_color) {
+    /* Addresses as bt_addr_le_to_str() prints them, hashed without the type
+     * suffix, as both apps do.
+     */
+    for (int i = 0; i < 100; i++) {
+        char addr[BT_ADDR_LE_STR_LEN];
+
+        snprintf(addr, sizeof(addr), "D0:00:00:00:00:%02X (random)", i);
+
+        uint32_t hash = sys_hash32_murmur3(addr, BT_ADDR_STR_LEN - 1);
+
+        zassert_equal(addr_to_color(addr, BT_ADDR_STR_LEN - 1), reference(hash % 360), "%s",
+                      addr);
+    }
+}
+
+ZTEST_SUITE(color_table, NULL, NULL, NULL, NULL, NULL);
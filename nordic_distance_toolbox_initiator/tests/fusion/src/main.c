@@ -0,0 +1,199 @@
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <fusion.h>
+#include <peer.h>
+#include <recording.h>
+#include <sim.h>
+
+#include <sim_replay.h>
+
+/* The MCPD results of the bundled recording go through fusion_update() in
+ * order, one peer state per reflector, and both the fused distance and
+ * the best estimate alone are scored against the scenario's true distance
+ * at the time of the result. The sim's MCPD offset is taken off first, as
+ * calibration would.
+ */
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define BIAS_M (CONFIG_DM_SIM_MCPD_BIAS_CM / 100.0f)
+
+static struct peer peers[NUM_PEERS];
+
+/* peer.c is not built, the test keeps its own table. */
+int peer_slot(const struct peer *p) {
+    return p - peers;
+}
+
+uint64_t bt_addr_to_int(const bt_addr_le_t *addr) {
+    uint64_t addr_int = 0;
+
+    for (int i = 0; i < BT_ADDR_SIZE; i++) {
+        addr_int = (addr_int << 8) + addr->a.val[i];
+    }
+    return addr_int;
+}
+
+struct score {
+    uint32_t results;
+    uint32_t rejected;
+    float best_sq;
+    float fused_sq;
+    float confidence;
+};
+
+static int rms_cm(float sq, uint32_t n) {
+    return n ? (int)(sqrtf(sq / n) * 100) : 0;
+}
+
+static void replay(struct score *scores, struct score *total, uint64_t *update_us) {
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+    struct recording_record rec;
+    size_t pos = 0;
+    uint32_t start_ms = 0;
+
+    zassert_not_null(self);
+    memset(peers, 0, sizeof(peers));
+    *update_us = 0;
+
+    while (recording_next(sim_replay, sizeof(sim_replay), &pos, &rec) == 0) {
+        struct dm_result result;
+
+        if (rec.type == RECORDING_START) {
+            start_ms = rec.time_ms;
+            continue;
+        }
+        if (rec.type != RECORDING_RESULT) {
+            continue;
+        }
+        zassert_ok(recording_decode_result(&rec, &result));
+        if (result.ranging_mode != DM_RANGING_MODE_MCPD) {
+            continue;
+        }
+
+        const struct sim_node *node = sim_node_find(&result.bt_addr);
+
+        zassert_not_null(node, "result from a reflector the scenario does not have");
+
+        int i = node - sim_node_get(0);
+        struct peer *p = &peers[i];
+        struct score *s = &scores[i];
+        float distance, confidence;
+
+        p->addr_int = bt_addr_to_int(&result.bt_addr);
+
+        uint64_t start = sim_host_time_us();
+        int err = fusion_update(p, &result, &distance, &confidence);
+
+        *update_us += sim_host_time_us() - start;
+        s->results++;
+        if (err) {
+            zassert_true(result.quality >= DM_QUALITY_DO_NOT_USE, "usable result rejected");
+            s->rejected++;
+            continue;
+        }
+        zassert_true(result.quality < DM_QUALITY_DO_NOT_USE, "unusable result published");
+        zassert_true(confidence > 0 && confidence <= 1);
+
+        float truth = sim_distance(self, node, rec.time_ms - start_ms) + BIAS_M;
+        float best = result.dist_estimates.mcpd.best - truth;
+        float fused = distance - truth;
+
+        s->best_sq += best * best;
+        s->fused_sq += fused * fused;
+        s->confidence += confidence;
+    }
+
+    memset(total, 0, sizeof(*total));
+    for (int i = 0; i < sim_node_count(); i++) {
+        total->results += scores[i].results;
+        total->rejected += scores[i].rejected;
+        total->best_sq += scores[i].best_sq;
+        total->fused_sq += scores[i].fused_sq;
+        total->confidence += scores[i].confidence;
+    }
+}
+
+ZTEST(fusion, test_reject) {
+    struct dm_result result = {
+        .status = true,
+        .ranging_mode = DM_RANGING_MODE_MCPD,
+        .dist_estimates.mcpd = {.ifft = 2, .phase_slope = 2, .rssi_openspace = 2, .best = 2},
+    };
+    float distance, confidence;
+
+    result.quality = DM_QUALITY_OK;
+    zassert_ok(fusion_update(NULL, &result, &distance, &confidence));
+    zassert_within(distance, 2, 0.01f);
+
+    result.quality = DM_QUALITY_DO_NOT_USE;
+    zassert_equal(fusion_update(NULL, &result, &distance, &confidence), -EINVAL);
+
+    result.quality = DM_QUALITY_CRC_FAIL;
+    zassert_equal(fusion_update(NULL, &result, &distance, &confidence), -EINVAL);
+}
+
+ZTEST(fusion, test_weights) {
+    struct dm_result result = {
+        .status = true,
+        .ranging_mode = DM_RANGING_MODE_MCPD,
+        .quality = DM_QUALITY_OK,
+        .dist_estimates.mcpd = {.ifft = 2, .phase_slope = 2, .rssi_openspace = 2, .best = 5},
+    };
+    float distance, confidence, poor_confidence;
+
+    float expected = IS_ENABLED(CONFIG_DM_FUSION) ? 2 : 5;
+
+    /* best repeats one of the others, fusion leaves it out. */
+    zassert_ok(fusion_update(NULL, &result, &distance, &confidence));
+    zassert_within(distance, expected, 0.01f);
+
+    /* A poor result lands at the same distance with less confidence. */
+    result.quality = DM_QUALITY_POOR;
+    zassert_ok(fusion_update(NULL, &result, &distance, &poor_confidence));
+    zassert_within(distance, expected, 0.01f);
+    zassert_true(poor_confidence < confidence);
+}
+
+ZTEST(fusion, test_replay) {
+    static struct score scores[NUM_PEERS];
+    struct score total;
+    uint64_t update_us;
+
+    zassert_true(sim_node_count() <= NUM_PEERS);
+    memset(scores, 0, sizeof(scores));
+    replay(scores, &total, &update_us);
+
+    for (int i = 0; i < sim_node_count(); i++) {
+        struct score *s = &scores[i];
+        uint32_t used = s->results - s->rejected;
+
+        if (s->results == 0) {
+            continue;
+        }
+        TC_PRINT("%s: %u results, %u rejected, best rms %d cm, fused rms %d cm, "
+                 "confidence %d%%\n", sim_node_get(i)->name, s->results, s->rejected,
+                 rms_cm(s->best_sq, used), rms_cm(s->fused_sq, used),
+                 used ? (int)(s->confidence * 100 / used) : 0);
+    }
+
+    uint32_t used = total.results - total.rejected;
+    int best = rms_cm(total.best_sq, used);
+    int fused = rms_cm(total.fused_sq, used);
+
+    zassert_true(used > 0, "recording has no MCPD results");
+    TC_PRINT("all: %u results, %u rejected, best rms %d cm, fused rms %d cm, %u ns per update\n",
+             total.results, total.rejected, best, fused,
+             (uint32_t)(update_us * 1000 / total.results));
+
+    if (IS_ENABLED(CONFIG_DM_FUSION)) {
+        zassert_true(total.fused_sq < total.best_sq, "fused rms %d cm, best %d cm", fused, best);
+    }
+    else {
+        zassert_equal(fused, best);
+    }
+}
+
+ZTEST_SUITE(fusion, NULL, NULL, NULL, NULL, NULL);
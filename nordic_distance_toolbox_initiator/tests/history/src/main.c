@@ -0,0 +1,171 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <history.h>
+#include <peer.h>
+
+/* Snapshots taken while the DM callback keeps pushing and the peer table
+ * slot keeps changing hands. A sample carries its owner in distance and a
+ * per-owner sequence number in timestamp, so a snapshot is good only if
+ * every sample is the requested peer's and the numbers run without a gap.
+ * On native_sim the threads only switch where they yield, on qemu_x86_64
+ * they run on two CPUs at once.
+ */
+
+#define HISTORY_LEN CONFIG_DM_HISTORY_LEN
+#define ADDR_A 0xD00000000001ULL
+#define ADDR_B 0xD00000000002ULL
+#define PUSHES 1000000
+#define HANDOVER_EVERY 5000
+#define YIELD_EVERY 64
+#define STACK_SIZE 2048
+#define PRIO K_PRIO_PREEMPT(1)
+
+static struct peer peer;
+
+/* peer.c is not built, there is only the one peer in slot 0. */
+int peer_slot(const struct peer *p) {
+    return 0;
+}
+
+static float owner_tag(uint64_t addr_int) {
+    return addr_int == ADDR_A ? 1.0f : 2.0f;
+}
+
+static void push(uint32_t seq) {
+    struct dm_sample sample = {
+        .timestamp = seq,
+        .distance = owner_tag(peer.addr_int),
+        .confidence = 1.0f,
+    };
+
+    history_push(&peer, &sample);
+}
+
+static bool consistent(uint64_t addr_int, const struct dm_sample *s, int count) {
+    for (int i = 0; i < count; i++) {
+        if (s[i].distance != owner_tag(addr_int)) {
+            return false;
+        }
+        if (i > 0 && s[i].timestamp != s[i - 1].timestamp + 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Hand the ring to a peer no test uses. */
+static void release(void *fixture) {
+    peer.addr_int = 0;
+    push(0);
+}
+
+ZTEST(history, test_order) {
+    struct dm_sample out[HISTORY_LEN];
+
+    peer.addr_int = ADDR_A;
+    for (int i = 0; i < 3 * HISTORY_LEN + 5; i++) {
+        push(i);
+    }
+
+    int count = history_snapshot(ADDR_A, out, ARRAY_SIZE(out));
+
+    /* The oldest slot is the one the next push overwrites, it is left out. */
+    zassert_equal(count, HISTORY_LEN - 1);
+    zassert_true(consistent(ADDR_A, out, count));
+    zassert_equal(out[count - 1].timestamp, 3 * HISTORY_LEN + 4);
+
+    zassert_equal(history_snapshot(ADDR_A, out, 3), 3);
+    zassert_equal(out[0].timestamp, 3 * HISTORY_LEN + 2);
+}
+
+ZTEST(history, test_handover) {
+    struct dm_sample out[HISTORY_LEN];
+
+    peer.addr_int = ADDR_A;
+    for (int i = 0; i < HISTORY_LEN; i++) {
+        push(i);
+    }
+    peer.addr_int = ADDR_B;
+    push(0);
+
+    zassert_equal(history_snapshot(ADDR_A, out, ARRAY_SIZE(out)), -ENOENT);
+    zassert_equal(history_snapshot(ADDR_B, out, ARRAY_SIZE(out)), 1);
+    zassert_equal(out[0].distance, owner_tag(ADDR_B));
+}
+
+static atomic_t done;
+
+static struct {
+    uint32_t snapshots;
+    uint32_t samples;
+    uint32_t busy;
+    uint32_t missing;
+    uint32_t bad;
+} reads;
+
+static void producer(void *p1, void *p2, void *p3) {
+    uint32_t seq = 0;
+
+    for (int i = 0; i < PUSHES; i++) {
+        if (i % HANDOVER_EVERY == 0) {
+            peer.addr_int = peer.addr_int == ADDR_A ? ADDR_B : ADDR_A;
+            seq = 0;
+        }
+        push(seq++);
+        if (i % YIELD_EVERY == 0) {
+            k_yield();
+        }
+    }
+    atomic_set(&done, 1);
+}
+
+static void reader(void *p1, void *p2, void *p3) {
+    static struct dm_sample out[HISTORY_LEN];
+
+    while (!atomic_get(&done)) {
+        uint64_t addr_int = reads.snapshots % 2 ? ADDR_A : ADDR_B;
+        int count = history_snapshot(addr_int, out, ARRAY_SIZE(out));
+
+        reads.snapshots++;
+        if (count == -EAGAIN) {
+            reads.busy++;
+        }
+        else if (count < 0) {
+            reads.missing++;
+        }
+        else if (!consistent(addr_int, out, count)) {
+            reads.bad++;
+        }
+        else {
+            reads.samples += count;
+        }
+        k_yield();
+    }
+}
+
+K_THREAD_STACK_DEFINE(producer_stack, STACK_SIZE);
+K_THREAD_STACK_DEFINE(reader_stack, STACK_SIZE);
+
+ZTEST(history, test_concurrent) {
+    static struct k_thread producer_thread;
+    static struct k_thread reader_thread;
+
+    memset(&reads, 0, sizeof(reads));
+    atomic_set(&done, 0);
+    peer.addr_int = ADDR_B;
+
+    k_thread_create(&reader_thread, reader_stack, STACK_SIZE, reader, NULL, NULL, NULL, PRIO, 0,
+                    K_NO_WAIT);
+    k_thread_create(&producer_thread, producer_stack, STACK_SIZE, producer, NULL, NULL, NULL,
+                    PRIO, 0, K_NO_WAIT);
+    zassert_ok(k_thread_join(&producer_thread, K_FOREVER));
+    zassert_ok(k_thread_join(&reader_thread, K_FOREVER));
+
+    TC_PRINT("%u pushes, %u snapshots: %u samples, %u busy, %u between owners, %u torn\n",
+             PUSHES, reads.snapshots, reads.samples, reads.busy, reads.missing, reads.bad);
+    zassert_equal(reads.bad, 0, "%u snapshots mixed up samples", reads.bad);
+}
+
+ZTEST_SUITE(history, NULL, NULL, release, NULL, NULL);
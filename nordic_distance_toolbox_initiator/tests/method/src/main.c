@@ -0,0 +1,169 @@
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <method.h>
+#include <ndt_adv.h>
+#include <peer.h>
+#include <sim.h>
+#include <smoothing.h>
+
+/* Airtime against accuracy of the method policies. Every reflector of the
+ * scenario is taken to serve both methods and is ranged every INTERVAL_MS
+ * while in range, with the method the policy picks. Each measurement is
+ * the true distance plus the simulation's noise for that method, offsets
+ * calibrated out, and goes through the smoothing chain and back into the
+ * policy as in main.c. The smoothed distance is held until the next one
+ * and compared with the true distance every STEP_MS, overall and for the
+ * time the peer is within CONFIG_DM_METHOD_MCPD_RANGE_CM. Airtime is the
+ * simulation's latency of each method.
+ */
+
+#define STEP_MS 10
+#define INTERVAL_MS 200
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define NEAR_M (CONFIG_DM_METHOD_MCPD_RANGE_CM / 100.0f)
+#define MCPD_NOISE_M (CONFIG_DM_SIM_MCPD_NOISE_CM / 100.0f)
+#define RTT_NOISE_M (CONFIG_DM_SIM_RTT_NOISE_CM / 100.0f)
+
+static struct peer peers[NUM_PEERS];
+
+/* peer.c is not built, the test keeps its own table. */
+int peer_slot(const struct peer *p) {
+    return p - peers;
+}
+
+struct score {
+    uint32_t mcpd;
+    uint32_t rtt;
+    uint32_t airtime_ms;
+    uint32_t samples;
+    uint32_t near_samples;
+    float sq_error;
+    float near_sq_error;
+};
+
+static void replay(const struct sim_node *self, const struct sim_node *refl, struct peer *p,
+                   struct score *s) {
+    uint32_t next = 0;
+    float held = 0;
+    bool measured = false;
+
+    for (uint32_t t = 0; t < sim_duration_ms(); t += STEP_MS) {
+        if (!sim_in_range(self, refl, t)) {
+            continue;
+        }
+
+        float d = sim_distance(self, refl, t);
+
+        if (t >= next) {
+            enum dm_ranging_mode mode;
+
+            zassert_ok(method_select(p, &mode));
+
+            bool mcpd = mode == DM_RANGING_MODE_MCPD;
+            float raw = d + (mcpd ? MCPD_NOISE_M : RTT_NOISE_M) * sim_gauss();
+
+            held = smoothing_update(p, raw, mode, t);
+            method_report(p, mode, held, t);
+            measured = true;
+            next = t + INTERVAL_MS;
+
+            if (mcpd) {
+                s->mcpd++;
+                s->airtime_ms += CONFIG_DM_SIM_MCPD_LATENCY_MS;
+            }
+            else {
+                s->rtt++;
+                s->airtime_ms += CONFIG_DM_SIM_RTT_LATENCY_MS;
+            }
+        }
+        if (!measured) {
+            continue;
+        }
+
+        float error = held - d;
+
+        s->sq_error += error * error;
+        s->samples++;
+        if (d < NEAR_M) {
+            s->near_sq_error += error * error;
+            s->near_samples++;
+        }
+    }
+}
+
+static int rms_cm(float sq, uint32_t n) {
+    return n ? (int)(sqrtf(sq / n) * 100) : 0;
+}
+
+struct policy {
+    const char *name;
+    enum method_policy policy;
+    struct score total;
+};
+
+ZTEST(method, test_policies) {
+    static struct policy policies[] = {
+        {"auto", METHOD_POLICY_AUTO},
+        {"mcpd", METHOD_POLICY_MCPD},
+        {"rtt", METHOD_POLICY_RTT},
+    };
+    const struct sim_node *self = sim_self(SIM_ROLE_INITIATOR);
+    uint32_t run_s = sim_duration_ms() / 1000;
+
+    zassert_not_null(self);
+    for (int j = 0; j < ARRAY_SIZE(policies); j++) {
+        struct policy *pol = &policies[j];
+        int slot = 0;
+
+        method_set_policy(pol->policy);
+        memset(&pol->total, 0, sizeof(pol->total));
+        for (int i = 0; i < sim_node_count(); i++) {
+            const struct sim_node *refl = sim_node_get(i);
+
+            if (refl->role != SIM_ROLE_REFLECTOR) {
+                continue;
+            }
+            zassert_true(slot < NUM_PEERS);
+
+            /* A new address per policy starts the filters afresh. */
+            struct peer *p = &peers[slot++];
+
+            memset(p, 0, sizeof(*p));
+            p->addr_int = ((uint64_t)(j + 1) << 40) | i;
+            p->modes = NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT;
+            p->sched_weight = 1;
+
+            replay(self, refl, p, &pol->total);
+        }
+        zassert_true(slot > 0, "scenario has no reflector");
+
+        struct score *s = &pol->total;
+
+        TC_PRINT("%s: %u MCPD, %u RTT, airtime %u ms/s, rms error %d cm, %d cm closer than "
+                 "%d cm\n", pol->name, s->mcpd, s->rtt, s->airtime_ms / run_s,
+                 rms_cm(s->sq_error, s->samples), rms_cm(s->near_sq_error, s->near_samples),
+                 CONFIG_DM_METHOD_MCPD_RANGE_CM);
+    }
+    method_set_policy(METHOD_POLICY_AUTO);
+
+    struct score *automatic = &policies[0].total;
+    struct score *mcpd = &policies[1].total;
+    struct score *rtt = &policies[2].total;
+
+    zassert_equal(mcpd->rtt, 0);
+    zassert_equal(rtt->mcpd, 0);
+
+    /* Cheaper than MCPD all the time, and better than RTT all the time
+     * where MCPD is meant to take over.
+     */
+    zassert_true(automatic->airtime_ms < mcpd->airtime_ms, "airtime %u ms",
+                 automatic->airtime_ms);
+    zassert_true(automatic->near_sq_error / MAX(automatic->near_samples, 1) <
+                 rtt->near_sq_error / MAX(rtt->near_samples, 1), "near rms error %d cm",
+                 rms_cm(automatic->near_sq_error, automatic->near_samples));
+}
+
+ZTEST_SUITE(method, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,183 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <ndt_adv.h>
+#include <sim.h>
+
+/* ndt_adv_parse() on a million manufacturer data blobs, checked against a
+ * byte by byte reading of the layout in ndt_adv.h and timed. The blobs are
+ * reflector advertisements, the same with one bit flipped, other Nordic
+ * data and random bytes, from 0 to 31 bytes long. Each one sits at the very
+ * end of its buffer, so that the sanitizer build catches any read past it.
+ * The parse time is taken over a smaller set, parsed again and again.
+ */
+
+#define BLOBS 1000000
+#define MAX_LEN 31
+#define TIMED_BLOBS 1024
+#define TIMED_ROUNDS 1000
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static void rand_fill(uint8_t *buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = rand32();
+    }
+}
+
+static bool reference_valid(const uint8_t *data, size_t len) {
+    return len >= NDT_ADV_LEN && data[0] == 0x59 && data[1] == 0x00 &&
+           data[2] == NDT_ADV_MAGIC && data[3] == NDT_ADV_VERSION &&
+           (data[4] & (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT)) != 0;
+}
+
+static size_t make_blob(uint8_t *buf, uint32_t n) {
+    struct ndt_adv_info info = {
+        .modes = rand32(),
+        .rng_seed = rand32(),
+        .seed_epoch = rand32(),
+        .id = rand32(),
+    };
+    size_t len = rand32() % (MAX_LEN + 1);
+
+    switch (n % 4) {
+    case 0:
+        len = MAX(len, NDT_ADV_LEN);
+        rand_fill(buf, len);
+        ndt_adv_encode(buf, len, &info);
+        break;
+    case 1:
+        len = MAX(len, NDT_ADV_LEN);
+        rand_fill(buf, len);
+        ndt_adv_encode(buf, len, &info);
+        buf[rand32() % len] ^= BIT(rand32() % 8);
+        break;
+    case 2:
+        rand_fill(buf, len);
+        if (len >= 2) {
+            sys_put_le16(NDT_ADV_COMPANY_CODE, buf);
+        }
+        break;
+    default:
+        rand_fill(buf, len);
+        break;
+    }
+    return len;
+}
+
+ZTEST(ndt_adv, test_roundtrip) {
+    struct ndt_adv_info info = {
+        .modes = NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT,
+        .rng_seed = 0x12345678,
+        .seed_epoch = 0xABCD,
+        .id = 0xCAFEF00D,
+    };
+    uint8_t buf[NDT_ADV_LEN_ID];
+    struct ndt_adv adv;
+    uint32_t id;
+
+    zassert_equal(ndt_adv_encode(buf, NDT_ADV_LEN - 1, &info), -ENOMEM);
+
+    zassert_equal(ndt_adv_encode(buf, NDT_ADV_LEN, &info), NDT_ADV_LEN);
+    zassert_ok(ndt_adv_parse(buf, NDT_ADV_LEN, &adv));
+    zassert_equal(ndt_adv_modes(&adv), info.modes);
+    zassert_equal(ndt_adv_rng_seed(&adv), info.rng_seed);
+    zassert_equal(ndt_adv_seed_epoch(&adv), info.seed_epoch);
+    zassert_equal(ndt_adv_id(&adv, &id), -ENOENT);
+
+    zassert_equal(ndt_adv_encode(buf, sizeof(buf), &info), NDT_ADV_LEN_ID);
+    zassert_ok(ndt_adv_parse(buf, sizeof(buf), &adv));
+    zassert_ok(ndt_adv_id(&adv, &id));
+    zassert_equal(id, info.id);
+
+    info.modes = BIT(7);
+    ndt_adv_encode(buf, sizeof(buf), &info);
+    zassert_equal(ndt_adv_parse(buf, sizeof(buf), &adv), -EINVAL);
+}
+
+ZTEST(ndt_adv, test_fuzz) {
+    static uint8_t pool[MAX_LEN];
+    static uint8_t blob[MAX_LEN];
+    uint32_t accepted = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t n = 0; n < BLOBS; n++) {
+        size_t len = make_blob(blob, n);
+        uint8_t *data = &pool[sizeof(pool) - len];
+        struct ndt_adv adv;
+
+        memcpy(data, blob, len);
+
+        int err = ndt_adv_parse(data, len, &adv);
+        bool valid = reference_valid(data, len);
+
+        if ((err == 0) != valid) {
+            if (mismatches++ < 10) {
+                TC_PRINT("blob %u, %u bytes: parse %d, reference %d\n", n, (uint32_t)len, err,
+                         valid);
+            }
+            continue;
+        }
+        if (!valid) {
+            continue;
+        }
+        accepted++;
+
+        uint32_t id;
+
+        zassert_equal(adv.data, data);
+        zassert_equal(adv.len, len);
+        zassert_equal(ndt_adv_modes(&adv), data[4]);
+        zassert_equal(ndt_adv_rng_seed(&adv),
+                      data[5] | data[6] << 8 | data[7] << 16 | (uint32_t)data[8] << 24);
+        zassert_equal(ndt_adv_seed_epoch(&adv), data[9] | data[10] << 8);
+        if (len >= NDT_ADV_LEN_ID) {
+            zassert_ok(ndt_adv_id(&adv, &id));
+            zassert_equal(id, data[11] | data[12] << 8 | data[13] << 16 | (uint32_t)data[14] << 24);
+        }
+        else {
+            zassert_equal(ndt_adv_id(&adv, &id), -ENOENT);
+        }
+    }
+
+    TC_PRINT("%u blobs, %u accepted, %u disagree with the reference\n", BLOBS, accepted,
+             mismatches);
+    zassert_equal(mismatches, 0);
+    zassert_true(accepted > 0);
+}
+
+ZTEST(ndt_adv, test_parse_time) {
+    static uint8_t blobs[TIMED_BLOBS][MAX_LEN];
+    static size_t lens[TIMED_BLOBS];
+    uint32_t accepted = 0;
+
+    for (int i = 0; i < TIMED_BLOBS; i++) {
+        lens[i] = make_blob(blobs[i], i);
+    }
+
+    uint64_t start = sim_host_time_us();
+
+    for (int round = 0; round < TIMED_ROUNDS; round++) {
+        for (int i = 0; i < TIMED_BLOBS; i++) {
+            struct ndt_adv adv;
+
+            accepted += ndt_adv_parse(blobs[i], lens[i], &adv) == 0;
+        }
+    }
+
+    uint64_t elapsed = sim_host_time_us() - start;
+
+    zassert_true(accepted > 0);
+    TC_PRINT("%u parses, %u accepted, %u ns per parse\n", TIMED_BLOBS * TIMED_ROUNDS, accepted,
+             (uint32_t)(elapsed * 1000 / (TIMED_BLOBS * TIMED_ROUNDS)));
+}
+
+ZTEST_SUITE(ndt_adv, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,196 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <ndt_adv.h>
+#include <peer.h>
+
+/* 10000 synthetic reflectors arrive, advertise for a while and leave. Every
+ * report goes through the peer table the way scan.c handles it, and the
+ * test counts how many reflectors got a slot and how many never did.
+ */
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define MODES (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT)
+#define ARRIVALS 10000
+#define ADV_MS 100
+#define LOSS_PERCENT 10
+#define MAX_PRESENT (8 * NUM_PEERS)
+
+struct churn_result {
+    uint32_t served;
+    uint32_t dropped;
+    uint32_t refused;
+    uint32_t evicted_lru;
+    uint32_t evicted_idle;
+    int peak;
+};
+
+/* Not under test, peers here are never scheduled. */
+void sched_remove(struct peer *p) {
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+/* Uniform in [mean / 2, 3 * mean / 2). */
+static uint32_t around(uint32_t mean) {
+    return mean / 2 + rand32() % mean;
+}
+
+static uint64_t test_addr(int i) {
+    return 0xD00000000000ULL + i;
+}
+
+static struct bt_uuid_128 test_uuid(int i) {
+    struct bt_uuid_128 uuid = {.uuid.type = BT_UUID_TYPE_128};
+
+    sys_put_le32(i, &uuid.val[0]);
+    sys_put_le32(0x4E445455, &uuid.val[12]);
+    return uuid;
+}
+
+static void count_busy(struct peer *p, void *user_data) {
+    int *busy = user_data;
+
+    if (k_uptime_get_32() - p->last_seen < CONFIG_DM_PEER_EVICT_MIN_IDLE_MS) {
+        (*busy)++;
+    }
+}
+
+/* One advertising report of reflector i, as scan_filter_match() and
+ * ndt_supported() handle it. Returns false if it found no slot.
+ */
+static bool report(int i, struct churn_result *r) {
+    struct peer *p = get_peer_by_addr(test_addr(i));
+
+    if (p != NULL) {
+        p->last_seen = k_uptime_get_32();
+        return true;
+    }
+
+    int err = create_peer(test_addr(i), MODES);
+
+    if (err == -ENOMEM && peer_evict_lru(CONFIG_DM_PEER_EVICT_MIN_IDLE_MS) == 0) {
+        r->evicted_lru++;
+        err = create_peer(test_addr(i), MODES);
+    }
+    if (err) {
+        int busy = 0;
+
+        /* Refusing is only right if no peer could have been evicted. */
+        peer_foreach_active(count_busy, &busy);
+        zassert_equal(busy, NUM_PEERS, "refused with %d busy peers", busy);
+        return false;
+    }
+    zassert_ok(uuid_set_peer(test_addr(i), test_uuid(i)));
+    return true;
+}
+
+static void churn(uint32_t arrival_ms, uint32_t dwell_ms, struct churn_result *r) {
+    static int present[MAX_PRESENT];
+    static uint32_t leave_at[MAX_PRESENT];
+    static bool served[ARRIVALS];
+    uint32_t start = k_uptime_get_32();
+    uint32_t next_arrival = 0;
+    uint32_t last_sweep = 0;
+    int count = 0;
+    int arrived = 0;
+
+    memset(r, 0, sizeof(*r));
+    memset(served, 0, sizeof(served));
+
+    while (arrived < ARRIVALS || count > 0) {
+        uint32_t now = k_uptime_get_32() - start;
+
+        while (arrived < ARRIVALS && next_arrival <= now) {
+            zassert_true(count < MAX_PRESENT);
+            present[count] = arrived++;
+            leave_at[count++] = now + around(dwell_ms);
+            next_arrival += around(arrival_ms);
+        }
+        r->peak = MAX(r->peak, count);
+
+        for (int j = 0; j < count; j++) {
+            if (leave_at[j] <= now) {
+                present[j] = present[--count];
+                leave_at[j--] = leave_at[count];
+                continue;
+            }
+            if (rand32() % 100 < LOSS_PERCENT) {
+                continue;
+            }
+            if (report(present[j], r)) {
+                served[present[j]] = true;
+            }
+            else {
+                r->refused++;
+            }
+        }
+
+        /* As peer_sweep() does. */
+        if (now - last_sweep >= CONFIG_DM_PEER_IDLE_TIMEOUT_MS / 4) {
+            last_sweep = now;
+            r->evicted_idle += peer_evict_idle(CONFIG_DM_PEER_IDLE_TIMEOUT_MS);
+        }
+        k_sleep(K_MSEC(ADV_MS));
+    }
+
+    for (int i = 0; i < ARRIVALS; i++) {
+        if (served[i]) {
+            r->served++;
+        }
+        else {
+            r->dropped++;
+        }
+    }
+    TC_PRINT("arrival %u ms, dwell %u ms, peak %d present: %u served, %u dropped, "
+             "%u reports refused, %u evicted idle, %u evicted to make room\n",
+             arrival_ms, dwell_ms, r->peak, r->served, r->dropped, r->refused, r->evicted_idle,
+             r->evicted_lru);
+}
+
+static void remove_all(void *fixture) {
+    for (int i = 0; i < ARRIVALS; i++) {
+        remove_peer(test_addr(i));
+    }
+}
+
+ZTEST(peer_churn, test_light) {
+    struct churn_result r;
+
+    /* About NUM_PEERS / 4 present at a time, everyone fits. */
+    churn(4 * 3000 / NUM_PEERS, 3000, &r);
+    zassert_equal(r.dropped, 0);
+    zassert_equal(r.served, ARRIVALS);
+}
+
+ZTEST(peer_churn, test_busy) {
+    struct churn_result r;
+
+    /* About half the slots present at a time, departed peers must make
+     * room long before they time out.
+     */
+    churn(2 * 3000 / NUM_PEERS, 3000, &r);
+    zassert_true(r.evicted_lru > 0);
+    zassert_true(r.dropped < ARRIVALS / 100, "%u dropped", r.dropped);
+}
+
+ZTEST(peer_churn, test_overload) {
+    struct churn_result r;
+
+    /* Three times more reflectors than slots, the ones that got in keep
+     * their slot while they are in range.
+     */
+    churn(3000 / (3 * NUM_PEERS), 3000, &r);
+    zassert_true(r.served >= NUM_PEERS);
+    zassert_equal(r.served + r.dropped, ARRIVALS);
+}
+
+ZTEST_SUITE(peer_churn, NULL, NULL, remove_all, NULL, NULL);
@@ -0,0 +1,278 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <ndt_adv.h>
+#include <peer.h>
+#include <sim.h>
+
+/* Peer table lookups by address and UUID, checked against a plain array
+ * and timed against the linear scan the index replaced.
+ */
+
+#define NUM_PEERS CONFIG_BT_SCAN_UUID_CNT
+#define MODES (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT)
+#define LOOKUPS 100000
+
+/* Not under test, peers here are never scheduled. */
+void sched_remove(struct peer *p) {
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static uint64_t test_addr(int i) {
+    return 0xD00000000000ULL + i;
+}
+
+static struct bt_uuid_128 test_uuid(int i, int generation) {
+    struct bt_uuid_128 uuid = {.uuid.type = BT_UUID_TYPE_128};
+
+    sys_put_le32(i, &uuid.val[0]);
+    sys_put_le32(generation, &uuid.val[4]);
+    sys_put_le32(0x4E445455, &uuid.val[12]);
+    return uuid;
+}
+
+static void remove_all(void *fixture) {
+    /* Addresses used by the churn test go up to 4 * NUM_PEERS. */
+    for (int i = 0; i < 4 * NUM_PEERS; i++) {
+        remove_peer(test_addr(i));
+    }
+}
+
+static void fill(void) {
+    for (int i = 0; i < NUM_PEERS; i++) {
+        zassert_ok(create_peer(test_addr(i), MODES));
+        zassert_ok(uuid_set_peer(test_addr(i), test_uuid(i, 0)));
+    }
+}
+
+ZTEST(peer_index, test_lookup) {
+    fill();
+
+    zassert_equal(create_peer(test_addr(NUM_PEERS), MODES), -ENOMEM);
+    for (int i = 0; i < NUM_PEERS; i++) {
+        struct bt_uuid_128 uuid = test_uuid(i, 0);
+        struct peer *p = get_peer_by_addr(test_addr(i));
+
+        zassert_not_null(p);
+        zassert_equal(p->addr_int, test_addr(i));
+        zassert_equal(get_peer(&uuid), p);
+    }
+
+    struct bt_uuid_128 unknown = test_uuid(NUM_PEERS, 0);
+
+    zassert_is_null(get_peer_by_addr(test_addr(NUM_PEERS)));
+    zassert_is_null(get_peer(&unknown));
+}
+
+ZTEST(peer_index, test_uuid_change) {
+    fill();
+
+    struct bt_uuid_128 old = test_uuid(3 % NUM_PEERS, 0);
+    struct bt_uuid_128 new = test_uuid(3 % NUM_PEERS, 1);
+
+    zassert_equal(uuid_set_peer(test_addr(3 % NUM_PEERS), old), -EALREADY);
+    zassert_ok(uuid_set_peer(test_addr(3 % NUM_PEERS), new));
+    zassert_is_null(get_peer(&old));
+    zassert_equal(get_peer(&new), get_peer_by_addr(test_addr(3 % NUM_PEERS)));
+}
+
+ZTEST(peer_index, test_remove) {
+    fill();
+
+    for (int i = 0; i < NUM_PEERS; i += 2) {
+        zassert_ok(remove_peer(test_addr(i)));
+    }
+    zassert_equal(remove_peer(test_addr(0)), -ENOENT);
+
+    /* Backward shifts must leave every remaining entry reachable. */
+    for (int i = 0; i < NUM_PEERS; i++) {
+        struct bt_uuid_128 uuid = test_uuid(i, 0);
+        struct peer *p = get_peer_by_addr(test_addr(i));
+
+        if (i % 2 == 0) {
+            zassert_is_null(p);
+            zassert_is_null(get_peer(&uuid));
+        }
+        else {
+            zassert_not_null(p);
+            zassert_equal(get_peer(&uuid), p);
+        }
+    }
+}
+
+ZTEST(peer_index, test_remove_id_peer) {
+    struct bt_uuid_128 uuid = test_uuid(0, 0);
+
+    /* A peer discovered by compact ID that later sends its UUID too. */
+    zassert_ok(create_peer(test_addr(0), MODES));
+    zassert_ok(id_set_peer(test_addr(0), 1234));
+    zassert_ok(uuid_set_peer(test_addr(0), uuid));
+    zassert_ok(remove_peer(test_addr(0)));
+    zassert_is_null(get_peer(&uuid));
+
+    /* The slot is reused, the old UUID must not find the new peer. */
+    zassert_ok(create_peer(test_addr(1), MODES));
+    zassert_ok(id_set_peer(test_addr(1), 5678));
+    zassert_is_null(get_peer(&uuid));
+}
+
+ZTEST(peer_index, test_churn) {
+    static bool present[4 * NUM_PEERS];
+    int count = 0;
+
+    memset(present, 0, sizeof(present));
+    for (int op = 0; op < 20000; op++) {
+        int i = rand32() % ARRAY_SIZE(present);
+
+        if (present[i]) {
+            zassert_ok(remove_peer(test_addr(i)));
+            present[i] = false;
+            count--;
+        }
+        else if (count < NUM_PEERS) {
+            zassert_ok(create_peer(test_addr(i), MODES));
+            zassert_ok(uuid_set_peer(test_addr(i), test_uuid(i, op)));
+            present[i] = true;
+            count++;
+        }
+
+        if (op % 97 != 0) {
+            continue;
+        }
+        for (int j = 0; j < ARRAY_SIZE(present); j++) {
+            struct peer *p = get_peer_by_addr(test_addr(j));
+
+            zassert_equal(p != NULL, present[j], "peer %d after %d operations", j, op);
+            if (p != NULL) {
+                zassert_equal(get_peer(&p->uuid), p);
+            }
+        }
+    }
+}
+
+#define HOLD_CHECKS 20000
+#define STACK_SIZE 2048
+
+static atomic_t churn_done;
+
+/* The scan callbacks: peers come and go, slots are reused for new
+ * addresses and compact IDs change.
+ */
+static void scanner(void *p1, void *p2, void *p3) {
+    uint32_t op = 0;
+
+    while (!atomic_get(&churn_done)) {
+        int i = rand32() % (4 * NUM_PEERS);
+
+        if (create_peer(test_addr(i), MODES) == -ENOMEM) {
+            peer_evict_lru(0);
+        }
+        id_set_peer(test_addr(i), op++);
+        if (op % 3 == 0) {
+            remove_peer(test_addr(rand32() % (4 * NUM_PEERS)));
+        }
+    }
+}
+
+K_THREAD_STACK_DEFINE(scanner_stack, STACK_SIZE);
+
+/* The DM callback: a peer looked up under the peer lock must stay the
+ * same peer until the lock is released, whatever the scanner does.
+ */
+ZTEST(peer_index, test_held_peer) {
+    static struct k_thread scanner_thread;
+    uint32_t held = 0;
+    uint32_t changed = 0;
+
+    atomic_set(&churn_done, 0);
+    k_thread_create(&scanner_thread, scanner_stack, STACK_SIZE, scanner, NULL, NULL, NULL,
+                    K_PRIO_PREEMPT(1), 0, K_NO_WAIT);
+
+    for (int n = 0; n < HOLD_CHECKS; n++) {
+        uint64_t addr = test_addr(n % (4 * NUM_PEERS));
+
+        peer_lock();
+        struct peer *p = get_peer_by_addr(addr);
+
+        if (p != NULL) {
+            uint32_t id = p->id;
+
+            p->distance_count = n;
+            /* Give the scanner every chance to get in. */
+            k_busy_wait(2);
+            k_yield();
+            changed += p->addr_int != addr || p->id != id || p->distance_count != n;
+            held++;
+        }
+        peer_unlock();
+        k_yield();
+    }
+
+    atomic_set(&churn_done, 1);
+    zassert_ok(k_thread_join(&scanner_thread, K_FOREVER));
+
+    TC_PRINT("%u peers held, %u changed under the lock\n", held, changed);
+    zassert_true(held > 0);
+    zassert_equal(changed, 0, "%u of %u held peers changed", changed, held);
+}
+
+/* What get_peer() did before the index: compare every UUID in turn. */
+static struct peer *linear_find(struct peer *table[], const struct bt_uuid_128 *uuid) {
+    for (int i = 0; i < NUM_PEERS; i++) {
+        if (memcmp(table[i]->uuid.val, uuid->val, BT_UUID_SIZE_128) == 0) {
+            return table[i];
+        }
+    }
+    return NULL;
+}
+
+ZTEST(peer_index, test_lookup_time) {
+    static struct peer *table[NUM_PEERS];
+    static struct bt_uuid_128 uuids[NUM_PEERS];
+    uint32_t found = 0;
+
+    fill();
+    for (int i = 0; i < NUM_PEERS; i++) {
+        uuids[i] = test_uuid(i, 0);
+        table[i] = get_peer(&uuids[i]);
+    }
+
+    uint64_t start = sim_host_time_us();
+
+    for (int i = 0; i < LOOKUPS; i++) {
+        found += get_peer(&uuids[rand32() % NUM_PEERS]) != NULL;
+    }
+
+    uint64_t by_uuid = sim_host_time_us() - start;
+
+    start = sim_host_time_us();
+    for (int i = 0; i < LOOKUPS; i++) {
+        found += get_peer_by_addr(test_addr(rand32() % NUM_PEERS)) != NULL;
+    }
+
+    uint64_t by_addr = sim_host_time_us() - start;
+
+    start = sim_host_time_us();
+    for (int i = 0; i < LOOKUPS; i++) {
+        found += linear_find(table, &uuids[rand32() % NUM_PEERS]) != NULL;
+    }
+
+    uint64_t linear = sim_host_time_us() - start;
+
+    zassert_equal(found, 3 * LOOKUPS);
+    TC_PRINT("peers %d: uuid %u ns, addr %u ns, linear uuid scan %u ns per lookup\n", NUM_PEERS,
+             (uint32_t)(by_uuid * 1000 / LOOKUPS), (uint32_t)(by_addr * 1000 / LOOKUPS),
+             (uint32_t)(linear * 1000 / LOOKUPS));
+}
+
+ZTEST_SUITE(peer_index, NULL, NULL, remove_all, NULL, NULL);
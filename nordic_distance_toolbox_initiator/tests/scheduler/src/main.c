@@ -0,0 +1,170 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <peer.h>
+#include <scheduler.h>
+
+/* Reflectors advertising from every 20 ms to once a second offer ranging
+ * opportunities to the scheduler. The test counts the rangings each one
+ * gets over a minute of virtual time and reports how evenly they are
+ * shared. The run is deterministic, the advertising jitter comes from a
+ * fixed seed.
+ */
+
+#define NUM_PEERS 10
+#define RUN_MS 60000
+#define JITTER_MS 10
+#define RATE_HZ CONFIG_DM_SCHED_MAX_RATE_HZ
+
+static const uint16_t adv_interval_ms[NUM_PEERS] = {20, 30, 50, 100, 100, 200, 300, 500, 700, 1000};
+
+static struct peer peers[NUM_PEERS];
+static uint32_t next_adv[NUM_PEERS];
+static uint32_t granted[NUM_PEERS];
+static struct peer *requesting;
+
+int dm_request_add(struct dm_request *req) {
+    granted[requesting - peers]++;
+    return 0;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+struct fairness {
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    /* Rangings per peer in percent of its expected share. */
+    uint32_t mean_pct;
+    uint32_t std_pct;
+};
+
+/* Each peer wants one ranging every interval_ms and has the given weight. */
+static void run(uint32_t interval_ms, const uint8_t weights[NUM_PEERS], struct fairness *f) {
+    uint32_t start = k_uptime_get_32();
+    uint32_t weight_sum = 0;
+
+    for (int i = 0; i < NUM_PEERS; i++) {
+        sched_remove(&peers[i]);
+    }
+    memset(peers, 0, sizeof(peers));
+    memset(granted, 0, sizeof(granted));
+    sched_reset_stats();
+    for (int i = 0; i < NUM_PEERS; i++) {
+        peers[i].interval_ms = interval_ms;
+        zassert_ok(sched_set_weight(&peers[i], weights[i]));
+        next_adv[i] = start + rand32() % adv_interval_ms[i];
+        weight_sum += weights[i];
+    }
+
+    while (true) {
+        uint32_t now = k_uptime_get_32();
+        int next = 0;
+
+        for (int i = 1; i < NUM_PEERS; i++) {
+            if ((int32_t)(next_adv[i] - next_adv[next]) < 0) {
+                next = i;
+            }
+        }
+        if (next_adv[next] - start >= RUN_MS) {
+            break;
+        }
+        if ((int32_t)(next_adv[next] - now) > 0) {
+            k_sleep(K_MSEC(next_adv[next] - now));
+        }
+
+        struct dm_request req = {0};
+        struct peer *p = &peers[next];
+
+        /* As peer_range() does. */
+        p->last_seen = k_uptime_get_32();
+        requesting = p;
+        sched_request(p, &req);
+        next_adv[next] += adv_interval_ms[next] + rand32() % (JITTER_MS + 1);
+    }
+
+    /* With the global cap binding every peer gets its weight's share of
+     * it, otherwise its own target rate.
+     */
+    uint32_t demand = 0;
+
+    for (int i = 0; i < NUM_PEERS; i++) {
+        demand += (uint64_t)weights[i] * RUN_MS / interval_ms;
+    }
+
+    uint32_t cap = RUN_MS / 1000 * RATE_HZ;
+    uint64_t sum = 0;
+    uint64_t sq_sum = 0;
+
+    memset(f, 0, sizeof(*f));
+    f->min = UINT32_MAX;
+    for (int i = 0; i < NUM_PEERS; i++) {
+        uint32_t expected = demand > cap ? cap * weights[i] / weight_sum
+                                         : weights[i] * RUN_MS / interval_ms;
+        uint32_t ratio = granted[i] * 100 / expected;
+
+        f->total += granted[i];
+        f->min = MIN(f->min, ratio);
+        f->max = MAX(f->max, ratio);
+        sum += ratio;
+        sq_sum += ratio * ratio;
+        TC_PRINT("  adv %4u ms weight %u: %u rangings, %u%% of its share\n", adv_interval_ms[i],
+                 weights[i], granted[i], ratio);
+    }
+    f->mean_pct = sum / NUM_PEERS;
+
+    uint64_t var = (sq_sum * NUM_PEERS - sum * sum) / (NUM_PEERS * NUM_PEERS);
+    uint32_t std = 0;
+
+    while ((uint64_t)(std + 1) * (std + 1) <= var) {
+        std++;
+    }
+    f->std_pct = std;
+
+    TC_PRINT("interval %u ms, cap %u/s: %u rangings, share %u%% mean, %u%% std dev, "
+             "%u%% to %u%%\n",
+             interval_ms, RATE_HZ, f->total, f->mean_pct, f->std_pct, f->min, f->max);
+}
+
+static const uint8_t equal[NUM_PEERS] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+
+ZTEST(scheduler, test_contended) {
+    struct fairness f;
+
+    /* Every peer asks for 5 rangings per second, far above the cap. */
+    run(200, equal, &f);
+    zassert_true(f.total >= RUN_MS / 1000 * RATE_HZ * 7 / 10, "%u rangings", f.total);
+    zassert_true(f.std_pct <= 5, "std dev %u%%", f.std_pct);
+    zassert_true(f.min >= 65, "a peer got %u%% of its share", f.min);
+}
+
+ZTEST(scheduler, test_weighted) {
+    static const uint8_t weights[NUM_PEERS] = {1, 2, 1, 2, 1, 2, 1, 2, 1, 2};
+    struct fairness f;
+
+    /* Even and odd peers advertise alike, the odd ones get twice the slots. */
+    run(200, weights, &f);
+    zassert_true(f.std_pct <= 8, "std dev %u%%", f.std_pct);
+    zassert_true(f.min >= 60, "a peer got %u%% of its share", f.min);
+}
+
+ZTEST(scheduler, test_uncontended) {
+    struct fairness f;
+
+    /* Below the cap every peer gets its own target rate, the noisy
+     * advertisers no more than the quiet ones.
+     */
+    run(2 * NUM_PEERS * 1000 / RATE_HZ, equal, &f);
+    zassert_true(f.min >= 85, "a peer got %u%% of its target", f.min);
+    zassert_true(f.max <= 105, "a peer got %u%% of its target", f.max);
+}
+
+ZTEST_SUITE(scheduler, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,150 @@
+#include <string.h>
+#include <stddef.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <messages.h>
+#include <seqlock.h>
+
+/* The display's handoff at 10 kHz: a writer thread publishes a dm_data
+ * every RATE_US and a reader thread snapshots it every RATE_US, both
+ * paced by their own timers. Every field of a message is derived from the
+ * same counter, so an accepted snapshot with fields from two messages is
+ * a torn read. Both sides stop halfway through their copy for a moment,
+ * so that the other one gets in: on native_sim threads only switch there,
+ * on qemu_x86_64 they also run on two CPUs at once. Each case runs with
+ * the reader above the writer and the other way round.
+ */
+
+#define RATE_US 100
+#define RUN_MS 2000
+#define STALL_US 20
+#define STACK_SIZE 2048
+#define PRIO_HIGH K_PRIO_PREEMPT(1)
+#define PRIO_LOW K_PRIO_PREEMPT(2)
+
+/* As in display.c. */
+#define READ_ATTEMPTS 4
+
+#define SPLIT offsetof(struct dm_data, distance)
+
+static struct seqlock lock;
+static struct dm_data shared;
+static atomic_t stop;
+
+static struct {
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t retries;
+    uint32_t given_up;
+    uint32_t torn;
+} counts;
+
+static void fill(struct dm_data *data, uint32_t n) {
+    data->peer_id = ((uint64_t)n << 32) | n;
+    data->timestamp = n;
+    data->distance = n & 0xFFFF;
+    data->confidence = n & 0x7FFF;
+    data->ranging_method = n & 0xFF;
+}
+
+static bool consistent(const struct dm_data *data) {
+    struct dm_data expected;
+
+    fill(&expected, data->timestamp);
+    return data->peer_id == expected.peer_id && data->distance == expected.distance &&
+           data->confidence == expected.confidence &&
+           data->ranging_method == expected.ranging_method;
+}
+
+/* Copy in two halves with a stall in between. */
+static void slow_copy(struct dm_data *dst, const struct dm_data *src) {
+    memcpy(dst, src, SPLIT);
+    k_busy_wait(STALL_US);
+    memcpy((uint8_t *)dst + SPLIT, (const uint8_t *)src + SPLIT, sizeof(*dst) - SPLIT);
+}
+
+static void writer(void *p1, void *p2, void *p3) {
+    struct k_timer timer;
+    struct dm_data data;
+
+    k_timer_init(&timer, NULL, NULL);
+    k_timer_start(&timer, K_USEC(RATE_US), K_USEC(RATE_US));
+    while (!atomic_get(&stop)) {
+        k_timer_status_sync(&timer);
+        fill(&data, ++counts.writes);
+
+        seqlock_write_begin(&lock);
+        slow_copy(&shared, &data);
+        seqlock_write_end(&lock);
+    }
+    k_timer_stop(&timer);
+}
+
+static void reader(void *p1, void *p2, void *p3) {
+    struct k_timer timer;
+
+    k_timer_init(&timer, NULL, NULL);
+    k_timer_start(&timer, K_USEC(RATE_US / 2), K_USEC(RATE_US));
+    while (!atomic_get(&stop)) {
+        struct dm_data data;
+        int attempt;
+
+        k_timer_status_sync(&timer);
+        for (attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            uint32_t seq = seqlock_read_begin(&lock);
+
+            slow_copy(&data, &shared);
+            if (!seqlock_read_retry(&lock, seq)) {
+                break;
+            }
+            counts.retries++;
+        }
+        if (attempt == READ_ATTEMPTS) {
+            counts.given_up++;
+            continue;
+        }
+        counts.reads++;
+        if (!consistent(&data)) {
+            counts.torn++;
+        }
+    }
+    k_timer_stop(&timer);
+}
+
+K_THREAD_STACK_DEFINE(writer_stack, STACK_SIZE);
+K_THREAD_STACK_DEFINE(reader_stack, STACK_SIZE);
+
+static void run(const char *name, int writer_prio, int reader_prio) {
+    static struct k_thread writer_thread;
+    static struct k_thread reader_thread;
+
+    memset(&counts, 0, sizeof(counts));
+    memset(&shared, 0, sizeof(shared));
+    atomic_set(&stop, 0);
+
+    k_thread_create(&writer_thread, writer_stack, STACK_SIZE, writer, NULL, NULL, NULL,
+                    writer_prio, 0, K_NO_WAIT);
+    k_thread_create(&reader_thread, reader_stack, STACK_SIZE, reader, NULL, NULL, NULL,
+                    reader_prio, 0, K_NO_WAIT);
+    k_msleep(RUN_MS);
+    atomic_set(&stop, 1);
+    zassert_ok(k_thread_join(&writer_thread, K_MSEC(100)));
+    zassert_ok(k_thread_join(&reader_thread, K_MSEC(100)));
+
+    TC_PRINT("%s: %u writes, %u reads, %u retries, %u given up, %u torn\n", name,
+             counts.writes, counts.reads, counts.retries, counts.given_up, counts.torn);
+    zassert_equal(counts.torn, 0, "%u torn reads", counts.torn);
+    zassert_true(counts.writes >= RUN_MS * 1000 / RATE_US * 8 / 10, "%u writes", counts.writes);
+    zassert_true(counts.reads > 0);
+}
+
+ZTEST(seqlock, test_reader_preempts_writer) {
+    run("reader above writer", PRIO_LOW, PRIO_HIGH);
+}
+
+ZTEST(seqlock, test_writer_preempts_reader) {
+    run("writer above reader", PRIO_HIGH, PRIO_LOW);
+}
+
+ZTEST_SUITE(seqlock, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,158 @@
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+#include <zephyr/timing/timing.h>
+#else
+#include <sim.h>
+#endif
+
+#include <peer.h>
+#include <smoothing.h>
+
+/* The filter chain selected in Kconfig smooths synthetic MCPD traces, a
+ * standing and a walking peer, with Gaussian noise and occasional
+ * multipath outliers. The test reports the RMS error before and after
+ * smoothing, and the time one update takes.
+ */
+
+#define INTERVAL_MS 200
+#define SAMPLES 3000
+#define NOISE_M 0.15f
+#define OUTLIER_PERCENT 5
+#define OUTLIER_M 2.0f
+#define BENCH_UPDATES 100000
+
+static struct peer peer = {.addr_int = 0xD00000000001ULL};
+
+/* Not under test, there is one peer. */
+int peer_slot(const struct peer *p) {
+    return 0;
+}
+
+static uint32_t rand_state = 1;
+
+static uint32_t rand32(void) {
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+static float gauss(void) {
+    /* Box-Muller, both uniforms in (0, 1]. */
+    float u = (rand32() % 65536 + 1) / 65536.0f;
+    float v = (rand32() % 65536 + 1) / 65536.0f;
+
+    return sqrtf(-2.0f * logf(u)) * cosf(2.0f * 3.14159265f * v);
+}
+
+static float measure(float d) {
+    float m = d + NOISE_M * gauss();
+
+    /* A reflected path is always longer than the direct one. */
+    if (rand32() % 100 < OUTLIER_PERCENT) {
+        m += OUTLIER_M * (rand32() % 1000) / 1000.0f;
+    }
+    return m;
+}
+
+static float standing(uint32_t t_ms) {
+    return 3.0f;
+}
+
+/* Walks between 0.5 m and 5 m at 1 m/s, pausing 2 s at each end. */
+static float walking(uint32_t t_ms) {
+    uint32_t t = t_ms % 13000;
+
+    if (t < 4500) {
+        return 0.5f + t / 1000.0f;
+    }
+    if (t < 6500) {
+        return 5.0f;
+    }
+    if (t < 11000) {
+        return 5.0f - (t - 6500) / 1000.0f;
+    }
+    return 0.5f;
+}
+
+/* Each trace gets a peer of its own, the state is reset on a new address. */
+static void trace(const char *name, float (*truth)(uint32_t t_ms), float *raw_rms, float *smooth_rms) {
+    float raw_sq = 0;
+    float smooth_sq = 0;
+
+    peer.addr_int++;
+    for (int i = 0; i < SAMPLES; i++) {
+        uint32_t t = i * INTERVAL_MS;
+        float d = truth(t);
+        float m = measure(d);
+        float s = smoothing_update(&peer, m, DM_RANGING_MODE_MCPD, t);
+
+        raw_sq += (m - d) * (m - d);
+        smooth_sq += (s - d) * (s - d);
+    }
+    *raw_rms = sqrtf(raw_sq / SAMPLES);
+    *smooth_rms = sqrtf(smooth_sq / SAMPLES);
+    TC_PRINT("%s: rms error %d cm raw, %d cm smoothed\n", name, (int)(*raw_rms * 100),
+             (int)(*smooth_rms * 100));
+}
+
+ZTEST(smoothing, test_standing) {
+    float raw, smooth;
+
+    trace("standing", standing, &raw, &smooth);
+    zassert_true(smooth < raw * 2 / 3, "smoothing removed too little noise");
+}
+
+ZTEST(smoothing, test_walking) {
+    float raw, smooth;
+
+    /* The lag of the filters must cost less than the noise they remove.
+     * The EMA lags a walking peer by more than that, it is meant for peers
+     * that mostly stand still.
+     */
+    trace("walking", walking, &raw, &smooth);
+#ifndef CONFIG_DM_SMOOTH_EMA
+    zassert_true(smooth < raw, "smoothing made a moving peer worse");
+#endif
+}
+
+ZTEST(smoothing, test_update_time) {
+    static float input[256];
+    volatile float sink = 0;
+
+    for (int i = 0; i < ARRAY_SIZE(input); i++) {
+        input[i] = measure(walking(i * INTERVAL_MS));
+    }
+    peer.addr_int++;
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+    timing_init();
+    timing_start();
+    timing_t start = timing_counter_get();
+#else
+    uint64_t start = sim_host_time_us();
+#endif
+
+    for (int i = 0; i < BENCH_UPDATES; i++) {
+        sink += smoothing_update(&peer, input[i % ARRAY_SIZE(input)], DM_RANGING_MODE_MCPD,
+                                 i * INTERVAL_MS);
+    }
+
+#ifdef CONFIG_TIMING_FUNCTIONS
+    timing_t end = timing_counter_get();
+    uint64_t cycles = timing_cycles_get(&start, &end);
+
+    timing_stop();
+    TC_PRINT("update: %u cycles, %u ns\n", (uint32_t)(cycles / BENCH_UPDATES),
+             (uint32_t)(timing_cycles_to_ns(cycles) / BENCH_UPDATES));
+#else
+    uint64_t host_us = sim_host_time_us() - start;
+
+    TC_PRINT("update: %u ns on the host\n", (uint32_t)(host_us * 1000 / BENCH_UPDATES));
+#endif
+}
+
+ZTEST_SUITE(smoothing, NULL, NULL, NULL, NULL, NULL);
@@ -1,11 +1,14 @@
 #include "advertise.h"
+#include "session.h"
+#include "stats.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
 
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/hci.h>
-#include <zephyr/bluetooth/conn.h>
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/gatt.h>
 #include <bluetooth/gatt_dm.h>
@@ -13,33 +16,37 @@
 #include <zephyr/random/random.h>
 
 #include <dm.h>
+#include <dm_seed.h>
+#include <ndt_adv.h>
 
 LOG_MODULE_REGISTER(advertise, LOG_LEVEL_DBG);
 
 #define DEVICE_NAME             "Thingy" 
 #define DEVICE_NAME_LEN         (sizeof(DEVICE_NAME) - 1)
 
-#define COMPANY_CODE 0x0059
-#define SUPPORT_MCPD_CODE 0x0D17A9CE
-#define SUPPORT_RTT_CODE 0x1D17A9CE
-
 static struct bt_le_ext_adv *adv;
 
-struct adv_mfg_data {
-	uint16_t company_code;	    /* Company Identifier Code. */
-	uint32_t support_dm_code;   /* To identify the device that supports distance measurement. */
-	uint32_t rng_seed;          /* Random seed used for generating hopping patterns. */
-} __packed;
+/* Advertising intervals are in units of 0.625 ms. */
+#define ADV_MS_TO_UNITS(ms) ((ms) * 8 / 5)
+
+/* Advertised fields. The advertising data also carries the compact ID so
+ * that initiators can range on the first packet, the scan response has no
+ * room for it next to the UUID.
+ */
+static struct ndt_adv_info adv_info;
+static uint8_t mfg_data[NDT_ADV_LEN_ID];
+static uint8_t mfg_data_rsp[NDT_ADV_LEN];
+static uint8_t adv_uuid[BT_UUID_SIZE_128];
 
-static struct adv_mfg_data mfg_data;
+/* Epoch in use for rangings, only moved once the advertised data carries it. */
+static uint16_t seed_epoch;
 
 struct bt_le_adv_param adv_param_noconn =
 	BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_USE_IDENTITY |
 				BT_LE_ADV_OPT_SCANNABLE |
-				BT_LE_ADV_OPT_NOTIFY_SCAN_REQ |
-				BT_LE_ADV_OPT_CONNECTABLE,
-				BT_GAP_ADV_FAST_INT_MIN_2,
-				BT_GAP_ADV_FAST_INT_MAX_2,
+				BT_LE_ADV_OPT_NOTIFY_SCAN_REQ,
+				ADV_MS_TO_UNITS(CONFIG_DM_ADV_FAST_INTERVAL_MS),
+				ADV_MS_TO_UNITS(CONFIG_DM_ADV_FAST_INTERVAL_MS) * 3 / 2,
 				NULL);
 
 
@@ -47,30 +54,165 @@ struct bt_le_adv_param *adv_param = &adv_param_noconn;
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-	BT_DATA(BT_DATA_MANUFACTURER_DATA, (unsigned char *)&mfg_data, sizeof(mfg_data)),
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, mfg_data, sizeof(mfg_data)),
 	BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
 };
 
 #define BT_UUID_NULL BT_UUID_128_ENCODE(0, 0, 0, 0, 0)
 
 static struct bt_data sd[] = {
-	BT_DATA(BT_DATA_MANUFACTURER_DATA, (unsigned char *)&mfg_data, sizeof(mfg_data)),
+	BT_DATA(BT_DATA_MANUFACTURER_DATA, mfg_data_rsp, sizeof(mfg_data_rsp)),
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_NULL),
 };
 
 
+/* Adaptive advertising interval. Fast while initiators are around, then
+ * doubled every backoff step once idle, down to the slow interval. Any
+ * scan request or ranging snaps it back to fast.
+ */
+#define ADV_FAST_MS CONFIG_DM_ADV_FAST_INTERVAL_MS
+#define ADV_SLOW_MS CONFIG_DM_ADV_SLOW_INTERVAL_MS
+
+static atomic_t last_activity;
+static uint32_t adv_interval_ms = ADV_FAST_MS;
+
+static struct k_spinlock stats_lock;
+static struct adv_stats stats;
+static uint32_t started_at;
+static uint32_t interval_since;
+static uint64_t events_x1000;
+static uint32_t woken_at;
+
+static void adv_interval_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(adv_interval_work, adv_interval_work_handler);
+
+/* Account the time spent at the current interval, called with stats_lock held. */
+static void stats_account(uint32_t now) {
+    events_x1000 += (uint64_t)(now - interval_since) * 1000 / adv_interval_ms;
+    interval_since = now;
+}
+
+static int adv_interval_set(uint32_t interval_ms) {
+    struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
+    int err;
+
+    adv_param_noconn.interval_min = ADV_MS_TO_UNITS(interval_ms);
+    adv_param_noconn.interval_max = ADV_MS_TO_UNITS(interval_ms) * 3 / 2;
+
+    /* The controller rejects new parameters on an enabled set, so pause it
+     * rather than recreating the set and setting its data again.
+     */
+    err = bt_le_ext_adv_stop(adv);
+    if (err) {
+        LOG_ERR("Failed to stop extended advertising (err %d)", err);
+        stats_inc(STATS_ADV_ERRORS);
+        return err;
+    }
+
+    err = bt_le_ext_adv_update_param(adv, adv_param);
+    if (err) {
+        LOG_ERR("Failed to set advertising interval %u ms (err %d)", interval_ms, err);
+    }
+
+    /* Keep advertising even if the update was rejected. */
+    int start_err = bt_le_ext_adv_start(adv, &ext_adv_start_param);
+    if (start_err) {
+        LOG_ERR("Failed to restart extended advertising (err %d)", start_err);
+    }
+    if (err || start_err) {
+        stats_inc(STATS_ADV_ERRORS);
+        return err ? err : start_err;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    stats_account(k_uptime_get_32());
+    if (interval_ms == ADV_FAST_MS) {
+        woken_at = atomic_get(&last_activity);
+    }
+    adv_interval_ms = interval_ms;
+    stats.updates++;
+    k_spin_unlock(&stats_lock, key);
+    return 0;
+}
+
+static void adv_interval_work_handler(struct k_work *work) {
+    uint32_t now = k_uptime_get_32();
+    uint32_t idle = now - (uint32_t)atomic_get(&last_activity);
+
+    if (idle < CONFIG_DM_ADV_FAST_HOLD_MS) {
+        if (adv_interval_ms != ADV_FAST_MS) {
+            adv_interval_set(ADV_FAST_MS);
+        }
+        k_work_reschedule(&adv_interval_work, K_MSEC(CONFIG_DM_ADV_FAST_HOLD_MS - idle));
+        return;
+    }
+
+    if (adv_interval_ms < ADV_SLOW_MS) {
+        adv_interval_set(MIN(adv_interval_ms * 2, ADV_SLOW_MS));
+    }
+    if (adv_interval_ms < ADV_SLOW_MS) {
+        k_work_reschedule(&adv_interval_work, K_MSEC(CONFIG_DM_ADV_BACKOFF_STEP_MS));
+    }
+}
+
+/* May be called from the Bluetooth RX thread, so the interval itself is
+ * only ever changed from the work queue.
+ */
+static void adv_activity(void) {
+    atomic_set(&last_activity, k_uptime_get_32());
+
+    if (adv_interval_ms != ADV_FAST_MS) {
+        k_work_reschedule(&adv_interval_work, K_NO_WAIT);
+    }
+}
+
+void advertise_ranged(void) {
+    uint32_t now = k_uptime_get_32();
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+    if (stats.first_range_ms < 0) {
+        stats.first_range_ms = now - started_at;
+    }
+    if (woken_at != 0) {
+        stats.wake_range_ms = now - woken_at;
+        woken_at = 0;
+    }
+    k_spin_unlock(&stats_lock, key);
+
+    adv_activity();
+}
+
+void advertise_get_stats(struct adv_stats *out) {
+    k_spinlock_key_t key = k_spin_lock(&stats_lock);
+    uint32_t now = k_uptime_get_32();
+    uint32_t elapsed = now - started_at;
+
+    stats_account(now);
+    *out = stats;
+    out->interval_ms = adv_interval_ms;
+    if (elapsed > 0) {
+        out->avg_interval_ms = (uint64_t)elapsed * 1000 / MAX(events_x1000, 1);
+        out->duty_permille = events_x1000 * CONFIG_DM_ADV_EVENT_US / 1000 / elapsed;
+    }
+    k_spin_unlock(&stats_lock, key);
+}
+
 static void adv_scanned_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_scanned_info *info) {
     struct dm_request req;
+    struct ndt_adv_window windows[NDT_ADV_WINDOWS_MAX];
+    int count = ndt_adv_windows(adv_info.modes, windows);
+    int err;
+
+    adv_activity();
+
+    /* Every initiator in range keeps scanning us, only accept what can be served. */
+    if (session_request(info->addr, count) != 0) {
+        return;
+    }
 
     bt_addr_le_copy(&req.bt_addr, info->addr);
     req.role = DM_ROLE_REFLECTOR;
-	#ifdef CONFIG_MCPD_DISTANCE
-    req.ranging_mode = DM_RANGING_MODE_MCPD;
-	#endif
-
-	#ifdef CONFIG_RTT_DISTANCE
-	req.ranging_mode = DM_RANGING_MODE_RTT;
-	#endif
 
     /* We need to make sure that we only initiate a ranging to a single peer.
         * A scan response from this device can be received by multiple peers which can
@@ -80,60 +222,83 @@ static void adv_scanned_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_scann
         * trying to range at the same time.
         *
         * This means that the initiator and the reflector need to set the same value
-        * for the random seed.
+        * for the random seed. Both derive it from the advertised seed, the epoch and
+        * the initiator's address, so concurrent initiators get different patterns.
         */
     bt_addr_le_copy(&req.bt_addr, info->addr);
-    req.rng_seed = mfg_data.rng_seed;
-    req.start_delay_us = 0;
+    req.rng_seed = dm_seed_derive(adv_info.rng_seed, info->addr, seed_epoch);
     req.extra_window_time_us = 0;
 
-    dm_request_add(&req);
+    /* The initiator picks the method and ranges in its window, so with both
+     * enabled listen in each. The session counts the windows as one ranging.
+     */
+    for (int i = 0; i < count; i++) {
+        req.ranging_mode = windows[i].mode == NDT_ADV_MODE_RTT ? DM_RANGING_MODE_RTT : DM_RANGING_MODE_MCPD;
+        req.start_delay_us = windows[i].start_delay_us;
+        err = dm_request_add(&req);
+        if (err) {
+            stats_inc(STATS_REQUEST_FAILED);
+            session_request_failed(info->addr);
+        }
+    }
 }
 
-static void connected(struct bt_conn *conn, uint8_t err) {
-	char addr[BT_ADDR_LE_STR_LEN];
+static void mfg_data_encode(void) {
+	ndt_adv_encode(mfg_data, sizeof(mfg_data), &adv_info);
+	ndt_adv_encode(mfg_data_rsp, sizeof(mfg_data_rsp), &adv_info);
+}
+
+const static struct bt_le_ext_adv_cb adv_cb = {
+	.scanned = adv_scanned_cb
+};
+
+#if CONFIG_DM_SEED_EPOCH_S > 0
+static void seed_epoch_roll(struct k_work *work) {
+	int err;
 
+	adv_info.seed_epoch = seed_epoch + 1;
+	mfg_data_encode();
+	err = bt_le_ext_adv_set_data(adv, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
-		LOG_ERR("Connection failed (err %u)\n", err);
-		return;
+		LOG_ERR("Failed to update seed epoch (err %d)\n", err);
+		stats_inc(STATS_ADV_ERRORS);
+		adv_info.seed_epoch = seed_epoch;
+		mfg_data_encode();
+	}
+	else {
+		seed_epoch = adv_info.seed_epoch;
 	}
 
-	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-	LOG_INF("Connected %s\n", addr);
-}
-
-static void disconnected(struct bt_conn *conn, uint8_t reason) {
-	LOG_INF("Disconnected (reason %u)", reason);
+	k_work_reschedule(k_work_delayable_from_work(work), K_SECONDS(CONFIG_DM_SEED_EPOCH_S));
 }
 
-BT_CONN_CB_DEFINE(conn_callbacks) = {
-	.connected = connected,
-	.disconnected = disconnected, };
-const static struct bt_le_ext_adv_cb adv_cb = {
-	.scanned = adv_scanned_cb
-};
+static K_WORK_DELAYABLE_DEFINE(seed_epoch_work, seed_epoch_roll);
+#endif
 
 
 int advertise_init(void) {
     int err;
 
-	int uuid[16] = {0};
-	sys_csrand_get(uuid, 16);
+	/* Must stay valid, the advertising data is set again on every epoch. */
+	sys_csrand_get(adv_uuid, sizeof(adv_uuid));
 
-	sd[1].data = uuid;
-	sd[1].data_len = 16;
+	sd[1].data = adv_uuid;
+	sd[1].data_len = sizeof(adv_uuid);
 	sd[1].type = BT_DATA_UUID128_ALL;
 
-    mfg_data.company_code = COMPANY_CODE;
+	adv_info.modes = 0;
 	#ifdef CONFIG_MCPD_DISTANCE
-    mfg_data.support_dm_code = SUPPORT_MCPD_CODE;
+	adv_info.modes |= NDT_ADV_MODE_MCPD;
 	#endif
 
 	#ifdef CONFIG_RTT_DISTANCE
-	mfg_data.support_dm_code = SUPPORT_RTT_CODE;
+	adv_info.modes |= NDT_ADV_MODE_RTT;
 	#endif
 
-	sys_csrand_get(&mfg_data.rng_seed, sizeof(mfg_data.rng_seed));
+	sys_csrand_get(&adv_info.rng_seed, sizeof(adv_info.rng_seed));
+	adv_info.seed_epoch = seed_epoch;
+	adv_info.id = sys_get_le32(adv_uuid);
+	mfg_data_encode();
 
     struct bt_le_ext_adv_start_param ext_adv_start_param = {0};
 
@@ -173,5 +338,23 @@ int advertise_init(void) {
 		return err;
 	}
 
+#if CONFIG_DM_SEED_EPOCH_S > 0
+	k_work_reschedule(&seed_epoch_work, K_SECONDS(CONFIG_DM_SEED_EPOCH_S));
+#endif
+
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	if (started_at == 0) {
+		started_at = k_uptime_get_32();
+		interval_since = started_at;
+		stats.first_range_ms = -1;
+		stats.wake_range_ms = -1;
+	}
+	k_spin_unlock(&stats_lock, key);
+
+	/* Start fast, back off if nobody shows up. */
+	atomic_set(&last_activity, k_uptime_get_32());
+	k_work_reschedule(&adv_interval_work, K_MSEC(CONFIG_DM_ADV_FAST_HOLD_MS));
+
 	return err;
 }
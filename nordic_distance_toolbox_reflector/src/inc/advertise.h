@@ -1,6 +1,22 @@
 #ifndef ADVERTISE_H__
 #define ADVERTISE_H__
 
+#include <stdint.h>
+
+struct adv_stats {
+    uint32_t interval_ms;     /* current advertising interval */
+    uint32_t avg_interval_ms; /* time-weighted since advertising started */
+    uint32_t duty_permille;   /* estimated radio duty cycle of advertising */
+    uint32_t updates;         /* interval changes */
+    int32_t first_range_ms;   /* advertising start to first ranging, -1 if none yet */
+    int32_t wake_range_ms;    /* last snap back to the fast interval to the next ranging, -1 if none */
+};
+
 int advertise_init(void);
 
+/* Called for every completed ranging, keeps advertising fast. */
+void advertise_ranged(void);
+
+void advertise_get_stats(struct adv_stats *stats);
+
 #endif
\ No newline at end of file
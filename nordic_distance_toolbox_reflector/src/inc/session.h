@@ -0,0 +1,51 @@
+#ifndef SESSION_H__
+#define SESSION_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/addr.h>
+
+struct session_stats {
+    uint32_t requests;        /* scan requests received */
+    uint32_t admitted;        /* handed to dm_request_add() */
+    uint32_t rate_limited;    /* dropped, token bucket empty */
+    uint32_t queue_full;      /* dropped, too many rangings pending */
+    uint32_t submit_failed;   /* dm_request_add() returned an error */
+    uint32_t results;         /* rangings that completed */
+    uint32_t timeouts;        /* admitted but no result arrived in time */
+    uint32_t no_session;      /* dropped, session table full (totals only) */
+    uint32_t since_ms;        /* session start or last reset (sessions only) */
+};
+
+typedef void (*session_cb_t)(const bt_addr_le_t *addr, const struct session_stats *stats, void *user_data);
+
+/* Account a scan request from addr that opens windows ranging windows,
+ * one per method the initiator may pick. Returns 0 if they should be
+ * requested, -EBUSY if the initiator is over its rate, -ENOBUFS if too
+ * many rangings are already pending and -ENOMEM if no session is free.
+ */
+int session_request(const bt_addr_le_t *addr, uint8_t windows);
+
+/* One window of the admitted request could not be queued with the DM
+ * library.
+ */
+void session_request_failed(const bt_addr_le_t *addr);
+
+/* A window with addr ended, ranged if the initiator used it. The first
+ * ranged window releases the pending slot.
+ */
+void session_result(const bt_addr_le_t *addr, bool ranged);
+
+int session_stats_get(const bt_addr_le_t *addr, struct session_stats *stats);
+
+/* Totals over all sessions, including those since evicted. */
+void session_stats_total(struct session_stats *stats);
+
+void session_foreach(session_cb_t cb, void *user_data);
+
+void session_reset(void);
+
+/* Clear the counters but keep the sessions and their rate limits. */
+void session_stats_reset(void);
+
+#endif
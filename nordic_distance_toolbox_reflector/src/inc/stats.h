@@ -0,0 +1,32 @@
+#ifndef STATS_H__
+#define STATS_H__
+
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+
+#include <dm.h>
+
+/* Reflector counters shown by the "ndt stats" shell command, next to the
+ * session and advertising statistics. They cover events that otherwise only
+ * show up as log lines.
+ */
+
+enum stats_counter {
+    STATS_REQUEST_FAILED, /* dm_request_add() errors, per ranging method */
+    STATS_ADV_ERRORS,     /* advertising updates that failed */
+    STATS_COUNTER_COUNT,
+};
+
+extern atomic_t stats_counters[STATS_COUNTER_COUNT];
+
+static inline void stats_inc(enum stats_counter counter) {
+    atomic_inc(&stats_counters[counter]);
+}
+
+/* Account a ranging result that data_ready() took callback_us to handle. */
+void stats_result(enum dm_quality quality, uint32_t callback_us);
+
+/* Clear these counters and those of the sessions. */
+void stats_reset(void);
+
+#endif
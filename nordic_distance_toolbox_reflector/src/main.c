@@ -9,6 +9,8 @@
 
 #include <advertise.h>
 #include <color.h>
+#include <session.h>
+#include <stats.h>
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_DBG);
 
@@ -45,10 +47,14 @@ bool ranged = false;
 
 void data_ready(struct dm_result *result)
 {
+	uint32_t cb_cycles = k_cycle_get_32();
+
 	if (!result) {
 		return;
 	}
 	ranged = true;
+	session_result(&result->bt_addr, result->status);
+	advertise_ranged();
 
 	const char *quality[DM_QUALITY_NONE + 1] = {"ok", "poor", "do not use", "crc fail", "none"};
 	char addr[BT_ADDR_LE_STR_LEN];
@@ -67,6 +73,8 @@ void data_ready(struct dm_result *result)
 		result->dist_estimates.mcpd.rssi_openspace,
 		result->dist_estimates.mcpd.best);
 	// Convert the "best" estimate to a color between 0-255
+
+	stats_result(result->quality, k_cyc_to_us_floor32(k_cycle_get_32() - cb_cycles));
 }
 
 
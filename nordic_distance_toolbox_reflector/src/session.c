@@ -0,0 +1,283 @@
+#include <session.h>
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#define NUM_SESSIONS CONFIG_DM_REFLECTOR_SESSIONS
+#define PENDING_MAX CONFIG_DM_REFLECTOR_PENDING_MAX
+#define PENDING_TIMEOUT_MS CONFIG_DM_SESSION_PENDING_TIMEOUT_MS
+
+/* Tokens are kept in thousandths so that a refill of RATE_HZ tokens per
+ * second is RATE_HZ thousandths per millisecond.
+ */
+#define TOKEN_SCALE 1000
+#define BUCKET_SIZE (CONFIG_DM_SESSION_BURST * TOKEN_SCALE)
+
+struct session {
+    bt_addr_le_t addr;
+    bool used;
+    uint8_t pending;
+    uint32_t last_seen;
+    uint32_t tokens;
+    uint32_t refilled_at;
+    struct session_stats stats;
+};
+
+/* Rangings handed to the DM library and not yet answered, oldest first.
+ * A request keeps its entry until each of its windows reported, but stops
+ * counting as pending for its session once one of them ranged.
+ */
+struct pending_req {
+    struct session *s;
+    uint32_t submitted_at;
+    uint8_t windows;
+    bool ranged;
+};
+
+static struct session sessions[NUM_SESSIONS];
+static struct pending_req pending[PENDING_MAX];
+static int pending_count;
+static struct session_stats total;
+static struct k_spinlock lock;
+
+#define STAT_INC(s, field) do { (s)->stats.field++; total.field++; } while (0)
+
+static struct session *session_find(const bt_addr_le_t *addr) {
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        if (sessions[i].used && bt_addr_le_eq(&sessions[i].addr, addr)) {
+            return &sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* Idle for this long, a session's bucket would have refilled anyway, so
+ * handing it to another initiator does not let anyone skip its rate limit.
+ */
+#define SESSION_IDLE_MS ((CONFIG_DM_SESSION_BURST * 1000) / CONFIG_DM_SESSION_RATE_HZ)
+
+/* Take a free session, or the least recently seen idle one. */
+static struct session *session_alloc(const bt_addr_le_t *addr, uint32_t now) {
+    struct session *victim = NULL;
+
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        struct session *s = &sessions[i];
+
+        if (!s->used) {
+            victim = s;
+            break;
+        }
+        if (s->pending == 0 && (now - s->last_seen) >= SESSION_IDLE_MS && (victim == NULL || (now - s->last_seen) > (now - victim->last_seen))) {
+            victim = s;
+        }
+    }
+
+    if (victim == NULL) {
+        return NULL;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    bt_addr_le_copy(&victim->addr, addr);
+    victim->used = true;
+    victim->tokens = BUCKET_SIZE;
+    victim->refilled_at = now;
+    victim->stats.since_ms = now;
+    return victim;
+}
+
+static void bucket_refill(struct session *s, uint32_t now) {
+    uint64_t tokens = s->tokens + (uint64_t)(now - s->refilled_at) * CONFIG_DM_SESSION_RATE_HZ;
+
+    s->tokens = MIN(tokens, BUCKET_SIZE);
+    s->refilled_at = now;
+}
+
+static void pending_remove(int i) {
+    if (!pending[i].ranged) {
+        pending[i].s->pending--;
+    }
+    memmove(&pending[i], &pending[i + 1], (pending_count - i - 1) * sizeof(pending[0]));
+    pending_count--;
+}
+
+/* The DM library does not report rangings that never happened, so pending
+ * slots are reclaimed once their result is overdue.
+ */
+static void pending_expire(uint32_t now) {
+    while (pending_count > 0 && (now - pending[0].submitted_at) > PENDING_TIMEOUT_MS) {
+        if (!pending[0].ranged) {
+            STAT_INC(pending[0].s, timeouts);
+        }
+        pending_remove(0);
+    }
+}
+
+static int pending_find(const struct session *s, bool newest) {
+    int found = -ENOENT;
+
+    for (int i = 0; i < pending_count; i++) {
+        if (pending[i].s == s) {
+            found = i;
+            if (!newest) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+int session_request(const bt_addr_le_t *addr, uint8_t windows) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    uint32_t now = k_uptime_get_32();
+    int ret = 0;
+
+    pending_expire(now);
+    total.requests++;
+
+    struct session *s = session_find(addr);
+
+    if (s == NULL) {
+        s = session_alloc(addr, now);
+    }
+    if (s == NULL) {
+        total.no_session++;
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    s->stats.requests++;
+    s->last_seen = now;
+    bucket_refill(s, now);
+
+    if (s->tokens < TOKEN_SCALE) {
+        STAT_INC(s, rate_limited);
+        ret = -EBUSY;
+    }
+    /* An initiator ranges with one reflector at a time, a second request
+     * from it could only be served after the first one anyway.
+     */
+    else if (pending_count == PENDING_MAX || s->pending > 0) {
+        STAT_INC(s, queue_full);
+        ret = -ENOBUFS;
+    }
+    else {
+        s->tokens -= TOKEN_SCALE;
+        s->pending++;
+        pending[pending_count].s = s;
+        pending[pending_count].submitted_at = now;
+        pending[pending_count].windows = windows;
+        pending[pending_count].ranged = false;
+        pending_count++;
+        STAT_INC(s, admitted);
+    }
+
+out:
+    k_spin_unlock(&lock, key);
+    return ret;
+}
+
+void session_request_failed(const bt_addr_le_t *addr) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    struct session *s = session_find(addr);
+
+    if (s != NULL) {
+        int i = pending_find(s, true);
+
+        /* Not the initiator's fault, give the token back if none of the
+         * windows could be queued.
+         */
+        if (i >= 0 && --pending[i].windows == 0) {
+            pending_remove(i);
+            s->tokens = MIN(s->tokens + TOKEN_SCALE, BUCKET_SIZE);
+        }
+        STAT_INC(s, submit_failed);
+    }
+    k_spin_unlock(&lock, key);
+}
+
+void session_result(const bt_addr_le_t *addr, bool ranged) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    struct session *s = session_find(addr);
+
+    if (s != NULL) {
+        /* Windows report in the order they were queued. */
+        int i = pending_find(s, false);
+
+        if (i < 0) {
+            if (ranged) {
+                STAT_INC(s, results);
+            }
+        }
+        else {
+            if (ranged && !pending[i].ranged) {
+                pending[i].ranged = true;
+                s->pending--;
+                STAT_INC(s, results);
+            }
+            if (--pending[i].windows == 0) {
+                pending_remove(i);
+            }
+        }
+    }
+    k_spin_unlock(&lock, key);
+}
+
+int session_stats_get(const bt_addr_le_t *addr, struct session_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    struct session *s = session_find(addr);
+    int ret = -ENOENT;
+
+    if (s != NULL) {
+        *stats = s->stats;
+        ret = 0;
+    }
+    k_spin_unlock(&lock, key);
+    return ret;
+}
+
+void session_stats_total(struct session_stats *stats) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    *stats = total;
+    k_spin_unlock(&lock, key);
+}
+
+void session_foreach(session_cb_t cb, void *user_data) {
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        bool used = sessions[i].used;
+        bt_addr_le_t addr = sessions[i].addr;
+        struct session_stats stats = sessions[i].stats;
+
+        k_spin_unlock(&lock, key);
+
+        /* Called without the lock held, so cb may log or block. */
+        if (used) {
+            cb(&addr, &stats, user_data);
+        }
+    }
+}
+
+void session_reset(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+
+    memset(sessions, 0, sizeof(sessions));
+    pending_count = 0;
+    memset(&total, 0, sizeof(total));
+    k_spin_unlock(&lock, key);
+}
+
+void session_stats_reset(void) {
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    uint32_t now = k_uptime_get_32();
+
+    for (int i = 0; i < NUM_SESSIONS; i++) {
+        memset(&sessions[i].stats, 0, sizeof(sessions[i].stats));
+        sessions[i].stats.since_ms = now;
+    }
+    memset(&total, 0, sizeof(total));
+    k_spin_unlock(&lock, key);
+}
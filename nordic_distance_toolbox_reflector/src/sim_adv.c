@@ -0,0 +1,178 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/bluetooth/bluetooth.h>
+
+#include <advertise.h>
+#include <session.h>
+#include <sim.h>
+
+LOG_MODULE_REGISTER(sim_adv, LOG_LEVEL_INF);
+
+/* Stand-in for the advertising part of the Bluetooth host. Every
+ * advertising event of the set, each initiator of the scenario in range
+ * sends a scan request with CONFIG_DM_SIM_SCAN_REQ_PERMILLE probability,
+ * which reaches the set's scanned callback as it would from the stack.
+ */
+
+/* Advertising events are delayed by up to 10 ms at random, as on air. */
+#define ADV_DELAY_MAX_MS 10
+
+struct bt_le_ext_adv {
+    const struct bt_le_ext_adv_cb *cb;
+    uint32_t interval_ms;
+    bool created;
+    bool enabled;
+};
+
+static struct bt_le_ext_adv adv_set;
+static K_SEM_DEFINE(adv_enabled, 0, 1);
+
+static uint32_t adv_events;
+static uint32_t scan_requests;
+
+static uint32_t adv_interval_ms(const struct bt_le_adv_param *param) {
+    return MAX(param->interval_min * 5 / 8, 20);
+}
+
+static void sim_adv_thread(void *p1, void *p2, void *p3) {
+    const struct sim_node *self = sim_self(SIM_ROLE_REFLECTOR);
+
+    if (self == NULL) {
+        LOG_ERR("Scenario has no reflector %d", CONFIG_DM_SIM_SELF);
+        return;
+    }
+
+    while (true) {
+        if (!adv_set.enabled) {
+            k_sem_take(&adv_enabled, K_FOREVER);
+            continue;
+        }
+        k_msleep(adv_set.interval_ms + sim_rand() % (ADV_DELAY_MAX_MS + 1));
+        if (!adv_set.enabled) {
+            continue;
+        }
+        adv_events++;
+
+        uint32_t now = k_uptime_get_32();
+
+        for (int i = 0; i < sim_node_count(); i++) {
+            const struct sim_node *node = sim_node_get(i);
+
+            if (node->role != SIM_ROLE_INITIATOR || !sim_in_range(self, node, now) ||
+                !sim_chance(CONFIG_DM_SIM_SCAN_REQ_PERMILLE)) {
+                continue;
+            }
+
+            bt_addr_le_t addr = node->addr;
+            struct bt_le_ext_adv_scanned_info info = {
+                .addr = &addr,
+            };
+
+            scan_requests++;
+            if (adv_set.cb != NULL && adv_set.cb->scanned != NULL) {
+                adv_set.cb->scanned(&adv_set, &info);
+            }
+        }
+    }
+}
+
+K_THREAD_DEFINE(sim_adv_id, 2048, sim_adv_thread, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO - 1, 0, 0);
+
+int bt_enable(bt_ready_cb_t cb) {
+    if (cb != NULL) {
+        cb(0);
+    }
+    return 0;
+}
+
+void bt_id_get(bt_addr_le_t *addrs, size_t *count) {
+    const struct sim_node *self = sim_self(SIM_ROLE_REFLECTOR);
+
+    if (self == NULL || *count == 0) {
+        *count = 0;
+        return;
+    }
+    bt_addr_le_copy(&addrs[0], &self->addr);
+    *count = 1;
+}
+
+int bt_le_filter_accept_list_clear(void) {
+    return 0;
+}
+
+int bt_le_ext_adv_create(const struct bt_le_adv_param *param, const struct bt_le_ext_adv_cb *cb,
+                         struct bt_le_ext_adv **adv) {
+    if (adv_set.created) {
+        return -ENOMEM;
+    }
+    adv_set.cb = cb;
+    adv_set.interval_ms = adv_interval_ms(param);
+    adv_set.created = true;
+    *adv = &adv_set;
+    return 0;
+}
+
+int bt_le_ext_adv_delete(struct bt_le_ext_adv *adv) {
+    adv->created = false;
+    adv->enabled = false;
+    return 0;
+}
+
+static size_t data_len(const struct bt_data *data, size_t count) {
+    size_t len = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        len += 2 + data[i].data_len;
+    }
+    return len;
+}
+
+int bt_le_ext_adv_set_data(struct bt_le_ext_adv *adv, const struct bt_data *ad, size_t ad_len,
+                           const struct bt_data *sd, size_t sd_len) {
+    /* Legacy advertising, as the set is scannable. */
+    if (data_len(ad, ad_len) > BT_GAP_ADV_MAX_ADV_DATA_LEN ||
+        data_len(sd, sd_len) > BT_GAP_ADV_MAX_ADV_DATA_LEN) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+int bt_le_ext_adv_update_param(struct bt_le_ext_adv *adv, const struct bt_le_adv_param *param) {
+    /* Like the controller, refuse new parameters on an enabled set. */
+    if (adv->enabled) {
+        return -EINVAL;
+    }
+    adv->interval_ms = adv_interval_ms(param);
+    return 0;
+}
+
+int bt_le_ext_adv_start(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_start_param *param) {
+    if (adv->enabled) {
+        return -EALREADY;
+    }
+    adv->enabled = true;
+    k_sem_give(&adv_enabled);
+    return 0;
+}
+
+int bt_le_ext_adv_stop(struct bt_le_ext_adv *adv) {
+    adv->enabled = false;
+    return 0;
+}
+
+void sim_app_summary(void) {
+    struct session_stats s;
+    struct adv_stats adv;
+
+    session_stats_total(&s);
+    advertise_get_stats(&adv);
+
+    LOG_INF("sim: adv %u events, %u scan requests", adv_events, scan_requests);
+    LOG_INF("sim: sessions %u requests, %u admitted, %u rate limited, %u queue full, %u no session",
+            s.requests, s.admitted, s.rate_limited, s.queue_full, s.no_session);
+    LOG_INF("sim: sessions %u results, %u timeouts, %u submit failed", s.results, s.timeouts,
+            s.submit_failed);
+    LOG_INF("sim: adv interval %u ms, average %u ms, duty %u permille, %u updates",
+            adv.interval_ms, adv.avg_interval_ms, adv.duty_permille, adv.updates);
+}
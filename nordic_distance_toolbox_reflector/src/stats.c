@@ -0,0 +1,89 @@
+#include <stats.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/addr.h>
+
+#ifdef CONFIG_SHELL
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <advertise.h>
+#include <ndt_stats.h>
+#include <session.h>
+
+atomic_t stats_counters[STATS_COUNTER_COUNT];
+
+static struct ndt_quality quality;
+static struct ndt_hist callback_hist;
+static uint32_t since_ms;
+
+void stats_result(enum dm_quality q, uint32_t callback_us) {
+    ndt_quality_add(&quality, q);
+    ndt_hist_add(&callback_hist, callback_us);
+}
+
+void stats_reset(void) {
+    for (int i = 0; i < STATS_COUNTER_COUNT; i++) {
+        atomic_clear(&stats_counters[i]);
+    }
+    ndt_quality_reset(&quality);
+    ndt_hist_reset(&callback_hist);
+    session_stats_reset();
+    since_ms = k_uptime_get_32();
+}
+
+#ifdef CONFIG_SHELL
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv) {
+    uint32_t now = k_uptime_get_32();
+    uint32_t rate = ndt_rate_centi(ndt_quality_total(&quality), since_ms, now);
+    struct session_stats s;
+    struct adv_stats adv;
+
+    session_stats_total(&s);
+    advertise_get_stats(&adv);
+
+    shell_print(sh, "uptime %u s, counting for %u s", now / 1000, (now - since_ms) / 1000);
+    shell_print(sh, "results: %u.%02u per second", rate / 100, rate % 100);
+    ndt_quality_print(sh, &quality);
+    ndt_hist_print(sh, "callback", "us", &callback_hist);
+    shell_print(sh, "sessions: %u requests, %u admitted, %u rate limited, %u queue full, %u no session",
+                s.requests, s.admitted, s.rate_limited, s.queue_full, s.no_session);
+    shell_print(sh, "sessions: %u results, %u timeouts, %u submit failed", s.results, s.timeouts,
+                s.submit_failed);
+    shell_print(sh, "dm: %u requests failed",
+                (uint32_t)atomic_get(&stats_counters[STATS_REQUEST_FAILED]));
+    shell_print(sh, "adv: interval %u ms, average %u ms, duty %u permille, %u updates, %u errors",
+                adv.interval_ms, adv.avg_interval_ms, adv.duty_permille, adv.updates,
+                (uint32_t)atomic_get(&stats_counters[STATS_ADV_ERRORS]));
+    return 0;
+}
+
+static void session_print(const bt_addr_le_t *addr, const struct session_stats *s, void *user_data) {
+    const struct shell *sh = user_data;
+    uint32_t rate = ndt_rate_centi(s->results, s->since_ms, k_uptime_get_32());
+    char str[BT_ADDR_LE_STR_LEN];
+
+    bt_addr_le_to_str(addr, str, sizeof(str));
+    shell_print(sh, "%s %u requests, %u admitted, %u results, %u.%02u/s, %u timeouts", str,
+                s->requests, s->admitted, s->results, rate / 100, rate % 100, s->timeouts);
+}
+
+static int cmd_peers(const struct shell *sh, size_t argc, char **argv) {
+    session_foreach(session_print, (void *)sh);
+    return 0;
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv) {
+    stats_reset();
+    shell_print(sh, "Statistics cleared");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(ndt_cmds,
+    SHELL_CMD(stats, NULL, "Counters and latency since the last reset", cmd_stats),
+    SHELL_CMD(peers, NULL, "Ranging rate per initiator", cmd_peers),
+    SHELL_CMD(reset, NULL, "Clear the counters", cmd_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(ndt, &ndt_cmds, "Distance toolbox statistics", NULL);
+#endif
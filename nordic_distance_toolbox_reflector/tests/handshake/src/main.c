@@ -0,0 +1,232 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/bluetooth/addr.h>
+
+#include <dm_seed.h>
+#include <ndt_adv.h>
+#include <session.h>
+
+/* A scan request does not carry the initiator's choice of method, the
+ * start of its ranging does. Here a reflector opens the windows of
+ * ndt_adv_windows() for each scan request it admits, initiators pick a
+ * method among the advertised ones and start their ranging at
+ * ndt_adv_start_delay_us(), as peer_range() does, and the radio ranges
+ * when both sides start the same method at the same time with the same
+ * seed. The reflector's windows then report in the order they were
+ * queued, as data_ready() does, so the session table sees the window the
+ * initiator used as ranged and the others as not.
+ */
+
+#define INITIATORS 4
+#define ROUNDS 200
+#define EPOCH_ROUNDS 50
+#define ROUND_MS (1000 / CONFIG_DM_SESSION_RATE_HZ)
+#define MODES_BOTH (NDT_ADV_MODE_MCPD | NDT_ADV_MODE_RTT)
+#define BASE_SEED 0x5EED1234
+
+static bt_addr_le_t addrs[INITIATORS];
+
+/* Windows of an admitted scan request that have not reported yet. */
+struct request {
+    int initiator;
+    int count;
+    int next;
+    int used;
+};
+
+static void setup_addrs(void) {
+    for (int i = 0; i < INITIATORS; i++) {
+        addrs[i].type = BT_ADDR_LE_RANDOM;
+        memset(addrs[i].a.val, 0, sizeof(addrs[i].a.val));
+        addrs[i].a.val[0] = i + 1;
+        addrs[i].a.val[5] = 0xC0;
+    }
+}
+
+static void reset(void *fixture) {
+    setup_addrs();
+    session_reset();
+}
+
+/* Initiator i answers a report of a reflector advertising modes in epoch
+ * with a scan request and a ranging of mode, using the seed of
+ * initiator_epoch. Returns -EBUSY if the reflector turned it away,
+ * otherwise req holds the windows the reflector opened and which of them
+ * ranged, -1 if none.
+ */
+static int scan_request(uint8_t modes, int i, uint8_t mode, uint16_t epoch, uint16_t initiator_epoch,
+                        struct request *req) {
+    struct ndt_adv_window windows[NDT_ADV_WINDOWS_MAX];
+    int count = ndt_adv_windows(modes, windows);
+    uint32_t seed = dm_seed_derive(BASE_SEED, &addrs[i], epoch);
+
+    if (session_request(&addrs[i], count) != 0) {
+        return -EBUSY;
+    }
+
+    uint32_t start_us = ndt_adv_start_delay_us(modes, mode);
+    uint32_t initiator_seed = dm_seed_derive(BASE_SEED, &addrs[i], initiator_epoch);
+
+    req->initiator = i;
+    req->count = count;
+    req->next = 0;
+    req->used = -1;
+    for (int w = 0; w < count; w++) {
+        if (windows[w].mode == mode && windows[w].start_delay_us == start_us && seed == initiator_seed) {
+            zassert_equal(req->used, -1, "two windows ranged with one initiator");
+            req->used = w;
+        }
+    }
+    return 0;
+}
+
+/* Report the next window of req, as the DM library does once it ended. */
+static void window_report(struct request *req) {
+    zassert_true(req->next < req->count);
+    session_result(&addrs[req->initiator], req->next == req->used);
+    req->next++;
+}
+
+static void windows_report(struct request *req) {
+    while (req->next < req->count) {
+        window_report(req);
+    }
+}
+
+ZTEST(handshake, test_windows) {
+    const uint8_t modes[] = {NDT_ADV_MODE_MCPD, NDT_ADV_MODE_RTT, MODES_BOTH};
+
+    for (int m = 0; m < ARRAY_SIZE(modes); m++) {
+        struct ndt_adv_window windows[NDT_ADV_WINDOWS_MAX];
+        int count = ndt_adv_windows(modes[m], windows);
+
+        zassert_equal(count, modes[m] == MODES_BOTH ? 2 : 1);
+        for (int w = 0; w < count; w++) {
+            /* The initiator starts where the reflector listens for the method. */
+            zassert_true(modes[m] & windows[w].mode);
+            zassert_equal(windows[w].start_delay_us, ndt_adv_start_delay_us(modes[m], windows[w].mode));
+        }
+        if (count == 1) {
+            zassert_equal(windows[0].start_delay_us, 0);
+        }
+        else {
+            /* A later window must not start before an earlier one ended. */
+            zassert_equal(windows[0].mode, NDT_ADV_MODE_MCPD);
+            zassert_equal(windows[0].start_delay_us, 0);
+            zassert_equal(windows[1].mode, NDT_ADV_MODE_RTT);
+            zassert_equal(windows[1].start_delay_us, NDT_ADV_RTT_DELAY_US);
+        }
+    }
+}
+
+ZTEST(handshake, test_dual_mode) {
+    uint32_t rangings[2] = {0};
+    uint32_t admitted = 0;
+
+    for (int round = 0; round < ROUNDS; round++) {
+        uint16_t epoch = round / EPOCH_ROUNDS;
+
+        for (int i = 0; i < INITIATORS; i++) {
+            /* Initiators change their minds from one ranging to the next. */
+            uint8_t mode = ((round + i) % 3) ? NDT_ADV_MODE_RTT : NDT_ADV_MODE_MCPD;
+            struct request req;
+
+            if (scan_request(MODES_BOTH, i, mode, epoch, epoch, &req)) {
+                continue;
+            }
+            admitted++;
+            zassert_true(req.used >= 0, "round %d initiator %d: no window for its method", round, i);
+            rangings[mode == NDT_ADV_MODE_RTT]++;
+            windows_report(&req);
+        }
+        k_sleep(K_MSEC(ROUND_MS));
+    }
+
+    struct session_stats total;
+
+    session_stats_total(&total);
+    TC_PRINT("%u requests, %u admitted, %u MCPD and %u RTT rangings, %u timeouts\n", total.requests,
+             total.admitted, rangings[0], rangings[1], total.timeouts);
+    zassert_equal(total.admitted, admitted);
+    zassert_equal(admitted, INITIATORS * ROUNDS, "%u of %u admitted", admitted, INITIATORS * ROUNDS);
+    zassert_equal(total.results, admitted);
+    zassert_equal(total.timeouts, 0);
+    zassert_true(rangings[0] > 0 && rangings[1] > 0);
+}
+
+ZTEST(handshake, test_leftover_window) {
+    struct request first;
+    struct request second;
+
+    /* MCPD ranges in the first window, the RTT one is still open. */
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_MCPD, 0, 0, &first));
+    zassert_equal(first.used, 0);
+    window_report(&first);
+
+    /* The ranging is done, the open window must not hold the initiator up. */
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_RTT, 0, 0, &second));
+    zassert_equal(second.used, 1);
+
+    /* Windows report in the order they were queued. */
+    windows_report(&first);
+    windows_report(&second);
+
+    struct session_stats stats;
+
+    zassert_ok(session_stats_get(&addrs[0], &stats));
+    zassert_equal(stats.admitted, 2);
+    zassert_equal(stats.results, 2);
+    zassert_equal(stats.queue_full, 0);
+}
+
+ZTEST(handshake, test_stale_epoch) {
+    struct request req;
+
+    /* An initiator that missed the epoch roll derives another seed. */
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_MCPD, 1, 0, &req));
+    zassert_equal(req.used, -1);
+    windows_report(&req);
+
+    /* Once both windows reported, the next report with the new epoch ranges. */
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_MCPD, 1, 1, &req));
+    zassert_equal(req.used, 0);
+    windows_report(&req);
+
+    struct session_stats stats;
+
+    zassert_ok(session_stats_get(&addrs[0], &stats));
+    zassert_equal(stats.admitted, 2);
+    zassert_equal(stats.results, 1);
+    zassert_equal(stats.queue_full, 0);
+}
+
+ZTEST(handshake, test_window_failed) {
+    struct request req;
+    struct session_stats stats;
+
+    /* One window could not be queued, the initiator still ranges in the other. */
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_RTT, 0, 0, &req));
+    session_request_failed(&addrs[0]);
+    session_result(&addrs[0], true);
+    zassert_ok(session_stats_get(&addrs[0], &stats));
+    zassert_equal(stats.results, 1);
+
+    /* Neither window could be queued, the token comes back. With it
+     * CONFIG_DM_SESSION_BURST more requests fit at the same instant.
+     */
+    k_sleep(K_MSEC(CONFIG_DM_SESSION_BURST * ROUND_MS));
+    zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_RTT, 0, 0, &req));
+    session_request_failed(&addrs[0]);
+    session_request_failed(&addrs[0]);
+    for (int n = 0; n < CONFIG_DM_SESSION_BURST; n++) {
+        zassert_ok(scan_request(MODES_BOTH, 0, NDT_ADV_MODE_RTT, 0, 0, &req), "request %d", n);
+        windows_report(&req);
+    }
+    zassert_ok(session_stats_get(&addrs[0], &stats));
+    zassert_equal(stats.submit_failed, 3);
+    zassert_equal(stats.rate_limited, 0);
+    zassert_equal(stats.results, 1 + CONFIG_DM_SESSION_BURST);
+}
+
+ZTEST_SUITE(handshake, NULL, NULL, reset, NULL, NULL);
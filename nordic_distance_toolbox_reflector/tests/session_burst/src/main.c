@@ -0,0 +1,144 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/bluetooth/addr.h>
+
+#include <session.h>
+
+/* Fifty initiators scanning one reflector. The DM library is played by a
+ * queue of the admitted rangings that completes the oldest one every
+ * RANGING_MS, one at a time as the radio would. The first case has every
+ * initiator send its scan request at the same instant, the second keeps
+ * them all scanning for RUN_MS. Both report how many requests were served
+ * and why the others were turned away. Initiators that never stop scanning
+ * keep their sessions, so only the first CONFIG_DM_REFLECTOR_SESSIONS of
+ * them are ever served.
+ */
+
+#define INITIATORS 50
+#define NUM_SESSIONS CONFIG_DM_REFLECTOR_SESSIONS
+#define PENDING_MAX CONFIG_DM_REFLECTOR_PENDING_MAX
+#define STEP_MS 5
+#define SCAN_MS 100
+#define RANGING_MS 25
+#define RUN_MS 10000
+
+static bt_addr_le_t addrs[INITIATORS];
+
+/* Rangings handed to the fake DM library, oldest first. */
+static int queue[PENDING_MAX + 1];
+static int queued;
+static uint32_t ranging_since;
+
+static uint32_t served[INITIATORS];
+
+static void setup_addrs(void) {
+    for (int i = 0; i < INITIATORS; i++) {
+        addrs[i].type = BT_ADDR_LE_RANDOM;
+        memset(addrs[i].a.val, 0, sizeof(addrs[i].a.val));
+        addrs[i].a.val[0] = i + 1;
+        addrs[i].a.val[1] = 0x01;
+        addrs[i].a.val[5] = 0xC0;
+    }
+}
+
+static void reset(void *fixture) {
+    setup_addrs();
+    session_reset();
+    queued = 0;
+    memset(served, 0, sizeof(served));
+}
+
+static int scan_request(int i) {
+    int err = session_request(&addrs[i], 1);
+
+    if (err == 0) {
+        zassert_true(queued < PENDING_MAX, "%d rangings pending", queued + 1);
+        if (queued == 0) {
+            ranging_since = k_uptime_get_32();
+        }
+        queue[queued++] = i;
+        served[i]++;
+    }
+    return err;
+}
+
+static void dm_run(uint32_t now) {
+    while (queued > 0 && now - ranging_since >= RANGING_MS) {
+        session_result(&addrs[queue[0]], true);
+        memmove(&queue[0], &queue[1], (queued - 1) * sizeof(queue[0]));
+        queued--;
+        ranging_since += RANGING_MS;
+    }
+    if (queued == 0) {
+        ranging_since = now;
+    }
+}
+
+static void report(const char *name, uint32_t run_ms) {
+    struct session_stats total;
+    uint32_t initiators = 0;
+    uint32_t most = 0;
+
+    session_stats_total(&total);
+    for (int i = 0; i < INITIATORS; i++) {
+        initiators += served[i] > 0;
+        most = MAX(most, served[i]);
+    }
+
+    uint32_t rejected = total.rate_limited + total.queue_full + total.no_session;
+
+    TC_PRINT("%s: %u requests, %u served, %u rejected (%u over rate, %u queue full, "
+             "%u no session), %u results, %u timeouts\n", name, total.requests, total.admitted,
+             rejected, total.rate_limited, total.queue_full, total.no_session, total.results,
+             total.timeouts);
+    TC_PRINT("%s: %u of %d initiators served, at most %u each in %u ms\n", name, initiators,
+             INITIATORS, most, run_ms);
+
+    zassert_equal(total.requests, total.admitted + rejected);
+    /* Nobody gets more than its burst and refill allow. */
+    zassert_true(most <= CONFIG_DM_SESSION_BURST + CONFIG_DM_SESSION_RATE_HZ * run_ms / 1000,
+                 "%u rangings for one initiator", most);
+}
+
+ZTEST(session_burst, test_burst) {
+    for (int i = 0; i < INITIATORS; i++) {
+        scan_request(i);
+    }
+    report("burst", 0);
+
+    struct session_stats total;
+
+    session_stats_total(&total);
+    zassert_equal(total.requests, INITIATORS);
+    zassert_equal(total.admitted, MIN(PENDING_MAX, NUM_SESSIONS));
+    zassert_equal(total.queue_full, NUM_SESSIONS - total.admitted);
+    zassert_equal(total.no_session, INITIATORS - NUM_SESSIONS);
+}
+
+ZTEST(session_burst, test_sustained) {
+    uint32_t start = k_uptime_get_32();
+    uint32_t step = 0;
+
+    ranging_since = start;
+    for (uint32_t t = 0; t < RUN_MS; t += STEP_MS, step++) {
+        dm_run(k_uptime_get_32());
+
+        /* Each initiator scans once every SCAN_MS, spread over the steps. */
+        for (int i = 0; i < INITIATORS; i++) {
+            if ((step + i) % (SCAN_MS / STEP_MS) == 0) {
+                scan_request(i);
+            }
+        }
+        k_sleep(K_MSEC(STEP_MS));
+    }
+    report("sustained", RUN_MS);
+
+    struct session_stats total;
+
+    session_stats_total(&total);
+    zassert_true(total.results > 0);
+    zassert_equal(total.timeouts, 0, "%u rangings never completed", total.timeouts);
+}
+
+ZTEST_SUITE(session_burst, NULL, NULL, reset, NULL, NULL);